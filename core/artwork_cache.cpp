@@ -0,0 +1,46 @@
+#include "artwork_cache.h"
+#include <cstring>
+
+namespace nowbar {
+
+namespace {
+
+inline uint64_t rotl64(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+} // anonymous namespace
+
+// Word-at-a-time multiplicative hash; covers are megabytes, so a byte-wise
+// hash would cost noticeably more than the lookup saves on small images.
+uint64_t artwork_hash(const void* data, size_t size, uint64_t seed) {
+    const uint64_t K = 0x9e3779b97f4a7c15ULL;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = (0x51afd7ed558ccd1dULL + seed) ^ (size * K);
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++, p += 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (rotl64(h, 5) ^ w) * K;
+    }
+    uint64_t tail = 0;
+    if (size % 8) memcpy(&tail, p, size % 8);
+    h = (rotl64(h, 5) ^ tail) * K;
+
+    // Final avalanche (murmur3 fmix64)
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+std::string artwork_content_key(const void* data, size_t size) {
+    uint64_t hash = data ? artwork_hash(data, size) : 0;
+    uint64_t length = size;
+    std::string key(sizeof(length) + sizeof(hash), '\0');
+    memcpy(&key[0], &length, sizeof(length));
+    memcpy(&key[sizeof(length)], &hash, sizeof(hash));
+    return key;
+}
+
+} // namespace nowbar
@@ -0,0 +1,57 @@
+#pragma once
+// Process-wide cache of artwork derivatives, keyed by the artwork content.
+//
+// Consecutive tracks of an album normally carry the same cover, so the
+// thumbnail, background colors and blur made for one track are kept and
+// reused by the next instead of decoding and filtering the image again.
+// Keys are a hash of the encoded image bytes, which also matches the same
+// cover embedded in several files or shown by several panels. Entries are
+// immutable and shared, so a lookup costs no copy.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include "artwork_colors.h"
+#include "lru_byte_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nowbar {
+
+// Everything derived from one artwork image.
+struct ArtworkDerivatives {
+    uint32_t width = 0;    // Thumbnail size
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;  // Thumbnail, width * 4 bytes per row (BGRA)
+
+    uint32_t primary = 0;    // Background colors, 0xAARRGGBB
+    uint32_t secondary = 0;
+    bool colors_valid = false;
+    ArtworkPalette palette;  // Swatches the background colors come from
+
+    uint32_t blur_size = 0;     // Blurred thumbnail, blur_size x blur_size
+    uint32_t blur_radius = 0;   // Box radius it was blurred with
+    std::vector<uint8_t> blur;  // BGRA, empty if not made
+
+    size_t byte_size() const { return pixels.size() + blur.size(); }
+};
+
+// Fast 64-bit hash of a byte range; seed chains calls over several ranges.
+uint64_t artwork_hash(const void* data, size_t size, uint64_t seed = 0);
+
+// Cache key for encoded image bytes: the size plus a 64-bit hash of all of
+// them.
+std::string artwork_content_key(const void* data, size_t size);
+
+struct ArtworkDerivativesBytes {
+    size_t operator()(const std::shared_ptr<const ArtworkDerivatives>& entry) const {
+        return entry ? entry->byte_size() + sizeof(ArtworkDerivatives) : 0;
+    }
+};
+
+// Entries are shared, so a hit copies a pointer rather than the pixels.
+using ArtworkMemoryCache = LruByteCache<std::shared_ptr<const ArtworkDerivatives>, ArtworkDerivativesBytes>;
+
+} // namespace nowbar
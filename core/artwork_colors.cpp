@@ -0,0 +1,281 @@
+#include "artwork_colors.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define NOWBAR_COLORS_SSE2 1
+#endif
+
+namespace nowbar {
+
+namespace {
+
+constexpr int GRID = 32;                  // Max cells per side of the reduction
+constexpr uint32_t MIN_CELL_ALPHA = 128;  // Mostly transparent cells are skipped
+constexpr int MAX_ITERATIONS = 10;
+constexpr float SEED_SEPARATION = 0.08f;  // Oklab distance between seeds
+constexpr float VIBRANT_CHROMA = 0.09f;   // Oklab chroma splitting vibrant from muted
+
+// Add the B, G, R, A channels of count pixels to sums.
+inline void sum_pixels(const uint8_t* p, int count, uint64_t sums[4]) {
+    int i = 0;
+#ifdef NOWBAR_COLORS_SSE2
+    // Widen each pixel to four 32-bit lanes; a lane holds at most
+    // 255 * count / 4, far from overflowing for any row
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 4));
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+        acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(lo, zero));
+        acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(lo, zero));
+        acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(hi, zero));
+        acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(hi, zero));
+    }
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    for (int c = 0; c < 4; c++) sums[c] += lanes[c];
+#endif
+    for (; i < count; i++) {
+        sums[0] += p[i * 4 + 0];
+        sums[1] += p[i * 4 + 1];
+        sums[2] += p[i * 4 + 2];
+        sums[3] += p[i * 4 + 3];
+    }
+}
+
+// Cell boundaries along one axis.
+inline void cell_span(int cell, int cells, int size, int& lo, int& hi) {
+    lo = static_cast<int>(static_cast<int64_t>(cell) * size / cells);
+    hi = static_cast<int>(static_cast<int64_t>(cell + 1) * size / cells);
+}
+
+struct Lab {
+    float L, a, b;
+};
+
+inline float distance2(const Lab& x, const Lab& y) {
+    float dL = x.L - y.L, da = x.a - y.a, db = x.b - y.b;
+    return dL * dL + da * da + db * db;
+}
+
+inline float chroma(const Lab& c) { return std::sqrt(c.a * c.a + c.b * c.b); }
+
+const float* srgb_to_linear_table() {
+    static const auto table = [] {
+        std::vector<float> t(256);
+        for (int i = 0; i < 256; i++) {
+            float v = i / 255.0f;
+            t[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+Lab to_oklab(uint32_t r8, uint32_t g8, uint32_t b8) {
+    const float* lin = srgb_to_linear_table();
+    float r = lin[r8], g = lin[g8], b = lin[b8];
+    float l = std::cbrt(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+    float m = std::cbrt(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+    float s = std::cbrt(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+    return Lab{0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+               1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+               0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s};
+}
+
+inline uint32_t linear_to_srgb8(float v) {
+    v = std::clamp(v, 0.0f, 1.0f);
+    v = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint32_t>(v * 255.0f + 0.5f);
+}
+
+// Linear sRGB; true if every channel is within [0, 1].
+bool to_linear_rgb(const Lab& c, float rgb[3]) {
+    float l = c.L + 0.3963377774f * c.a + 0.2158037573f * c.b;
+    float m = c.L - 0.1055613458f * c.a - 0.0638541728f * c.b;
+    float s = c.L - 0.0894841775f * c.a - 1.2914855480f * c.b;
+    l = l * l * l;
+    m = m * m * m;
+    s = s * s * s;
+    rgb[0] = 4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s;
+    rgb[1] = -1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s;
+    rgb[2] = -0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s;
+    const float eps = 1e-4f;
+    return std::all_of(rgb, rgb + 3, [=](float v) { return v >= -eps && v <= 1.0f + eps; });
+}
+
+// Opaque 0xAARRGGBB. Out-of-gamut colors lose chroma until they fit, which
+// keeps their hue and lightness, instead of having channels clipped.
+uint32_t from_oklab(Lab c) {
+    float rgb[3];
+    for (int step = 0; step < 16 && !to_linear_rgb(c, rgb); step++) {
+        c.a *= 0.9f;
+        c.b *= 0.9f;
+    }
+    return 0xFF000000u | linear_to_srgb8(rgb[0]) << 16 | linear_to_srgb8(rgb[1]) << 8 | linear_to_srgb8(rgb[2]);
+}
+
+inline Lab to_oklab(uint32_t argb) { return to_oklab(argb >> 16 & 0xFF, argb >> 8 & 0xFF, argb & 0xFF); }
+
+// Box-filter the image to cell averages and return the mostly opaque ones.
+std::vector<Lab> sample_cells(const uint8_t* bgra, int width, int height, ptrdiff_t stride) {
+    int cols = std::min(width, GRID);
+    int rows = std::min(height, GRID);
+    int x_lo[GRID], x_hi[GRID];
+    for (int cx = 0; cx < cols; cx++) cell_span(cx, cols, width, x_lo[cx], x_hi[cx]);
+
+    std::vector<Lab> samples;
+    samples.reserve(static_cast<size_t>(cols) * rows);
+    for (int cy = 0; cy < rows; cy++) {
+        int y_lo, y_hi;
+        cell_span(cy, rows, height, y_lo, y_hi);
+
+        uint64_t sums[GRID][4] = {};
+        for (int y = y_lo; y < y_hi; y++) {
+            const uint8_t* row = bgra + static_cast<ptrdiff_t>(y) * stride;
+            for (int cx = 0; cx < cols; cx++) {
+                sum_pixels(row + static_cast<size_t>(x_lo[cx]) * 4, x_hi[cx] - x_lo[cx], sums[cx]);
+            }
+        }
+
+        for (int cx = 0; cx < cols; cx++) {
+            uint64_t n = static_cast<uint64_t>(x_hi[cx] - x_lo[cx]) * (y_hi - y_lo);
+            if ((sums[cx][3] + n / 2) / n < MIN_CELL_ALPHA) continue;
+            samples.push_back(to_oklab(static_cast<uint32_t>((sums[cx][2] + n / 2) / n),
+                                       static_cast<uint32_t>((sums[cx][1] + n / 2) / n),
+                                       static_cast<uint32_t>((sums[cx][0] + n / 2) / n)));
+        }
+    }
+    return samples;
+}
+
+// Initial centers: means of the most populated bins of an 8x8x8 Oklab
+// histogram, skipping bins too close to one already taken.
+std::vector<Lab> seed_centers(const std::vector<Lab>& samples) {
+    constexpr int BINS = 8;
+    struct Bin {
+        float L = 0, a = 0, b = 0;
+        uint32_t n = 0;
+    };
+    std::vector<Bin> bins(BINS * BINS * BINS);
+    auto bin_of = [](float v, float lo, float hi) {
+        return std::clamp(static_cast<int>((v - lo) / (hi - lo) * BINS), 0, BINS - 1);
+    };
+    for (const Lab& s : samples) {
+        Bin& bin = bins[(bin_of(s.L, 0.0f, 1.0f) * BINS + bin_of(s.a, -0.4f, 0.4f)) * BINS + bin_of(s.b, -0.4f, 0.4f)];
+        bin.L += s.L;
+        bin.a += s.a;
+        bin.b += s.b;
+        bin.n++;
+    }
+    std::sort(bins.begin(), bins.end(), [](const Bin& x, const Bin& y) { return x.n > y.n; });
+
+    std::vector<Lab> centers;
+    for (const Bin& bin : bins) {
+        if (bin.n == 0 || centers.size() == ArtworkPalette::MAX_SWATCHES) break;
+        Lab mean{bin.L / bin.n, bin.a / bin.n, bin.b / bin.n};
+        bool distinct = std::all_of(centers.begin(), centers.end(), [&](const Lab& c) {
+            return distance2(c, mean) >= SEED_SEPARATION * SEED_SEPARATION;
+        });
+        if (distinct) centers.push_back(mean);
+    }
+    return centers;
+}
+
+} // anonymous namespace
+
+bool extract_artwork_palette(const uint8_t* bgra, int width, int height, ptrdiff_t stride, ArtworkPalette& out) {
+    out = ArtworkPalette();
+    if (!bgra || width <= 0 || height <= 0) return false;
+
+    std::vector<Lab> samples = sample_cells(bgra, width, height, stride);
+    if (samples.empty()) return false;
+    std::vector<Lab> centers = seed_centers(samples);
+    size_t k = centers.size();
+
+    // Lloyd iterations until no sample changes cluster
+    std::vector<uint8_t> assignment(samples.size(), 0xFF);
+    std::vector<uint32_t> population(k);
+    for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++) {
+        bool changed = false;
+        for (size_t i = 0; i < samples.size(); i++) {
+            uint8_t best = 0;
+            float best_d = distance2(samples[i], centers[0]);
+            for (size_t c = 1; c < k; c++) {
+                float d = distance2(samples[i], centers[c]);
+                if (d < best_d) {
+                    best_d = d;
+                    best = static_cast<uint8_t>(c);
+                }
+            }
+            changed |= assignment[i] != best;
+            assignment[i] = best;
+        }
+
+        std::vector<Lab> sums(k, Lab{0, 0, 0});
+        std::fill(population.begin(), population.end(), 0);
+        for (size_t i = 0; i < samples.size(); i++) {
+            Lab& sum = sums[assignment[i]];
+            sum.L += samples[i].L;
+            sum.a += samples[i].a;
+            sum.b += samples[i].b;
+            population[assignment[i]]++;
+        }
+        for (size_t c = 0; c < k; c++) {
+            if (population[c] == 0) continue;  // Keeps its old center
+            centers[c] = Lab{sums[c].L / population[c], sums[c].a / population[c], sums[c].b / population[c]};
+        }
+        if (!changed) break;
+    }
+
+    std::vector<size_t> order(k);
+    for (size_t c = 0; c < k; c++) order[c] = c;
+    std::sort(order.begin(), order.end(), [&](size_t x, size_t y) { return population[x] > population[y]; });
+
+    Lab labs[ArtworkPalette::MAX_SWATCHES];
+    for (size_t c : order) {
+        if (population[c] == 0) break;
+        labs[out.count] = centers[c];
+        out.swatches[out.count].color = from_oklab(centers[c]);
+        out.swatches[out.count].population = population[c];
+        out.total += population[c];
+        out.count++;
+    }
+    if (out.count == 0) return false;
+    out.dominant = 0;
+
+    // Vibrant favors chroma but needs a fair share of the cover; muted is
+    // the largest grayish swatch that is neither near black nor near white
+    float best_vibrant = 0.0f;
+    for (uint32_t i = 0; i < out.count; i++) {
+        float c = chroma(labs[i]);
+        float share = static_cast<float>(out.swatches[i].population) / out.total;
+        if (c >= VIBRANT_CHROMA && labs[i].L >= 0.35f && labs[i].L <= 0.9f && share >= 0.02f) {
+            float score = c * std::sqrt(share);
+            if (score > best_vibrant) {
+                best_vibrant = score;
+                out.vibrant = static_cast<int32_t>(i);
+            }
+        } else if (c < VIBRANT_CHROMA && labs[i].L >= 0.25f && labs[i].L <= 0.85f && out.muted < 0) {
+            out.muted = static_cast<int32_t>(i);
+        }
+    }
+    return true;
+}
+
+void palette_background_colors(const ArtworkPalette& palette, uint32_t& primary, uint32_t& secondary) {
+    if (!palette.valid()) {
+        primary = secondary = 0xFF000000u;
+        return;
+    }
+    primary = palette.swatches[palette.dominant].color;
+    Lab dark = to_oklab(primary);
+    dark.L *= 0.7f;
+    secondary = from_oklab(dark);
+}
+
+} // namespace nowbar
@@ -0,0 +1,48 @@
+#pragma once
+// Color analysis of artwork pixels (32-bit BGRA, e.g. a locked GDI+
+// 32bppARGB bitmap).
+//
+// extract_artwork_palette() box-filters the image down to at most 32x32
+// cell averages in a single pass over the rows, converts the mostly opaque
+// cells to Oklab and clusters them with k-means, seeded from the most
+// populated cells of a coarse Oklab histogram. Distances in Oklab follow
+// perceived difference, so a cover's distinct colors stay apart instead of
+// averaging into brown. The work is bounded (1024 samples, 6 clusters, 10
+// iterations), well under 2 ms on a 512 px thumbnail, and the palette is
+// cached with the other artwork derivatives.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include <cstddef>
+#include <cstdint>
+
+namespace nowbar {
+
+struct ArtworkSwatch {
+    uint32_t color = 0;       // Opaque 0xAARRGGBB
+    uint32_t population = 0;  // Samples in the cluster
+};
+
+// Plain fixed-size data; the disk cache stores it as is.
+struct ArtworkPalette {
+    static constexpr uint32_t MAX_SWATCHES = 6;
+
+    ArtworkSwatch swatches[MAX_SWATCHES];  // Most populous first
+    uint32_t count = 0;
+    uint32_t total = 0;    // Samples over all swatches
+    int32_t dominant = -1;  // Indices into swatches, -1 if none qualifies
+    int32_t vibrant = -1;   // Most saturated color with a fair share
+    int32_t muted = -1;     // Largest low-saturation, mid-lightness color
+
+    bool valid() const { return count > 0 && dominant >= 0; }
+};
+
+// Stride is in bytes. Returns false if the size is not positive or almost
+// every pixel is transparent.
+bool extract_artwork_palette(const uint8_t* bgra, int width, int height, ptrdiff_t stride, ArtworkPalette& out);
+
+// Background gradient colors: the dominant swatch, and the same hue darkened
+// in Oklab so it keeps its saturation.
+void palette_background_colors(const ArtworkPalette& palette, uint32_t& primary, uint32_t& secondary);
+
+} // namespace nowbar
@@ -0,0 +1,223 @@
+#include "pch.h"
+#include "artwork_decode.h"
+#include <wincodec.h>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+namespace nowbar {
+
+namespace {
+
+// IStream reading straight from album_art_data. Each stream has its own
+// position, so clones can be used independently, but a single stream must
+// not be shared between threads.
+class AlbumArtStream : public IStream {
+public:
+    AlbumArtStream(const album_art_data_ptr& data, ULONGLONG position = 0)
+        : m_data(data), m_position(position) {}
+
+    // IUnknown
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppv) override {
+        if (!ppv) return E_POINTER;
+        if (riid == IID_IUnknown || riid == IID_ISequentialStream || riid == IID_IStream) {
+            *ppv = static_cast<IStream*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() override { return InterlockedIncrement(&m_refs); }
+    STDMETHODIMP_(ULONG) Release() override {
+        ULONG refs = InterlockedDecrement(&m_refs);
+        if (refs == 0) delete this;
+        return refs;
+    }
+
+    // ISequentialStream
+    STDMETHODIMP Read(void* pv, ULONG cb, ULONG* pcbRead) override {
+        if (!pv) return STG_E_INVALIDPOINTER;
+        ULONGLONG size = m_data->get_size();
+        ULONG count = 0;
+        if (m_position < size) {
+            count = static_cast<ULONG>(std::min<ULONGLONG>(cb, size - m_position));
+            memcpy(pv, static_cast<const BYTE*>(m_data->get_ptr()) + m_position, count);
+            m_position += count;
+        }
+        if (pcbRead) *pcbRead = count;
+        return count < cb ? S_FALSE : S_OK;
+    }
+    STDMETHODIMP Write(const void*, ULONG, ULONG*) override { return STG_E_ACCESSDENIED; }
+
+    // IStream
+    STDMETHODIMP Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER* newPosition) override {
+        LONGLONG base;
+        switch (origin) {
+        case STREAM_SEEK_SET: base = 0; break;
+        case STREAM_SEEK_CUR: base = static_cast<LONGLONG>(m_position); break;
+        case STREAM_SEEK_END: base = static_cast<LONGLONG>(m_data->get_size()); break;
+        default: return STG_E_INVALIDFUNCTION;
+        }
+        LONGLONG target = base + move.QuadPart;
+        if (target < 0) return STG_E_INVALIDFUNCTION;
+        m_position = static_cast<ULONGLONG>(target);
+        if (newPosition) newPosition->QuadPart = m_position;
+        return S_OK;
+    }
+    STDMETHODIMP SetSize(ULARGE_INTEGER) override { return STG_E_ACCESSDENIED; }
+    STDMETHODIMP CopyTo(IStream* target, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead,
+                        ULARGE_INTEGER* pcbWritten) override {
+        if (!target) return STG_E_INVALIDPOINTER;
+        ULONGLONG size = m_data->get_size();
+        ULONGLONG count = m_position < size ? std::min<ULONGLONG>(cb.QuadPart, size - m_position) : 0;
+        const BYTE* src = static_cast<const BYTE*>(m_data->get_ptr()) + m_position;
+        ULONGLONG written = 0;
+        HRESULT hr = S_OK;
+        while (written < count) {
+            ULONG chunk = static_cast<ULONG>(std::min<ULONGLONG>(count - written, 1u << 20));
+            ULONG done = 0;
+            hr = target->Write(src + written, chunk, &done);
+            written += done;
+            if (FAILED(hr) || done == 0) break;
+        }
+        m_position += written;
+        if (pcbRead) pcbRead->QuadPart = written;
+        if (pcbWritten) pcbWritten->QuadPart = written;
+        return FAILED(hr) ? hr : S_OK;
+    }
+    STDMETHODIMP Commit(DWORD) override { return S_OK; }
+    STDMETHODIMP Revert() override { return S_OK; }
+    STDMETHODIMP LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override { return STG_E_INVALIDFUNCTION; }
+    STDMETHODIMP UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override { return STG_E_INVALIDFUNCTION; }
+    STDMETHODIMP Stat(STATSTG* stat, DWORD) override {
+        if (!stat) return STG_E_INVALIDPOINTER;
+        ZeroMemory(stat, sizeof(*stat));
+        stat->type = STGTY_STREAM;
+        stat->cbSize.QuadPart = m_data->get_size();
+        stat->grfMode = STGM_READ | STGM_SHARE_DENY_WRITE;
+        return S_OK;
+    }
+    STDMETHODIMP Clone(IStream** out) override {
+        if (!out) return STG_E_INVALIDPOINTER;
+        *out = new AlbumArtStream(m_data, m_position);
+        return S_OK;
+    }
+
+private:
+    virtual ~AlbumArtStream() = default;
+
+    LONG m_refs = 1;
+    album_art_data_ptr m_data;
+    ULONGLONG m_position;
+};
+
+// Smallest size the codec can decode to natively whose long side is still at
+// least max_dim. JPEG offers 1/2, 1/4 and 1/8; other codecs report only the
+// full size.
+void choose_decode_size(IWICBitmapSourceTransform* transform, UINT width, UINT height, int max_dim,
+                        UINT& out_width, UINT& out_height) {
+    out_width = width;
+    out_height = height;
+    for (UINT factor = 8; factor >= 2; factor /= 2) {
+        UINT w = (width + factor - 1) / factor;
+        UINT h = (height + factor - 1) / factor;
+        if (FAILED(transform->GetClosestSize(&w, &h)) || w == 0 || h == 0) continue;
+        if (static_cast<int>(std::max(w, h)) < max_dim) continue;
+        if (w < out_width || h < out_height) {
+            out_width = w;
+            out_height = h;
+        }
+        return;
+    }
+}
+
+std::unique_ptr<Gdiplus::Bitmap> decode_with_wic(IStream* stream, int max_dim) {
+    CComPtr<IWICImagingFactory> factory;
+    if (FAILED(factory.CoCreateInstance(CLSID_WICImagingFactory))) return nullptr;
+
+    CComPtr<IWICBitmapDecoder> decoder;
+    if (FAILED(factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder))) {
+        return nullptr;
+    }
+    CComPtr<IWICBitmapFrameDecode> frame;
+    if (FAILED(decoder->GetFrame(0, &frame))) return nullptr;
+    UINT width = 0, height = 0;
+    if (FAILED(frame->GetSize(&width, &height)) || width == 0 || height == 0) return nullptr;
+
+    // Let the codec scale while decoding where it can; the full-size image
+    // is then never decoded
+    CComPtr<IWICBitmapSource> source(frame.p);
+    CComPtr<IWICBitmapSourceTransform> transform;
+    if (static_cast<int>(std::max(width, height)) > max_dim && SUCCEEDED(frame->QueryInterface(&transform))) {
+        UINT scaled_width, scaled_height;
+        choose_decode_size(transform, width, height, max_dim, scaled_width, scaled_height);
+        WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+        CComPtr<IWICBitmap> scaled;
+        CComPtr<IWICBitmapLock> lock;
+        WICRect rect = {0, 0, static_cast<INT>(scaled_width), static_cast<INT>(scaled_height)};
+        UINT stride = 0, size = 0;
+        BYTE* pixels = nullptr;
+        if ((scaled_width < width || scaled_height < height) && SUCCEEDED(transform->GetClosestPixelFormat(&format)) &&
+            SUCCEEDED(factory->CreateBitmap(scaled_width, scaled_height, format, WICBitmapCacheOnLoad, &scaled)) &&
+            SUCCEEDED(scaled->Lock(&rect, WICBitmapLockWrite, &lock)) && SUCCEEDED(lock->GetStride(&stride)) &&
+            SUCCEEDED(lock->GetDataPointer(&size, &pixels)) &&
+            SUCCEEDED(transform->CopyPixels(nullptr, scaled_width, scaled_height, &format, WICBitmapTransformRotate0,
+                                            stride, size, pixels))) {
+            lock.Release();
+            source = scaled.p;
+            width = scaled_width;
+            height = scaled_height;
+        }
+    }
+
+    CComPtr<IWICFormatConverter> converter;
+    if (FAILED(factory->CreateFormatConverter(&converter)) ||
+        FAILED(converter->Initialize(source, GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone, nullptr, 0.0,
+                                     WICBitmapPaletteTypeCustom))) {
+        return nullptr;
+    }
+
+    // GDI+ 32bppARGB has the same memory layout as WIC 32bppBGRA
+    std::unique_ptr<Gdiplus::Bitmap> bitmap(new Gdiplus::Bitmap(width, height, PixelFormat32bppARGB));
+    if (bitmap->GetLastStatus() != Gdiplus::Ok) return nullptr;
+    Gdiplus::Rect lockRect(0, 0, width, height);
+    Gdiplus::BitmapData data;
+    if (bitmap->LockBits(&lockRect, Gdiplus::ImageLockModeWrite, PixelFormat32bppARGB, &data) != Gdiplus::Ok) {
+        return nullptr;
+    }
+    HRESULT hr = E_FAIL;
+    if (data.Stride > 0) {
+        hr = converter->CopyPixels(nullptr, data.Stride, data.Stride * height, static_cast<BYTE*>(data.Scan0));
+    }
+    bitmap->UnlockBits(&data);
+    return SUCCEEDED(hr) ? std::move(bitmap) : nullptr;
+}
+
+} // anonymous namespace
+
+IStream* create_album_art_stream(const album_art_data_ptr& data) {
+    return new AlbumArtStream(data);
+}
+
+std::unique_ptr<Gdiplus::Bitmap> decode_album_art(const album_art_data_ptr& data, int max_dim) {
+    if (!data.is_valid() || data->get_size() == 0) return nullptr;
+
+    CComPtr<IStream> stream;
+    stream.Attach(create_album_art_stream(data));
+
+    // Worker threads start without COM; an apartment that is already set up
+    // (RPC_E_CHANGED_MODE) works just as well
+    HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    std::unique_ptr<Gdiplus::Bitmap> bitmap = decode_with_wic(stream, max_dim);
+    if (SUCCEEDED(com)) CoUninitialize();
+    if (bitmap) return bitmap;
+
+    // Formats WIC has no codec for; GDI+ decodes at full size
+    LARGE_INTEGER start = {};
+    stream->Seek(start, STREAM_SEEK_SET, nullptr);
+    bitmap.reset(Gdiplus::Bitmap::FromStream(stream));
+    if (bitmap && bitmap->GetLastStatus() != Gdiplus::Ok) bitmap.reset();
+    return bitmap;
+}
+
+} // namespace nowbar
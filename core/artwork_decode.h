@@ -0,0 +1,19 @@
+#pragma once
+#include "pch.h"
+
+namespace nowbar {
+
+// Read-only IStream over the bytes of an album_art_data object. The stream
+// keeps a reference to data, so the image is never copied. Returned with a
+// reference count of one; the caller releases it.
+IStream* create_album_art_stream(const album_art_data_ptr& data);
+
+// Decode artwork for display at no more than max_dim pixels on the long
+// side. Codecs that can scale while decoding (JPEG) are asked for the
+// smallest size that is still at least max_dim, so an oversized cover is
+// never materialized at full resolution; the caller does the final resize.
+// Uses WIC and falls back to GDI+. Returns null if the data is not an image.
+// Safe to call from worker threads.
+std::unique_ptr<Gdiplus::Bitmap> decode_album_art(const album_art_data_ptr& data, int max_dim);
+
+} // namespace nowbar
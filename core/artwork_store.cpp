@@ -0,0 +1,458 @@
+#include "artwork_store.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace nowbar {
+
+namespace {
+
+constexpr char ARTCACHE_MAGIC[4] = {'N', 'W', 'A', 'C'};
+constexpr uint32_t ARTCACHE_VERSION = 2;  // 2: palette in the payload
+constexpr uint32_t RECORD_MAGIC = 0x52415752;  // "RWAR"
+constexpr size_t KEY_BYTES = 16;               // artwork_content_key() length
+constexpr uint32_t RECORD_COLORS_VALID = 1;
+constexpr uint32_t RECORD_BLUR_RADIUS_SHIFT = 8;  // Flags bits 8-15
+constexpr uint64_t GROW_STEP = 1u << 20;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t data_end;  // End of the last complete record
+    uint64_t clock;     // Last use stamp handed out
+    uint64_t reserved[5];
+};
+static_assert(sizeof(FileHeader) == 64, "FileHeader layout");
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t payload_bytes;
+    uint8_t key[KEY_BYTES];
+    uint64_t last_used;  // Not covered by the checksum
+    // Checksummed fields
+    uint32_t width;
+    uint32_t height;
+    uint32_t primary;
+    uint32_t secondary;
+    uint32_t flags;
+    uint32_t blur_size;
+    uint32_t pixel_bytes;  // Encoded thumbnail, after the palette; the encoded blur follows
+    uint32_t checksum;     // Key, the fields above and the payload
+};
+static_assert(sizeof(RecordHeader) == 64, "RecordHeader layout");
+constexpr size_t CHECKED_FIELDS = offsetof(RecordHeader, checksum) - offsetof(RecordHeader, width);
+
+static_assert(std::is_trivially_copyable_v<ArtworkPalette>, "palette is stored as raw bytes");
+constexpr uint32_t PALETTE_BYTES = sizeof(ArtworkPalette);
+
+inline uint64_t align8(uint64_t v) { return (v + 7) & ~uint64_t(7); }
+
+uint32_t record_checksum(const RecordHeader& rh, const uint8_t* payload) {
+    uint64_t h = artwork_hash(rh.key, KEY_BYTES);
+    h = artwork_hash(&rh.width, CHECKED_FIELDS, h);
+    h = artwork_hash(payload, rh.payload_bytes, h);
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// QOI-style lossless encoding of 4-byte pixels (BGRA). Each pixel becomes a
+// run of the previous pixel, a reference into a 64-entry table of recently
+// seen pixels, a small delta from the previous pixel, or the literal value.
+
+struct Pixel {
+    uint8_t b, g, r, a;
+};
+
+inline bool same(const Pixel& x, const Pixel& y) {
+    return x.b == y.b && x.g == y.g && x.r == y.r && x.a == y.a;
+}
+inline uint32_t slot_of(const Pixel& p) { return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) % 64; }
+
+constexpr uint8_t OP_INDEX = 0x00;
+constexpr uint8_t OP_DIFF = 0x40;
+constexpr uint8_t OP_LUMA = 0x80;
+constexpr uint8_t OP_RUN = 0xc0;
+constexpr uint8_t OP_RGB = 0xfe;
+constexpr uint8_t OP_RGBA = 0xff;
+constexpr uint8_t OP_MASK = 0xc0;
+constexpr int MAX_RUN = 62;
+
+void encode_pixels(const uint8_t* src, size_t count, std::vector<uint8_t>& out) {
+    Pixel table[64] = {};
+    Pixel prev = {0, 0, 0, 255};
+    int run = 0;
+    for (size_t i = 0; i < count; i++) {
+        Pixel px;
+        memcpy(&px, src + i * 4, 4);
+        if (same(px, prev)) {
+            if (++run == MAX_RUN || i + 1 == count) {
+                out.push_back(static_cast<uint8_t>(OP_RUN | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            out.push_back(static_cast<uint8_t>(OP_RUN | (run - 1)));
+            run = 0;
+        }
+
+        uint32_t slot = slot_of(px);
+        if (same(table[slot], px)) {
+            out.push_back(static_cast<uint8_t>(OP_INDEX | slot));
+        } else {
+            table[slot] = px;
+            if (px.a == prev.a) {
+                int dr = static_cast<int8_t>(px.r - prev.r);
+                int dg = static_cast<int8_t>(px.g - prev.g);
+                int db = static_cast<int8_t>(px.b - prev.b);
+                int dr_dg = dr - dg;
+                int db_dg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(static_cast<uint8_t>(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    out.push_back(static_cast<uint8_t>(OP_LUMA | (dg + 32)));
+                    out.push_back(static_cast<uint8_t>((dr_dg + 8) << 4 | (db_dg + 8)));
+                } else {
+                    out.push_back(OP_RGB);
+                    out.push_back(px.r);
+                    out.push_back(px.g);
+                    out.push_back(px.b);
+                }
+            } else {
+                out.push_back(OP_RGBA);
+                out.push_back(px.r);
+                out.push_back(px.g);
+                out.push_back(px.b);
+                out.push_back(px.a);
+            }
+        }
+        prev = px;
+    }
+}
+
+// False if the input ends early or has bytes left over.
+bool decode_pixels(const uint8_t* in, size_t len, size_t count, uint8_t* dst) {
+    Pixel table[64] = {};
+    Pixel px = {0, 0, 0, 255};
+    size_t pos = 0;
+    int run = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (pos >= len) return false;
+            uint8_t op = in[pos++];
+            if (op == OP_RGB) {
+                if (len - pos < 3) return false;
+                px.r = in[pos];
+                px.g = in[pos + 1];
+                px.b = in[pos + 2];
+                pos += 3;
+            } else if (op == OP_RGBA) {
+                if (len - pos < 4) return false;
+                px.r = in[pos];
+                px.g = in[pos + 1];
+                px.b = in[pos + 2];
+                px.a = in[pos + 3];
+                pos += 4;
+            } else if ((op & OP_MASK) == OP_INDEX) {
+                px = table[op];
+            } else if ((op & OP_MASK) == OP_DIFF) {
+                px.r = static_cast<uint8_t>(px.r + ((op >> 4) & 3) - 2);
+                px.g = static_cast<uint8_t>(px.g + ((op >> 2) & 3) - 2);
+                px.b = static_cast<uint8_t>(px.b + (op & 3) - 2);
+            } else if ((op & OP_MASK) == OP_LUMA) {
+                if (pos >= len) return false;
+                uint8_t next = in[pos++];
+                int dg = (op & 0x3f) - 32;
+                px.r = static_cast<uint8_t>(px.r + dg - 8 + (next >> 4));
+                px.g = static_cast<uint8_t>(px.g + dg);
+                px.b = static_cast<uint8_t>(px.b + dg - 8 + (next & 0x0f));
+            } else {
+                run = op & 0x3f;  // This pixel plus `run` more
+            }
+            table[slot_of(px)] = px;
+        }
+        memcpy(dst + i * 4, &px, 4);
+    }
+    return run == 0 && pos == len;
+}
+
+} // anonymous namespace
+
+bool ArtworkCacheFile::init_empty() {
+    if (!m_file.resize(sizeof(FileHeader))) return false;
+    FileHeader header = {};
+    memcpy(header.magic, ARTCACHE_MAGIC, sizeof(header.magic));
+    header.version = ARTCACHE_VERSION;
+    header.data_end = sizeof(FileHeader);
+    memcpy(m_file.data(), &header, sizeof(header));
+    m_index.clear();
+    m_live_bytes = 0;
+    return true;
+}
+
+// Rebuild the index from the record headers. Stops at the first record that
+// is not intact and treats everything after it as unwritten.
+bool ArtworkCacheFile::scan() {
+    m_index.clear();
+    m_live_bytes = 0;
+
+    FileHeader header;
+    memcpy(&header, m_file.data(), sizeof(header));
+    uint64_t end = std::min(header.data_end, m_file.size());
+    uint64_t offset = sizeof(FileHeader);
+    uint64_t clock = header.clock;
+    while (offset + sizeof(RecordHeader) <= end) {
+        RecordHeader rh;
+        memcpy(&rh, m_file.data() + offset, sizeof(rh));
+        uint64_t bytes = align8(sizeof(RecordHeader) + uint64_t(rh.payload_bytes));
+        if (rh.magic != RECORD_MAGIC || rh.payload_bytes < PALETTE_BYTES ||
+            rh.pixel_bytes > rh.payload_bytes - PALETTE_BYTES || offset + bytes > end) {
+            break;
+        }
+
+        std::string key(reinterpret_cast<const char*>(rh.key), KEY_BYTES);
+        auto it = m_index.find(key);
+        if (it != m_index.end()) m_live_bytes -= it->second.bytes;  // Superseded by this one
+        m_index[key] = IndexEntry{offset, bytes, rh.last_used};
+        m_live_bytes += bytes;
+        clock = std::max(clock, rh.last_used);
+        offset += bytes;
+    }
+
+    header.data_end = offset;
+    header.clock = clock;
+    memcpy(m_file.data(), &header, sizeof(header));
+    return true;
+}
+
+bool ArtworkCacheFile::open(const std::string& utf8_path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path = utf8_path;
+    if (!m_file.open(utf8_path)) return false;
+
+    FileHeader header = {};
+    bool valid = m_file.size() >= sizeof(FileHeader);
+    if (valid) {
+        memcpy(&header, m_file.data(), sizeof(header));
+        valid = memcmp(header.magic, ARTCACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version == ARTCACHE_VERSION;
+    }
+    bool ok = valid ? scan() : init_empty();
+    if (!ok) m_file.close();
+    return ok;
+}
+
+void ArtworkCacheFile::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file.is_open()) m_file.flush();
+    m_file.close();
+    m_index.clear();
+    m_live_bytes = 0;
+}
+
+void ArtworkCacheFile::set_capacity(uint64_t capacity_bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = capacity_bytes;
+}
+
+void ArtworkCacheFile::drop(const std::string& key) {
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return;
+    m_live_bytes -= it->second.bytes;
+    m_index.erase(it);
+}
+
+bool ArtworkCacheFile::lookup(const std::string& key, ArtworkDerivatives& out) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open() || key.size() != KEY_BYTES) return false;
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return false;
+
+    uint8_t* base = m_file.data() + it->second.offset;
+    RecordHeader rh;
+    memcpy(&rh, base, sizeof(rh));
+    const uint8_t* payload = base + sizeof(RecordHeader);
+    uint64_t pixel_count = uint64_t(rh.width) * rh.height;
+    uint64_t blur_count = uint64_t(rh.blur_size) * rh.blur_size;
+    if (rh.magic != RECORD_MAGIC || memcmp(rh.key, key.data(), KEY_BYTES) != 0 ||
+        rh.checksum != record_checksum(rh, payload) || pixel_count == 0 || pixel_count > (1u << 24) ||
+        blur_count > (1u << 20)) {
+        drop(key);
+        return false;
+    }
+
+    ArtworkDerivatives value;
+    value.width = rh.width;
+    value.height = rh.height;
+    value.pixels.resize(static_cast<size_t>(pixel_count) * 4);
+    value.primary = rh.primary;
+    value.secondary = rh.secondary;
+    value.colors_valid = (rh.flags & RECORD_COLORS_VALID) != 0;
+    value.blur_size = rh.blur_size;
+    value.blur_radius = (rh.flags >> RECORD_BLUR_RADIUS_SHIFT) & 0xFF;
+    value.blur.resize(static_cast<size_t>(blur_count) * 4);
+    memcpy(&value.palette, payload, PALETTE_BYTES);
+    const uint8_t* pixels = payload + PALETTE_BYTES;
+    const uint8_t* blur = pixels + rh.pixel_bytes;
+    const ArtworkPalette& pal = value.palette;
+    bool palette_ok = pal.count <= ArtworkPalette::MAX_SWATCHES && pal.dominant < static_cast<int32_t>(pal.count) &&
+                      pal.vibrant < static_cast<int32_t>(pal.count) && pal.muted < static_cast<int32_t>(pal.count);
+    if (!palette_ok || !decode_pixels(pixels, rh.pixel_bytes, static_cast<size_t>(pixel_count), value.pixels.data()) ||
+        !decode_pixels(blur, rh.payload_bytes - PALETTE_BYTES - rh.pixel_bytes, static_cast<size_t>(blur_count),
+                       value.blur.data())) {
+        drop(key);
+        return false;
+    }
+    if (value.blur.empty()) value.blur_size = 0;
+
+    // Stamp the use in place; the stamp is outside the checksum
+    FileHeader header;
+    memcpy(&header, m_file.data(), sizeof(header));
+    rh.last_used = ++header.clock;
+    memcpy(base + offsetof(RecordHeader, last_used), &rh.last_used, sizeof(rh.last_used));
+    memcpy(m_file.data(), &header, sizeof(header));
+    it->second.last_used = rh.last_used;
+
+    out = std::move(value);
+    return true;
+}
+
+bool ArtworkCacheFile::store(const std::string& key, const ArtworkDerivatives& value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open() || key.size() != KEY_BYTES) return false;
+    uint64_t pixel_count = uint64_t(value.width) * value.height;
+    uint64_t blur_count = uint64_t(value.blur_size) * value.blur_size;
+    if (pixel_count == 0 || value.pixels.size() != pixel_count * 4 || value.blur.size() != blur_count * 4) {
+        return false;
+    }
+
+    std::vector<uint8_t> payload(PALETTE_BYTES);
+    payload.reserve(value.pixels.size() / 2);
+    memcpy(payload.data(), &value.palette, PALETTE_BYTES);
+    encode_pixels(value.pixels.data(), static_cast<size_t>(pixel_count), payload);
+    size_t pixel_bytes = payload.size() - PALETTE_BYTES;
+    encode_pixels(value.blur.data(), static_cast<size_t>(blur_count), payload);
+    if (payload.size() > UINT32_MAX) return false;
+
+    uint64_t bytes = align8(sizeof(RecordHeader) + payload.size());
+    if (sizeof(FileHeader) + bytes > m_capacity) return false;
+
+    drop(key);  // An older record for the key becomes garbage
+
+    FileHeader header;
+    memcpy(&header, m_file.data(), sizeof(header));
+    if (header.data_end + bytes > m_capacity) {
+        // Keep the most recently used records in three quarters of the cap
+        uint64_t keep = m_capacity / 4 * 3;
+        keep = keep > sizeof(FileHeader) + bytes ? keep - sizeof(FileHeader) - bytes : 0;
+        if (!compact(keep)) return false;
+        memcpy(&header, m_file.data(), sizeof(header));
+    }
+
+    uint64_t needed = header.data_end + bytes;
+    if (m_file.size() < needed) {
+        uint64_t grown = std::max(needed, std::min(m_file.size() + GROW_STEP, m_capacity));
+        if (!m_file.resize(grown)) {
+            m_index.clear();
+            m_live_bytes = 0;
+            return false;
+        }
+    }
+
+    RecordHeader rh = {};
+    rh.magic = RECORD_MAGIC;
+    rh.payload_bytes = static_cast<uint32_t>(payload.size());
+    memcpy(rh.key, key.data(), KEY_BYTES);
+    rh.last_used = ++header.clock;
+    rh.width = value.width;
+    rh.height = value.height;
+    rh.primary = value.primary;
+    rh.secondary = value.secondary;
+    rh.flags = (value.colors_valid ? RECORD_COLORS_VALID : 0) |
+               std::min(value.blur_radius, 255u) << RECORD_BLUR_RADIUS_SHIFT;
+    rh.blur_size = blur_count ? value.blur_size : 0;
+    rh.pixel_bytes = static_cast<uint32_t>(pixel_bytes);
+    rh.checksum = record_checksum(rh, payload.data());
+
+    uint8_t* base = m_file.data() + header.data_end;
+    memcpy(base, &rh, sizeof(rh));
+    memcpy(base + sizeof(rh), payload.data(), payload.size());
+    memset(base + sizeof(rh) + payload.size(), 0, bytes - sizeof(rh) - payload.size());
+
+    // Publish the record only once it is complete
+    m_index[key] = IndexEntry{header.data_end, bytes, rh.last_used};
+    m_live_bytes += bytes;
+    header.data_end += bytes;
+    memcpy(m_file.data(), &header, sizeof(header));
+    return true;
+}
+
+// Copy the most recently used records that fit in budget bytes to a new
+// file and swap it in. Starts over empty if that fails.
+bool ArtworkCacheFile::compact(uint64_t budget) {
+    std::vector<std::pair<std::string, IndexEntry>> entries(m_index.begin(), m_index.end());
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& a, const auto& b) { return a.second.last_used > b.second.last_used; });
+    uint64_t total = 0;
+    size_t keep = 0;
+    while (keep < entries.size() && total + entries[keep].second.bytes <= budget) {
+        total += entries[keep].second.bytes;
+        keep++;
+    }
+    entries.resize(keep);
+    // Keep the file order so the log stays sequential
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& a, const auto& b) { return a.second.offset < b.second.offset; });
+
+    std::string tmp_path = m_path + ".tmp";
+    remove_file(tmp_path);
+    bool ok = false;
+    {
+        MappedFile tmp;
+        if (tmp.open(tmp_path, sizeof(FileHeader) + total)) {
+            FileHeader header;
+            memcpy(&header, m_file.data(), sizeof(header));
+            uint64_t offset = sizeof(FileHeader);
+            for (const auto& entry : entries) {
+                memcpy(tmp.data() + offset, m_file.data() + entry.second.offset, entry.second.bytes);
+                offset += entry.second.bytes;
+            }
+            header.data_end = offset;
+            memcpy(tmp.data(), &header, sizeof(header));
+            ok = tmp.flush();
+        }
+    }
+
+    m_file.close();
+    if (ok) ok = replace_file(tmp_path, m_path);
+    if (!ok) remove_file(tmp_path);
+    if (!m_file.open(m_path)) {
+        m_index.clear();
+        m_live_bytes = 0;
+        return false;
+    }
+    if (ok) {
+        FileHeader header;
+        memcpy(&header, m_file.data(), sizeof(header));
+        ok = m_file.size() >= sizeof(FileHeader) &&
+             memcmp(header.magic, ARTCACHE_MAGIC, sizeof(header.magic)) == 0 && scan();
+    }
+    return ok || init_empty();
+}
+
+uint32_t ArtworkCacheFile::entry_count() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<uint32_t>(m_index.size());
+}
+
+uint64_t ArtworkCacheFile::file_bytes() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open()) return 0;
+    FileHeader header;
+    memcpy(&header, m_file.data(), sizeof(header));
+    return header.data_end;
+}
+
+} // namespace nowbar
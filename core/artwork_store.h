@@ -0,0 +1,70 @@
+#pragma once
+// On-disk artwork cache (artcache.db, next to wavecache.db).
+//
+// Keeps the derivatives of recently shown artwork (512 px thumbnail,
+// color palette, blur) across sessions, keyed like ArtworkMemoryCache
+// by a hash of the encoded image, so the first paint after startup does not
+// wait for a full decode.
+//
+// The file is a log of records behind a small header. New records are
+// appended and the header's end offset is moved only once a record is
+// complete, so a torn write is ignored on the next open; each record also
+// carries a checksum that is verified on read. The index (key -> record) is
+// rebuilt by scanning the record headers on open. Lookups stamp the record
+// with a use counter; when the file would outgrow its size cap the most
+// recently used records are copied to a new file that replaces it.
+//
+// Pixels are stored losslessly with a QOI-style encoding (runs, a small
+// color index and short deltas), typically well under the raw size.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include "artwork_cache.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace nowbar {
+
+class ArtworkCacheFile {
+public:
+    explicit ArtworkCacheFile(uint64_t capacity_bytes) : m_capacity(capacity_bytes) {}
+
+    // Open or create the file; an unreadable file is started over.
+    bool open(const std::string& utf8_path);
+    void close();
+
+    // A smaller cap applies at the next store().
+    void set_capacity(uint64_t capacity_bytes);
+
+    bool lookup(const std::string& key, ArtworkDerivatives& out);
+
+    // Skipped if the record alone exceeds the cap.
+    bool store(const std::string& key, const ArtworkDerivatives& value);
+
+    uint32_t entry_count();
+    uint64_t file_bytes();
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t bytes;      // Record header plus payload
+        uint64_t last_used;
+    };
+
+    bool init_empty();
+    bool scan();
+    bool compact(uint64_t budget);
+    void drop(const std::string& key);
+
+    uint64_t m_capacity;
+    std::string m_path;
+    MappedFile m_file;
+    uint64_t m_live_bytes = 0;  // Records still in the index
+    std::unordered_map<std::string, IndexEntry> m_index;
+    std::mutex m_mutex;
+};
+
+} // namespace nowbar
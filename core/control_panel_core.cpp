@@ -1,5 +1,13 @@
 #include "pch.h"
 #include "control_panel_core.h"
+#include "artwork_colors.h"
+#include "artwork_decode.h"
+#include "artwork_store.h"
+#include "image_blur.h"
+#include "image_resample.h"
+#include "waveform_cache.h"
+#include "loudness_meter.h"
+#include "stream_waveform.h"
 #include "../preferences.h"
 #include "../nowbar_color_service.h"
 #include "../resource.h"
@@ -7,7 +15,6 @@
 #include <commdlg.h>
 #include <memory>
 #include <mutex>
-#include <fstream>
 #include <shellapi.h>
 #include <shlobj.h>
 #include <string>
@@ -72,6 +79,65 @@ static std::vector<ControlPanelCore *> g_instances;
 static std::mutex g_instances_mutex;
 static bool g_shutdown = false;  // Prevents access to statics during shutdown
 
+// Process-wide wavecache.db mapping, opened by the first waveform job and
+// shared by all panel instances. Released in shutdown().
+static std::shared_ptr<WaveformCacheFile> g_wavecache_file;
+static std::mutex g_wavecache_mutex;
+static bool g_wavecache_open_attempted = false;
+static std::thread g_wavecache_compact_thread;  // Periodic compaction, joined in shutdown()
+static constexpr uint64_t WAVECACHE_MAX_BYTES = 256ull << 20;  // Least recently used records go first
+
+// Segments per waveform the widest display drawn so far needs (a pyramid
+// level size). wavecache.db stores levels this detailed, so narrow panels
+// keep the file small; a wider panel refines the tracks it shows.
+static std::atomic<uint32_t> g_waveform_detail{WAVEFORM_PYRAMID_COARSE};
+
+static void raise_waveform_detail(uint32_t segments) {
+  uint32_t current = g_waveform_detail.load();
+  while (current < segments && !g_waveform_detail.compare_exchange_weak(current, segments)) {
+  }
+}
+
+// Process-wide LRU of recently shown waveforms, capped by the
+// "Waveform memory cache size" advanced setting.
+static WaveformMemoryCache g_waveform_memory_cache(16u << 20);
+
+// Process-wide LRU of artwork thumbnails, colors and blur by content hash,
+// capped by the "Artwork memory cache size" advanced setting.
+static ArtworkMemoryCache g_artwork_memory_cache(32u << 20);
+
+static size_t artwork_memory_cache_capacity() {
+  return static_cast<size_t>(get_nowbar_artwork_memory_cache_mb()) << 20;
+}
+
+// Process-wide artcache.db, so covers seen in earlier sessions skip the
+// decode. Opened on first use unless the size cap is 0; released in
+// shutdown().
+static std::shared_ptr<ArtworkCacheFile> g_artcache_file;
+static std::mutex g_artcache_mutex;
+static bool g_artcache_open_attempted = false;
+
+static std::shared_ptr<ArtworkCacheFile> get_artcache_file() {
+  uint64_t capacity = static_cast<uint64_t>(get_nowbar_artwork_disk_cache_mb()) << 20;
+  std::lock_guard<std::mutex> lock(g_artcache_mutex);
+  if (g_shutdown || capacity == 0) return nullptr;
+  if (!g_artcache_open_attempted) {
+    g_artcache_open_attempted = true;
+    ensure_config_dir_exists();
+    pfc::string8 path = get_config_dir_path();
+    path << "\\artcache.db";
+    auto file = std::make_shared<ArtworkCacheFile>(capacity);
+    if (file->open(path.c_str())) g_artcache_file = std::move(file);
+  }
+  if (g_artcache_file) g_artcache_file->set_capacity(capacity);
+  return g_artcache_file;
+}
+
+// Shared by all panels: a few decoders at most, one job per track. A decode
+// cancelled while blocked in I/O is replaced rather than holding a slot.
+static constexpr unsigned WAVEFORM_WORKERS = 2;
+static WaveformJobPool g_waveform_jobs(WAVEFORM_WORKERS);
+
 // Forward declare to allow use before full definition
 class theme_change_callback;
 
@@ -129,6 +195,37 @@ void ControlPanelCore::shutdown() {
   // Destroy theme callback while services are still available
   // (ui_config_callback_impl destructor needs to unregister)
   g_theme_callback.reset();
+  // Give aborted waveform jobs a moment to leave the decoder before the
+  // services they use go away
+  g_waveform_jobs.shutdown(std::chrono::milliseconds(2000));
+  // Artwork workers use GDI+; let them finish before the host tears down
+  TaskSlot::wait_all(std::chrono::milliseconds(1000));
+  // Abort scrub preview decodes of panels still open, then give their
+  // workers a moment to leave the decoder
+  std::vector<ControlPanelCore*> instances;
+  {
+    std::lock_guard<std::mutex> lock(g_instances_mutex);
+    instances = g_instances;
+  }
+  for (auto *instance : instances) {
+    instance->abort_scrub_preview();
+  }
+  DebouncedWorker::wait_all(std::chrono::milliseconds(1000));
+  // Unmap the waveform cache so pending writes are flushed and the file is
+  // marked as cleanly closed
+  if (g_wavecache_compact_thread.joinable()) {
+    g_wavecache_compact_thread.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_wavecache_mutex);
+    g_wavecache_file.reset();
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_artcache_mutex);
+    g_artcache_file.reset();
+  }
+  g_waveform_memory_cache.clear();
+  g_artwork_memory_cache.clear();
   // Clear instances while mutex is still valid
   std::lock_guard<std::mutex> lock(g_instances_mutex);
   g_instances.clear();
@@ -297,8 +394,12 @@ ControlPanelCore::~ControlPanelCore() {
   // Stop command state polling timer
   stop_command_state_timer();
   
-  // Cancel any running waveform computation
-  cancel_waveform_computation();
+  // Leave any waveform job; after this its listener is never called again
+  m_waveform_subscription.reset();
+
+  // Abort a scrub preview decode stuck in I/O; the worker thread keeps the
+  // decoder alive until it lets go
+  abort_scrub_preview();
 
   // Release spectrum visualizer stream
   release_vis_stream();
@@ -744,11 +845,11 @@ void ControlPanelCore::on_settings_changed() {
   // Handle waveform mode transitions
   if (settings_vis_mode == 2) {
     bool is_playing_now = m_state.is_playing && !m_state.is_paused;
-    if (is_playing_now && !m_waveform_valid && !m_waveform_computing.load()) {
+    if (is_playing_now && !m_waveform_snapshot.complete() && !m_waveform_computing.load()) {
       start_waveform_computation();
     }
-    // Release vis stream if not needed
-    if (m_vis_stream.is_valid()) {
+    // Release vis stream if not needed (streams read their history from it)
+    if (m_vis_stream.is_valid() && !m_waveform_is_stream) {
       release_vis_stream();
       m_spectrum_opacity = 0.0f;
       m_spectrum_fade_active = false;
@@ -756,13 +857,13 @@ void ControlPanelCore::on_settings_changed() {
     }
   } else {
     // Not in waveform mode - cancel computation and clear
-    if (m_waveform_computing.load() || m_waveform_valid) {
+    if (m_waveform_computing.load() || m_waveform_snapshot.complete()) {
       cancel_waveform_computation();
-      std::lock_guard<std::mutex> lock(m_waveform_mutex);
-      m_waveform_valid = false;
-      m_waveform_peaks.clear();
-      m_waveform_track_path = "";
+      m_waveform_snapshot.clear();
+      m_waveform_track_key.clear();
     }
+    m_waveform_played_bmp.reset();
+    m_waveform_unplayed_bmp.reset();
   }
 
   // Invalidate cached command references so next poll does a fresh lookup
@@ -900,23 +1001,26 @@ void ControlPanelCore::update_fonts() {
   invalidate();
 }
 
-void ControlPanelCore::create_artwork_thumbnail() {
-    m_artwork_thumbnail.reset();
+// Artwork preprocessing. These run on the artwork worker and only touch the
+// bitmaps they are given.
 
-    if (!m_artwork_bitmap || m_artwork_bitmap->GetLastStatus() != Gdiplus::Ok) {
-        return;
+// Longest side of the artwork kept for rendering
+static constexpr int ARTWORK_THUMBNAIL_DIM = 512;
+
+// Downscale to at most 512x512 for rendering; smaller artwork is kept as is.
+static std::unique_ptr<Gdiplus::Bitmap> make_artwork_thumbnail(std::unique_ptr<Gdiplus::Bitmap> source) {
+    if (!source || source->GetLastStatus() != Gdiplus::Ok) {
+        return nullptr;
     }
 
-    int srcW = m_artwork_bitmap->GetWidth();
-    int srcH = m_artwork_bitmap->GetHeight();
+    int srcW = source->GetWidth();
+    int srcH = source->GetHeight();
 
-    const int max_dim = 512;
+    const int max_dim = ARTWORK_THUMBNAIL_DIM;
 
     // Only create thumbnail if source exceeds max_dim in either dimension
     if (srcW <= max_dim && srcH <= max_dim) {
-        // Source is small enough - just move it directly
-        m_artwork_thumbnail = std::move(m_artwork_bitmap);
-        return;
+        return source;
     }
 
     // Calculate thumbnail dimensions preserving aspect ratio
@@ -931,172 +1035,228 @@ void ControlPanelCore::create_artwork_thumbnail() {
     if (thumbW < 1) thumbW = 1;
     if (thumbH < 1) thumbH = 1;
 
-    m_artwork_thumbnail.reset(new Gdiplus::Bitmap(thumbW, thumbH, PixelFormat32bppARGB));
-    Gdiplus::Graphics gfx(m_artwork_thumbnail.get());
-    // Bilinear is much faster than HighQualityBicubic for large downscales and
-    // visually equivalent at this target size (thumbnail is used for small panel
-    // artwork display and as the source for further downscales like blur/colors).
-    gfx.SetInterpolationMode(Gdiplus::InterpolationModeBilinear);
-    gfx.DrawImage(m_artwork_bitmap.get(), 0, 0, thumbW, thumbH);
+    std::unique_ptr<Gdiplus::Bitmap> thumbnail(new Gdiplus::Bitmap(thumbW, thumbH, PixelFormat32bppARGB));
+
+    // Filtered resize straight between the pixel buffers: every source pixel
+    // contributes, unlike GDI+ bilinear which samples 2x2 and aliases when
+    // shrinking by more than half
+    Gdiplus::Rect srcRect(0, 0, srcW, srcH);
+    Gdiplus::Rect dstRect(0, 0, thumbW, thumbH);
+    Gdiplus::BitmapData srcData, dstData;
+    if (source->LockBits(&srcRect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, &srcData) == Gdiplus::Ok) {
+        bool resized = false;
+        if (thumbnail->LockBits(&dstRect, Gdiplus::ImageLockModeWrite, PixelFormat32bppARGB, &dstData) == Gdiplus::Ok) {
+            resized = resample_bgra(static_cast<const uint8_t*>(srcData.Scan0), srcW, srcH, srcData.Stride,
+                                    static_cast<uint8_t*>(dstData.Scan0), thumbW, thumbH, dstData.Stride);
+            thumbnail->UnlockBits(&dstData);
+        }
+        source->UnlockBits(&srcData);
+        if (resized) return thumbnail;
+    }
 
-    // Release full-resolution bitmap to save memory
-    m_artwork_bitmap.reset();
+    Gdiplus::Graphics gfx(thumbnail.get());
+    gfx.SetInterpolationMode(Gdiplus::InterpolationModeBilinear);
+    gfx.DrawImage(source.get(), 0, 0, thumbW, thumbH);
+    return thumbnail;
 }
 
-void ControlPanelCore::extract_artwork_colors() {
-  m_artwork_colors_valid = false;
-
-  // Prefer thumbnail (already downscaled to <=512x512) over full-res bitmap.
-  // create_artwork_thumbnail() should be called before this function so that
-  // we avoid an expensive full-resolution downscale here.
-  Gdiplus::Bitmap* source = m_artwork_thumbnail ? m_artwork_thumbnail.get()
-                          : m_artwork_bitmap     ? m_artwork_bitmap.get()
-                          : nullptr;
+// Palette of the artwork, read straight from the locked thumbnail pixels.
+static bool sample_artwork_palette(Gdiplus::Bitmap* source, ArtworkPalette& palette) {
   if (!source || source->GetLastStatus() != Gdiplus::Ok) {
-    return;
+    return false;
   }
 
-  // Downscale artwork to 8x8 for fast color averaging
-  const int sample_size = 8;
-  std::unique_ptr<Gdiplus::Bitmap> downscaled(new Gdiplus::Bitmap(sample_size, sample_size, PixelFormat32bppARGB));
+  int w = source->GetWidth();
+  int h = source->GetHeight();
+  Gdiplus::Rect rect(0, 0, w, h);
+  Gdiplus::BitmapData data;
+  if (w <= 0 || h <= 0 ||
+      source->LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, &data) != Gdiplus::Ok) {
+    return false;
+  }
+  bool ok = extract_artwork_palette(static_cast<const uint8_t*>(data.Scan0), w, h, data.Stride, palette);
+  source->UnlockBits(&data);
+  return ok;
+}
 
-  {
-    Gdiplus::Graphics gfx(downscaled.get());
-    gfx.SetInterpolationMode(Gdiplus::InterpolationModeBilinear);
-    gfx.DrawImage(source, 0, 0, sample_size, sample_size);
+// Scale the artwork to blur_size x blur_size and blur it into blurBuffer
+// (BGRA). The result is independent of the panel size, so it is made once
+// per artwork and only stretched when the panel is resized.
+static bool blur_artwork(Gdiplus::Bitmap* source, int blur_size, int blur_radius, std::vector<BYTE>& blurBuffer) {
+  blurBuffer.clear();
+  if (!source || source->GetLastStatus() != Gdiplus::Ok) {
+    return false;
   }
+
+  int w = source->GetWidth();
+  int h = source->GetHeight();
+  Gdiplus::Rect rect(0, 0, w, h);
+  Gdiplus::BitmapData data;
+  if (w <= 0 || h <= 0 ||
+      source->LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, &data) != Gdiplus::Ok) {
+    return false;
+  }
+  blurBuffer.resize(static_cast<size_t>(blur_size) * blur_size * 4);
+  bool ok = resample_bgra(static_cast<const uint8_t*>(data.Scan0), w, h, data.Stride, blurBuffer.data(), blur_size,
+                          blur_size, static_cast<ptrdiff_t>(blur_size) * 4);
+  source->UnlockBits(&data);
+
+  // Three box passes approximate a Gaussian; the cost does not depend on
+  // the radius
+  ok = ok && blur_bgra(blurBuffer.data(), blur_size, blur_size, static_cast<ptrdiff_t>(blur_size) * 4, blur_radius);
+  if (!ok) blurBuffer.clear();
+  return ok;
+}
+
+// Colors, blur and a copy of the thumbnail pixels, in the form the artwork
+// cache keeps.
+static std::shared_ptr<ArtworkDerivatives> make_artwork_derivatives(Gdiplus::Bitmap* thumbnail, int blur_size,
+                                                                    int blur_radius) {
+  auto out = std::make_shared<ArtworkDerivatives>();
+
+  // Background gradient from the dominant swatch rather than the mean, which
+  // turns colorful covers brown
+  out->colors_valid = sample_artwork_palette(thumbnail, out->palette);
+  if (out->colors_valid) palette_background_colors(out->palette, out->primary, out->secondary);
+  if (blur_artwork(thumbnail, blur_size, blur_radius, out->blur)) {
+    out->blur_size = static_cast<uint32_t>(blur_size);
+    out->blur_radius = static_cast<uint32_t>(blur_radius);
+  }
+
+  int w = thumbnail->GetWidth();
+  int h = thumbnail->GetHeight();
+  Gdiplus::Rect rect(0, 0, w, h);
+  Gdiplus::BitmapData data;
+  if (w > 0 && h > 0 &&
+      thumbnail->LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, &data) == Gdiplus::Ok) {
+    out->width = static_cast<uint32_t>(w);
+    out->height = static_cast<uint32_t>(h);
+    out->pixels.resize(static_cast<size_t>(w) * h * 4);
+    for (int y = 0; y < h; y++) {
+      memcpy(&out->pixels[static_cast<size_t>(y) * w * 4],
+             static_cast<const BYTE*>(data.Scan0) + static_cast<ptrdiff_t>(y) * data.Stride, static_cast<size_t>(w) * 4);
+    }
+    thumbnail->UnlockBits(&data);
+  }
+  return out;
+}
+
+// Thumbnail bitmap from cached pixels.
+static std::unique_ptr<Gdiplus::Bitmap> bitmap_from_derivatives(const ArtworkDerivatives& d) {
+  if (d.width == 0 || d.height == 0 || d.pixels.size() != static_cast<size_t>(d.width) * d.height * 4) {
+    return nullptr;
+  }
+  int w = static_cast<int>(d.width);
+  int h = static_cast<int>(d.height);
+  std::unique_ptr<Gdiplus::Bitmap> bitmap(new Gdiplus::Bitmap(w, h, PixelFormat32bppARGB));
+  Gdiplus::Rect rect(0, 0, w, h);
+  Gdiplus::BitmapData data;
+  if (bitmap->GetLastStatus() != Gdiplus::Ok ||
+      bitmap->LockBits(&rect, Gdiplus::ImageLockModeWrite, PixelFormat32bppARGB, &data) != Gdiplus::Ok) {
+    return nullptr;
+  }
+  for (int y = 0; y < h; y++) {
+    memcpy(static_cast<BYTE*>(data.Scan0) + static_cast<ptrdiff_t>(y) * data.Stride,
+           &d.pixels[static_cast<size_t>(y) * w * 4], static_cast<size_t>(w) * 4);
+  }
+  bitmap->UnlockBits(&data);
+  return bitmap;
+}
+
+// Center crop of the square blur matching the target aspect ratio.
+static Gdiplus::RectF blur_crop_rect(int blur_size, int target_width, int target_height) {
+  float targetAspect = static_cast<float>(target_width) / static_cast<float>(target_height);
+  float srcX = 0, srcY = 0, srcW = static_cast<float>(blur_size), srcH = static_cast<float>(blur_size);
   
-  // Calculate average color from all pixels
-  int total_r = 0, total_g = 0, total_b = 0;
-  int pixel_count = 0;
-  
-  for (int y = 0; y < sample_size; y++) {
-    for (int x = 0; x < sample_size; x++) {
-      Gdiplus::Color color;
-      downscaled->GetPixel(x, y, &color);
-      
-      // Skip very transparent pixels
-      if (color.GetA() < 128) continue;
-      
-      total_r += color.GetR();
-      total_g += color.GetG();
-      total_b += color.GetB();
-      pixel_count++;
+  if (targetAspect > 1.0f) {
+    // Target is wider than source - crop vertically from center
+    srcH = blur_size / targetAspect;
+    srcY = (blur_size - srcH) / 2.0f;
+  } else {
+    // Target is taller than source - crop horizontally from center
+    srcW = blur_size * targetAspect;
+    srcX = (blur_size - srcW) / 2.0f;
+  }
+  return Gdiplus::RectF(srcX, srcY, srcW, srcH);
+}
+
+// Draw the blurred artwork at width x height. The exact-size bitmap is only
+// rebuilt once the size has been stable for BLUR_SETTLE_MS; while the panel
+// is being resized the intrinsic low-resolution blur is stretched instead,
+// so dragging a splitter does not allocate and fill a panel-sized bitmap
+// per frame.
+void ControlPanelCore::draw_blurred_artwork(Gdiplus::Graphics& g, int x, int y, int width, int height) {
+  bool exact = m_blurred_artwork && m_blurred_artwork_size.cx == width && m_blurred_artwork_size.cy == height;
+  if (!exact && (!m_blurred_artwork || !m_hwnd)) {
+    // New artwork (or no window to time the resize): nothing to stretch yet
+    create_blurred_artwork(width, height);
+    exact = m_blurred_artwork != nullptr;
+  }
+  if (exact) {
+    g.DrawImage(m_blurred_artwork.get(), x, y, width, height);
+    return;
+  }
+
+  if (!m_blurred_artwork_small) {
+    const ArtworkDerivatives* d = m_artwork_derivatives.get();
+    int blur_size = d ? static_cast<int>(d->blur_size) : 0;
+    if (blur_size <= 0 || d->blur.size() != static_cast<size_t>(blur_size) * blur_size * 4) return;
+    m_blurred_artwork_small.reset(new Gdiplus::Bitmap(blur_size, blur_size, PixelFormat32bppARGB));
+    Gdiplus::Rect rect(0, 0, blur_size, blur_size);
+    Gdiplus::BitmapData data;
+    if (m_blurred_artwork_small->LockBits(&rect, Gdiplus::ImageLockModeWrite, PixelFormat32bppARGB, &data) != Gdiplus::Ok) {
+      m_blurred_artwork_small.reset();
+      return;
+    }
+    for (int row = 0; row < blur_size; row++) {
+      memcpy(static_cast<BYTE*>(data.Scan0) + static_cast<ptrdiff_t>(row) * data.Stride,
+             &d->blur[static_cast<size_t>(row) * blur_size * 4], static_cast<size_t>(blur_size) * 4);
     }
+    m_blurred_artwork_small->UnlockBits(&data);
   }
-  
-  if (pixel_count == 0) return;
-  
-  // Calculate average (primary color)
-  int avg_r = total_r / pixel_count;
-  int avg_g = total_g / pixel_count;
-  int avg_b = total_b / pixel_count;
-  
-  // Primary color - the average artwork color
-  m_artwork_color_primary = Gdiplus::Color(255, avg_r, avg_g, avg_b);
-  
-  // Secondary color - darker variant for gradient (30% darker)
-  int dark_r = avg_r * 70 / 100;
-  int dark_g = avg_g * 70 / 100;
-  int dark_b = avg_b * 70 / 100;
-  m_artwork_color_secondary = Gdiplus::Color(255, dark_r, dark_g, dark_b);
-  
-  m_artwork_colors_valid = true;
-  nowbar_notify_color_changed();
+
+  // Mirrored edges keep GDI+ bilinear from fading the borders
+  Gdiplus::ImageAttributes ia;
+  ia.SetWrapMode(Gdiplus::WrapModeTileFlipXY);
+  Gdiplus::RectF src = blur_crop_rect(static_cast<int>(m_blurred_artwork_small->GetWidth()), width, height);
+  Gdiplus::InterpolationMode old_mode = g.GetInterpolationMode();
+  g.SetInterpolationMode(Gdiplus::InterpolationModeBilinear);
+  g.DrawImage(m_blurred_artwork_small.get(), Gdiplus::RectF(static_cast<float>(x), static_cast<float>(y),
+              static_cast<float>(width), static_cast<float>(height)),
+              src.X, src.Y, src.Width, src.Height, Gdiplus::UnitPixel, &ia);
+  g.SetInterpolationMode(old_mode);
+
+  // Restarts on every resized frame; fires once the drag settles
+  SetTimer(m_hwnd, BLUR_SETTLE_TIMER_ID, BLUR_SETTLE_MS, nullptr);
+}
+
+void ControlPanelCore::on_blur_settle_timer() {
+  KillTimer(m_hwnd, BLUR_SETTLE_TIMER_ID);
+  // Rebuild at the settled size on the next paint
+  m_blurred_artwork.reset();
+  m_blurred_artwork_size = {0, 0};
+  m_target_background.reset();
+  m_bg_cache_valid = false;
+  invalidate();
 }
 
 void ControlPanelCore::create_blurred_artwork(int target_width, int target_height) {
   m_blurred_artwork.reset();
   m_blurred_artwork_size = {0, 0};
 
-  if (!m_artwork_thumbnail || m_artwork_thumbnail->GetLastStatus() != Gdiplus::Ok) {
+  if (!m_artwork_derivatives) {
     return;
   }
-  
-  if (target_width <= 0 || target_height <= 0) {
+  const int blur_size = static_cast<int>(m_artwork_derivatives->blur_size);
+  if (blur_size <= 0 || m_artwork_derivatives->blur.size() != static_cast<size_t>(blur_size * blur_size * 4)) {
     return;
   }
   
-  // First, scale source artwork to intermediate size for blur using GDI+ (fast)
-  const int blur_size = 64;
-  std::unique_ptr<Gdiplus::Bitmap> scaled(new Gdiplus::Bitmap(blur_size, blur_size, PixelFormat32bppARGB));
-  
-  {
-    Gdiplus::Graphics gfx(scaled.get());
-    gfx.SetInterpolationMode(Gdiplus::InterpolationModeBilinear);
-    gfx.DrawImage(m_artwork_thumbnail.get(), 0, 0, blur_size, blur_size);
-  }
-  
-  // Lock the scaled bitmap for direct memory access
-  Gdiplus::Rect lockRect(0, 0, blur_size, blur_size);
-  Gdiplus::BitmapData scaledData;
-  if (scaled->LockBits(&lockRect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, &scaledData) != Gdiplus::Ok) {
-    return;  // Failed to lock, fall back gracefully
-  }
-  
-  // Create temp buffer for blur (we need two passes: horizontal then vertical)
-  std::vector<BYTE> tempBuffer(blur_size * blur_size * 4);
-  std::vector<BYTE> blurBuffer(blur_size * blur_size * 4);
-  
-  BYTE* srcPixels = static_cast<BYTE*>(scaledData.Scan0);
-  int srcStride = scaledData.Stride;
-  
-  const int radius = 4;
-  const int diameter = radius * 2 + 1;
-  
-  // Pass 1: Horizontal blur into tempBuffer
-  for (int y = 0; y < blur_size; y++) {
-    for (int x = 0; x < blur_size; x++) {
-      int total_r = 0, total_g = 0, total_b = 0, total_a = 0;
-      int count = 0;
-      
-      for (int dx = -radius; dx <= radius; dx++) {
-        int sx = x + dx;
-        if (sx >= 0 && sx < blur_size) {
-          BYTE* pixel = srcPixels + y * srcStride + sx * 4;
-          total_b += pixel[0];
-          total_g += pixel[1];
-          total_r += pixel[2];
-          total_a += pixel[3];
-          count++;
-        }
-      }
-      
-      int dstIdx = (y * blur_size + x) * 4;
-      tempBuffer[dstIdx + 0] = static_cast<BYTE>(total_b / count);
-      tempBuffer[dstIdx + 1] = static_cast<BYTE>(total_g / count);
-      tempBuffer[dstIdx + 2] = static_cast<BYTE>(total_r / count);
-      tempBuffer[dstIdx + 3] = static_cast<BYTE>(total_a / count);
-    }
-  }
-  
-  // Pass 2: Vertical blur from tempBuffer into blurBuffer
-  for (int y = 0; y < blur_size; y++) {
-    for (int x = 0; x < blur_size; x++) {
-      int total_r = 0, total_g = 0, total_b = 0, total_a = 0;
-      int count = 0;
-      
-      for (int dy = -radius; dy <= radius; dy++) {
-        int sy = y + dy;
-        if (sy >= 0 && sy < blur_size) {
-          int srcIdx = (sy * blur_size + x) * 4;
-          total_b += tempBuffer[srcIdx + 0];
-          total_g += tempBuffer[srcIdx + 1];
-          total_r += tempBuffer[srcIdx + 2];
-          total_a += tempBuffer[srcIdx + 3];
-          count++;
-        }
-      }
-      
-      int dstIdx = (y * blur_size + x) * 4;
-      blurBuffer[dstIdx + 0] = static_cast<BYTE>(total_b / count);
-      blurBuffer[dstIdx + 1] = static_cast<BYTE>(total_g / count);
-      blurBuffer[dstIdx + 2] = static_cast<BYTE>(total_r / count);
-      blurBuffer[dstIdx + 3] = static_cast<BYTE>(total_a / count);
-    }
+  if (target_width <= 0 || target_height <= 0) {
+    return;
   }
   
-  scaled->UnlockBits(&scaledData);
+  const std::vector<uint8_t>& blurBuffer = m_artwork_derivatives->blur;
   
   // Create output bitmap at exact target size
   m_blurred_artwork.reset(new Gdiplus::Bitmap(target_width, target_height, PixelFormat32bppARGB));
@@ -1114,57 +1274,11 @@ void ControlPanelCore::create_blurred_artwork(int target_width, int target_heigh
   BYTE* outPixels = static_cast<BYTE*>(outData.Scan0);
   int outStride = outData.Stride;
   
-  // Calculate source crop from the blurred buffer (center-crop to match target aspect)
-  float targetAspect = static_cast<float>(target_width) / static_cast<float>(target_height);
-  float srcX = 0, srcY = 0, srcW = static_cast<float>(blur_size), srcH = static_cast<float>(blur_size);
-  
-  if (targetAspect > 1.0f) {
-    // Target is wider than source - crop vertically from center
-    srcH = blur_size / targetAspect;
-    srcY = (blur_size - srcH) / 2.0f;
-  } else {
-    // Target is taller than source - crop horizontally from center
-    srcW = blur_size * targetAspect;
-    srcX = (blur_size - srcW) / 2.0f;
-  }
-  
-  // Direct pixel sampling with bilinear interpolation using memory access
-  for (int y = 0; y < target_height; y++) {
-    BYTE* outRow = outPixels + y * outStride;
-    float sy_base = srcY + (y / static_cast<float>(target_height)) * srcH;
-    
-    for (int x = 0; x < target_width; x++) {
-      // Map target coordinates to source coordinates
-      float sx = srcX + (x / static_cast<float>(target_width)) * srcW;
-      float sy = sy_base;
-      
-      // Bilinear interpolation coordinates
-      int x0 = static_cast<int>(sx);
-      int y0 = static_cast<int>(sy);
-      int x1 = (std::min)(x0 + 1, blur_size - 1);
-      int y1 = (std::min)(y0 + 1, blur_size - 1);
-      x0 = (std::max)(0, (std::min)(x0, blur_size - 1));
-      y0 = (std::max)(0, (std::min)(y0, blur_size - 1));
-      
-      float fx = sx - static_cast<int>(sx);
-      float fy = sy - static_cast<int>(sy);
-      float fx_inv = 1.0f - fx;
-      float fy_inv = 1.0f - fy;
-      
-      // Get pointers to the 4 source pixels
-      int idx00 = (y0 * blur_size + x0) * 4;
-      int idx10 = (y0 * blur_size + x1) * 4;
-      int idx01 = (y1 * blur_size + x0) * 4;
-      int idx11 = (y1 * blur_size + x1) * 4;
-      
-      // Bilinear interpolation for each channel (BGRA format)
-      for (int c = 0; c < 4; c++) {
-        float top = blurBuffer[idx00 + c] * fx_inv + blurBuffer[idx10 + c] * fx;
-        float bottom = blurBuffer[idx01 + c] * fx_inv + blurBuffer[idx11 + c] * fx;
-        outRow[x * 4 + c] = static_cast<BYTE>(top * fy_inv + bottom * fy);
-      }
-    }
-  }
+  // Center crop from the blurred buffer, stretched with the fixed-point
+  // bilinear kernel (per-column/row coefficient tables)
+  Gdiplus::RectF src = blur_crop_rect(blur_size, target_width, target_height);
+  stretch_bilinear_bgra(blurBuffer.data(), blur_size, blur_size, static_cast<ptrdiff_t>(blur_size) * 4, src.X, src.Y,
+                        src.Width, src.Height, outPixels, target_width, target_height, outStride);
   
   m_blurred_artwork->UnlockBits(&outData);
 }
@@ -2370,15 +2484,7 @@ void ControlPanelCore::draw_background(Gdiplus::Graphics &g, const RECT &rect) {
       target.FillRectangle(&overlayBrush, draw_rect);
     } else if (bg_style == 2 && m_artwork_thumbnail) {
       // Blurred Artwork mode
-      if (!m_blurred_artwork || 
-          m_blurred_artwork_size.cx != width || 
-          m_blurred_artwork_size.cy != height) {
-        const_cast<ControlPanelCore*>(this)->create_blurred_artwork(width, height);
-      }
-      
-      if (m_blurred_artwork) {
-        target.DrawImage(m_blurred_artwork.get(), draw_x, draw_y, width, height);
-      }
+      draw_blurred_artwork(target, draw_x, draw_y, width, height);
       
       BYTE overlay_alpha = m_dark_mode ? 140 : 180;
       Gdiplus::Color overlayColor(overlay_alpha, 0, 0, 0);
@@ -2490,15 +2596,7 @@ void ControlPanelCore::draw_background(Gdiplus::Graphics &g, const RECT &rect) {
           Gdiplus::SolidBrush overlayBrush(overlayColor);
           cache_g.FillRectangle(&overlayBrush, cache_r);
         } else if (bg_style == 2 && m_artwork_thumbnail) {
-          // Ensure blurred artwork is created if it doesn't exist or needs resize
-          if (!m_blurred_artwork || 
-              m_blurred_artwork_size.cx != width || 
-              m_blurred_artwork_size.cy != height) {
-            create_blurred_artwork(width, height);
-          }
-          if (m_blurred_artwork) {
-            cache_g.DrawImage(m_blurred_artwork.get(), 0, 0);
-          }
+          draw_blurred_artwork(cache_g, 0, 0, width, height);
           BYTE overlay_alpha = m_dark_mode ? 140 : 180;
           Gdiplus::Color overlayColor(overlay_alpha, 0, 0, 0);
           Gdiplus::SolidBrush overlayBrush(overlayColor);
@@ -3799,6 +3897,8 @@ void ControlPanelCore::draw_seekbar_tooltip(Gdiplus::Graphics &g) {
   int seekbar_left = static_cast<int>(m_rect_seekbar.left);
   int seekbar_right = static_cast<int>(m_rect_seekbar.right);
   tooltip_x = std::max(seekbar_left, std::min(tooltip_x, seekbar_right - tooltip_w));
+  draw_scrub_preview(g, tooltip_x + tooltip_w / 2, tooltip_y - static_cast<int>(6 * m_dpi_scale),
+                     seekbar_left, seekbar_right);
 
   // Draw tooltip background (semi-transparent, themed)
   Gdiplus::Color bgColor = m_dark_mode ? Gdiplus::Color(220, 60, 60, 60) : Gdiplus::Color(220, 40, 40, 40);
@@ -5216,6 +5316,89 @@ void ControlPanelCore::update_waveform_brushes() {
     m_waveform_brushes_dirty = false;
 }
 
+// Draw all display bars of the waveform into two transparent bitmaps, one in
+// the played color and one in the unplayed color. Coordinates are relative
+// to m_rect_waveform, matching what draw_waveform_bar() used to draw directly.
+void ControlPanelCore::rasterize_waveform(const WaveformLevel& level, const WaveformRasterKey& key,
+                                          float bar_w_f, float gap, int display_count) {
+  m_waveform_raster_key = key;
+  m_waveform_played_bmp.reset(new Gdiplus::Bitmap(key.width, key.height, PixelFormat32bppPARGB));
+  m_waveform_unplayed_bmp.reset(new Gdiplus::Bitmap(key.width, key.height, PixelFormat32bppPARGB));
+
+  float bar_total_w = bar_w_f + gap;
+  float h = (float)key.height;
+
+  // RMS in the envelope style is drawn on the peak planes' scale; in the
+  // curved domain that is a constant factor
+  float rms_in_envelope = std::pow(level.rms_scale, WAVEFORM_PEAK_CURVE);
+
+  // Compute the bar rectangles once; both bitmaps get the same shapes.
+  // The envelope style adds a translucent peak rectangle behind each bar.
+  std::vector<Gdiplus::RectF> bars;
+  std::vector<Gdiplus::RectF> envelope;
+  bars.reserve(display_count);
+  if (key.style == 2) envelope.reserve(display_count);
+  for (int i = 0; i < display_count; i++) {
+    // Every segment under the bar counts: peaks keep their largest value
+    // and the RMS its mean square, so transients are not averaged away
+    WaveformBar sample = waveform_bar(level, (size_t)i, (size_t)display_count);
+    float peak = sample.rms * key.gain;
+
+    if (key.style == 2) {
+      // Style 3: True peak envelope (asymmetric) with the RMS body inside
+      float half = h * 0.5f;
+      float min_half_h = 0.75f * key.dpi_scale;
+      float up = std::max(sample.peak_max * key.gain * half, min_half_h);
+      float down = std::max(sample.peak_min * key.gain * half, min_half_h);
+      envelope.emplace_back(i * bar_total_w, half - up, bar_w_f, up + down);
+      float body = std::max(peak * rms_in_envelope * half, min_half_h);
+      bars.emplace_back(i * bar_total_w, half - body, bar_w_f, body * 2.0f);
+    } else if (key.style == 1) {
+      // Style 2: Centered continuous mirrored waveform envelope
+      float half_h = peak * h * 0.5f;
+      float min_half_h = 0.75f * key.dpi_scale;
+      if (half_h < min_half_h) half_h = min_half_h;
+      bars.emplace_back(i * bar_total_w, h * 0.5f - half_h, bar_w_f, half_h * 2.0f);
+    } else {
+      // Style 1: SoundCloud bottom-aligned discrete bars with gaps
+      float bar_h = peak * h;
+      float min_bar_h = 1.0f * key.dpi_scale;
+      if (bar_h < min_bar_h) bar_h = min_bar_h;
+      bars.emplace_back(i * bar_total_w + gap * 0.5f, h - bar_h, bar_w_f, bar_h);
+    }
+  }
+
+  auto fill = [&](Gdiplus::Bitmap* bmp, COLORREF color, Gdiplus::Brush* brush) {
+    Gdiplus::Graphics bg(bmp);
+    if (key.style != 0) {
+      bg.SetSmoothingMode(Gdiplus::SmoothingModeNone);
+      bg.SetPixelOffsetMode(Gdiplus::PixelOffsetModeNone);
+    } else {
+      bg.SetSmoothingMode((Gdiplus::SmoothingMode)key.smoothing);
+    }
+    if (!envelope.empty()) {
+      Gdiplus::SolidBrush envelope_brush(Gdiplus::Color(96, GetRValue(color), GetGValue(color), GetBValue(color)));
+      bg.FillRectangles(&envelope_brush, envelope.data(), (INT)envelope.size());
+    }
+    if (!bars.empty()) bg.FillRectangles(brush, bars.data(), (INT)bars.size());
+  };
+  fill(m_waveform_played_bmp.get(), key.played_color, m_waveform_brush_accent.get());
+  fill(m_waveform_unplayed_bmp.get(), key.unplayed_color, m_waveform_brush_dim.get());
+}
+
+// Height multiplier for the loudness scaling modes. Heard loudness is the
+// measured loudness, plus the ReplayGain adjustment in that mode; anything
+// at or above WAVEFORM_FULL_SCALE_LUFS fills the bar. The factor goes
+// through the same curve as the peaks so it matches how heights are drawn.
+float ControlPanelCore::waveform_display_gain(float loudness) const {
+  int mode = get_nowbar_waveform_scaling();
+  if (mode == 0 || loudness == 0.0f) return 1.0f;
+  float heard = loudness;
+  if (mode == 2 && m_waveform_has_replaygain) heard += m_waveform_replaygain_db;
+  float linear = std::pow(10.0f, (heard - WAVEFORM_FULL_SCALE_LUFS) / 20.0f);
+  return std::pow(std::min(1.0f, linear), WAVEFORM_PEAK_CURVE);
+}
+
 void ControlPanelCore::draw_waveform_bar(Gdiplus::Graphics& g) {
   if (m_rect_waveform.right <= m_rect_waveform.left) return;
 
@@ -5243,146 +5426,141 @@ void ControlPanelCore::draw_waveform_bar(Gdiplus::Graphics& g) {
   COLORREF wave_color = get_nowbar_custom_waveform_color_enabled()
       ? get_nowbar_waveform_color() : m_theme_highlight;
 
-  // Lock and read waveform data
-  std::vector<float> peaks;
-  bool valid;
-  bool is_stream;
-  {
-    std::lock_guard<std::mutex> lock(m_waveform_mutex);
-    peaks = m_waveform_peaks;
-    valid = m_waveform_valid;
-    is_stream = m_waveform_is_stream;
-  }
-
-  if (is_stream) {
-    // Streams: no waveform data available, skip rendering entirely
-    m_waveform_animating = false;
-    return;
-  } else {
-    // Advance reveal cursor toward decode count (ease-out)
-    float decode_target = static_cast<float>(m_waveform_decode_count.load(std::memory_order_relaxed));
-    if (decode_target > 0.0f && !m_waveform_reveal_active && m_waveform_reveal_pos < decode_target - 0.5f) {
-      m_waveform_reveal_active = true;  // Activate on main thread when decode starts producing data
-    }
-    if (m_waveform_reveal_pos < decode_target) {
-      m_waveform_reveal_pos += (decode_target - m_waveform_reveal_pos) * 0.15f;
-      if (decode_target - m_waveform_reveal_pos < 0.5f) {
-        m_waveform_reveal_pos = decode_target;
-      }
-    }
+  // Streams: pull the audio played since the last frame into the rolling
+  // history (publishes a new snapshot when a slot completes)
+  bool is_stream = m_waveform_is_stream;
+  bool stream_live = is_stream && m_state.is_playing && !m_state.is_paused;
+  if (stream_live) update_stream_waveform();
 
-    bool still_animating = (m_waveform_reveal_pos < decode_target);
+  // Read the current snapshot in place; no lock, no copy of the peaks
+  static const WaveformPyramid no_waveform;
+  WaveformSnapshotCell::Reader snapshot(m_waveform_snapshot);
+  const WaveformPyramid& pyramid = snapshot ? *snapshot->pyramid : no_waveform;
 
-    // Draw waveform bars with reveal cutoff
-    int wave_style = get_nowbar_waveform_style();
-    int wave_w_setting = get_nowbar_waveform_width();
+  if (is_stream) {
+    // The history is audio already heard: fully revealed, all played
+    m_waveform_reveal_pos = (float)WAVEFORM_SEGMENTS;
+    m_waveform_reveal_active = false;
+    progress = 1.0;
+  }
 
-    float bar_w_f, gap;
-    if (wave_style == 1) {
-      // Style 2: Centered mirrored waveform envelope bar width & gap
-      bar_w_f = (wave_w_setting == 0) ? (1.0f * m_dpi_scale) :
-                (wave_w_setting == 2) ? (4.0f * m_dpi_scale) :
-                                        (2.0f * m_dpi_scale);
-      gap = (wave_w_setting == 0) ? (0.5f * m_dpi_scale) :
-            (wave_w_setting == 2) ? (1.5f * m_dpi_scale) :
-                                    (1.0f * m_dpi_scale);
-    } else {
-      // Style 1: SoundCloud bottom-aligned bars width & gap
-      bar_w_f = (wave_w_setting == 0) ? 0.5f :
-                (wave_w_setting == 2) ? 2.0f :
-                                        1.0f;
-      gap = 1.0f;
+  // Advance reveal cursor toward decode count (ease-out)
+  float decode_target = static_cast<float>(m_waveform_decode_count.load(std::memory_order_relaxed));
+  if (decode_target > 0.0f && !m_waveform_reveal_active && m_waveform_reveal_pos < decode_target - 0.5f) {
+    m_waveform_reveal_active = true;  // Activate on main thread when decode starts producing data
+  }
+  if (m_waveform_reveal_pos < decode_target) {
+    m_waveform_reveal_pos += (decode_target - m_waveform_reveal_pos) * 0.15f;
+    if (decode_target - m_waveform_reveal_pos < 0.5f) {
+      m_waveform_reveal_pos = decode_target;
     }
+  }
 
-    float bar_total_w = bar_w_f + gap;
-    int display_count = (int)((float)w / bar_total_w);
-    if (display_count < 1) display_count = 1;
-    int num_segments = (int)peaks.size();
-    if (num_segments < 1) num_segments = 1;
-
-    // Map reveal_pos (in segment space 0-400) to display bar index
-    float reveal_bar_limit = (m_waveform_reveal_pos / (float)WAVEFORM_SEGMENTS) * display_count;
-
-    if (wave_style == 1) {
-      // Style 2: Centered continuous mirrored waveform envelope
-      float center_y = m_rect_waveform.top + h * 0.5f;
-      float max_half_h = (float)h * 0.5f;
-      float min_half_h = 0.75f * m_dpi_scale;
-
-      Gdiplus::SmoothingMode oldSmoothing = g.GetSmoothingMode();
-      Gdiplus::PixelOffsetMode oldPixelOffset = g.GetPixelOffsetMode();
-      g.SetSmoothingMode(Gdiplus::SmoothingModeNone);
-      g.SetPixelOffsetMode(Gdiplus::PixelOffsetModeNone);
-
-      for (int i = 0; i < display_count; i++) {
-        if ((float)i >= reveal_bar_limit) break;
-
-        float src = (float)i / display_count * num_segments;
-        int lo = (int)src;
-        int hi = lo + 1;
-        if (lo >= num_segments) lo = num_segments - 1;
-        if (hi >= num_segments) hi = num_segments - 1;
-        float frac = src - lo;
-        float peak = peaks[lo] * (1.0f - frac) + peaks[hi] * frac;
-
-        float half_h = peak * max_half_h;
-        if (half_h < min_half_h) half_h = min_half_h;
-
-        float bx = m_rect_waveform.left + i * bar_total_w;
-        float by = center_y - half_h;
-        float slice_h = half_h * 2.0f;
-
-        float seg_progress = (float)(i + 0.5f) / display_count;
-        bool played = (seg_progress <= (float)progress);
-
-        g.FillRectangle(played ? m_waveform_brush_accent.get() : m_waveform_brush_dim.get(),
-                        bx, by, bar_w_f, slice_h);
-      }
-
-      g.SetSmoothingMode(oldSmoothing);
-      g.SetPixelOffsetMode(oldPixelOffset);
-    } else {
-      // Style 1: SoundCloud bottom-aligned discrete bars with gaps
-      float min_bar_h = 1.0f * m_dpi_scale;
-
-      for (int i = 0; i < display_count; i++) {
-        if ((float)i >= reveal_bar_limit) break;
-
-        float src = (float)i / display_count * num_segments;
-        int lo = (int)src;
-        int hi = lo + 1;
-        if (lo >= num_segments) lo = num_segments - 1;
-        if (hi >= num_segments) hi = num_segments - 1;
-        float frac = src - lo;
-        float peak = peaks[lo] * (1.0f - frac) + peaks[hi] * frac;
-
-        float bar_h = peak * (float)h;
-        if (bar_h < min_bar_h) bar_h = min_bar_h;
+  bool still_animating = (m_waveform_reveal_pos < decode_target);
 
-        float bx = m_rect_waveform.left + i * bar_total_w + gap * 0.5f;
-        float by = m_rect_waveform.bottom - bar_h;
+  // Draw waveform bars with reveal cutoff
+  int wave_style = get_nowbar_waveform_style();
+  int wave_w_setting = get_nowbar_waveform_width();
 
-        float seg_progress = (float)(i + 0.5f) / display_count;
-        bool played = (seg_progress <= (float)progress);
+  float bar_w_f, gap;
+  if (wave_style != 0) {
+    // Styles 2 and 3: Centered waveform envelope bar width & gap
+    bar_w_f = (wave_w_setting == 0) ? (1.0f * m_dpi_scale) :
+              (wave_w_setting == 2) ? (4.0f * m_dpi_scale) :
+                                      (2.0f * m_dpi_scale);
+    gap = (wave_w_setting == 0) ? (0.5f * m_dpi_scale) :
+          (wave_w_setting == 2) ? (1.5f * m_dpi_scale) :
+                                  (1.0f * m_dpi_scale);
+  } else {
+    // Style 1: SoundCloud bottom-aligned bars width & gap
+    bar_w_f = (wave_w_setting == 0) ? 0.5f :
+              (wave_w_setting == 2) ? 2.0f :
+                                      1.0f;
+    gap = 1.0f;
+  }
+
+  float bar_total_w = bar_w_f + gap;
+  int display_count = (int)((float)w / bar_total_w);
+  if (display_count < 1) display_count = 1;
+
+  // Use the coarsest pyramid level that still has a segment per bar
+  const WaveformLevel& level = pyramid.level_for(display_count);
+
+  // A waveform loaded from the cache may be coarser than this display; ask
+  // once per track for a decode at full detail
+  uint32_t detail = waveform_pyramid_size_for((size_t)display_count);
+  raise_waveform_detail(detail);
+  if (!is_stream && snapshot && snapshot->complete && !pyramid.empty() && pyramid.finest().size() < detail &&
+      m_waveform_detail_key != m_waveform_track_key) {
+    m_waveform_detail_key = m_waveform_track_key;
+    m_waveform_refine_pending = true;
+    if (m_hwnd) ::PostMessage(m_hwnd, WM_NOWBAR_WAVEFORM, 0, 0);
+  }
+
+  // Map reveal_pos (in segment space 0-400) to display bar index
+  float reveal_bar_limit = (m_waveform_reveal_pos / (float)WAVEFORM_SEGMENTS) * display_count;
+
+  // Rasterize every bar once per (peaks, size, style, colors); each frame
+  // is then just two clipped blits split at the progress position
+  COLORREF unplayed_color = get_nowbar_custom_waveform_unplayed_enabled()
+      ? get_nowbar_waveform_unplayed_color() : m_track_color;
+  WaveformRasterKey key;
+  key.version = snapshot ? snapshot->version : 0;
+  key.width = w;
+  key.height = h;
+  key.style = wave_style;
+  key.bar_width = wave_w_setting;
+  key.dpi_scale = m_dpi_scale;
+  key.played_color = wave_color;
+  key.unplayed_color = unplayed_color;
+  key.smoothing = (int)g.GetSmoothingMode();
+  key.gain = waveform_display_gain(pyramid.loudness());
+  if (!m_waveform_played_bmp || !m_waveform_unplayed_bmp || !(key == m_waveform_raster_key)) {
+    rasterize_waveform(level, key, bar_w_f, gap, display_count);
+  }
+
+  // Bars sit on a fixed pitch, so cutting in the gap after the last
+  // played (or revealed) bar reproduces the per-bar decision exactly
+  int revealed = std::min(display_count, std::max(0, (int)std::ceil(reveal_bar_limit)));
+  int played = std::min(revealed, std::max(0, (int)std::floor(progress * display_count + 0.5)));
+  float gap_mid = (wave_style != 0) ? -gap * 0.5f : 0.0f;
+  auto cut_x = [&](int bars) {
+    if (bars >= display_count) return w;
+    return std::max(0, std::min(w, (int)std::lround(bars * bar_total_w + gap_mid)));
+  };
+  int split_x = cut_x(played);
+  int reveal_x = cut_x(revealed);
 
-        g.FillRectangle(played ? m_waveform_brush_accent.get() : m_waveform_brush_dim.get(),
-                        bx, by, bar_w_f, bar_h);
-      }
-    }
+  Gdiplus::InterpolationMode oldInterp = g.GetInterpolationMode();
+  Gdiplus::PixelOffsetMode oldOffset = g.GetPixelOffsetMode();
+  g.SetInterpolationMode(Gdiplus::InterpolationModeNearestNeighbor);
+  g.SetPixelOffsetMode(Gdiplus::PixelOffsetModeHalf);
+  if (split_x > 0) {
+    Gdiplus::Rect dest(m_rect_waveform.left, m_rect_waveform.top, split_x, h);
+    g.DrawImage(m_waveform_played_bmp.get(), dest, 0, 0, split_x, h, Gdiplus::UnitPixel);
+  }
+  if (reveal_x > split_x) {
+    Gdiplus::Rect dest(m_rect_waveform.left + split_x, m_rect_waveform.top, reveal_x - split_x, h);
+    g.DrawImage(m_waveform_unplayed_bmp.get(), dest, split_x, 0, reveal_x - split_x, h, Gdiplus::UnitPixel);
+  }
+  g.SetInterpolationMode(oldInterp);
+  g.SetPixelOffsetMode(oldOffset);
 
-    // Keep animating if reveal hasn't caught up to decoded segments
-    if (still_animating || m_waveform_reveal_active) {
-      m_waveform_animating = true;
-      request_animation();
-      // Clear reveal_active once fully revealed
-      if (m_waveform_reveal_pos >= (float)WAVEFORM_SEGMENTS) {
-        m_waveform_reveal_active = false;
-      }
-    } else {
-      m_waveform_animating = false;
+  // Keep animating while a stream plays (the history scrolls) or if reveal
+  // hasn't caught up to decoded segments
+  if (is_stream) {
+    m_waveform_animating = stream_live;
+    if (stream_live) request_animation();
+  } else if (still_animating || m_waveform_reveal_active) {
+    m_waveform_animating = true;
+    request_animation();
+    // Clear reveal_active once fully revealed
+    if (m_waveform_reveal_pos >= (float)WAVEFORM_SEGMENTS) {
+      m_waveform_reveal_active = false;
     }
+  } else {
+    m_waveform_animating = false;
   }
-
 }
 
 void ControlPanelCore::draw_waveform_tooltip(Gdiplus::Graphics& g) {
@@ -5413,6 +5591,8 @@ void ControlPanelCore::draw_waveform_tooltip(Gdiplus::Graphics& g) {
   int tooltip_x = cursor_x - tooltip_w / 2;
   int tooltip_y = m_rect_waveform.top - tooltip_h - static_cast<int>(6 * m_dpi_scale);
   tooltip_x = std::max((int)m_rect_waveform.left, std::min(tooltip_x, (int)m_rect_waveform.right - tooltip_w));
+  draw_scrub_preview(g, tooltip_x + tooltip_w / 2, tooltip_y - static_cast<int>(6 * m_dpi_scale),
+                     (int)m_rect_waveform.left, (int)m_rect_waveform.right);
   Gdiplus::Color bgColor = m_dark_mode ? Gdiplus::Color(220, 60, 60, 60) : Gdiplus::Color(220, 40, 40, 40);
   Gdiplus::SolidBrush bgBrush(bgColor);
   int corner = static_cast<int>(4 * m_dpi_scale);
@@ -5832,6 +6012,7 @@ void ControlPanelCore::on_mouse_move(int x, int y) {
     m_prev_hover_region = m_hover_region;
     m_hover_change_time = std::chrono::steady_clock::now();
     m_hover_region = new_region;
+    if (old_region == HitRegion::SeekBar) release_scrub_preview();
     // Skip full repaint when visualization fast path is active —
     // paint_spectrum_only() already redraws buttons with hover states each frame.
     // Exception: ThinProgressBar draws a tooltip and expanded bar that extend
@@ -5922,7 +6103,8 @@ void ControlPanelCore::on_mouse_move(int x, int y) {
     double pos = static_cast<double>(x - m_rect_seekbar.left) / bar_w;
     pos = std::max(0.0, std::min(1.0, pos));
     m_preview_time = pos * m_state.track_length;
-    
+    if (get_nowbar_scrub_preview_enabled() && !m_seeking) request_scrub_preview(m_preview_time);
+
     // Only invalidate if position changed, with frame rate limiting
     if (old_hover_x != m_seekbar_hover_x) {
       auto now = std::chrono::steady_clock::now();
@@ -5931,8 +6113,11 @@ void ControlPanelCore::on_mouse_move(int x, int y) {
         m_last_animation_frame = now;
         // Use partial invalidation - only repaint the tooltip area above the seekbar
         // Tooltip is roughly 60 pixels wide and 25 pixels tall, positioned above seekbar
-        int tooltip_h = static_cast<int>(25 * m_dpi_scale);
+        int tooltip_h = static_cast<int>(25 * m_dpi_scale) + scrub_preview_height();
         int tooltip_w = static_cast<int>(60 * m_dpi_scale);
+        if (scrub_preview_height() > 0) {
+          tooltip_w = std::max(tooltip_w, static_cast<int>(SCRUB_PREVIEW_BINS * 1.5f * m_dpi_scale));
+        }
         int gap = static_cast<int>(6 * m_dpi_scale);
         // Invalidate area covering old and new tooltip positions
         int left_x = std::min(old_hover_x, x) - tooltip_w / 2 - 5;
@@ -6004,6 +6189,7 @@ void ControlPanelCore::on_mouse_move(int x, int y) {
 void ControlPanelCore::on_mouse_leave() {
   m_volume_wheel_active = false;
   m_rating_hover_star = 0;
+  release_scrub_preview();
 
   if (m_hover_region != HitRegion::None) {
     // ThinProgressBar draws a tooltip and expanded bar outside the fast path's
@@ -7166,7 +7352,7 @@ void ControlPanelCore::on_playback_state_changed(const PlaybackState &state) {
 
   // Waveform: start computation on play if mode 2 and not yet computed; clear on stop
   if (vis_mode == 2) {
-    if (is_playing_now && !m_waveform_valid && !m_waveform_computing.load()) {
+    if (is_playing_now && !m_waveform_snapshot.complete() && !m_waveform_computing.load()) {
       start_waveform_computation();
     } else if (is_stopped) {
       // Cancel any in-progress decode but keep the computed waveform visible
@@ -7251,11 +7437,8 @@ void ControlPanelCore::on_track_changed() {
     m_waveform_reveal_pos = 0.0f;
     m_waveform_decode_count.store(0, std::memory_order_relaxed);
     m_waveform_reveal_active = false;
-    {
-      std::lock_guard<std::mutex> lock(m_waveform_mutex);
-      m_waveform_valid = false;
-      m_waveform_peaks.assign(WAVEFORM_SEGMENTS, 0.0f);
-    }
+    m_waveform_snapshot.publish(WaveformPyramid(), false);
+    m_waveform_is_stream = false;  // A new stream starts a fresh history
     start_waveform_computation();
   }
 
@@ -7267,74 +7450,142 @@ void ControlPanelCore::on_track_changed() {
 }
 
 void ControlPanelCore::set_artwork(album_art_data_ptr data) {
-  m_needs_full_repaint = true;
-  m_artwork_is_online = false;  // Local/embedded artwork
   if (!data.is_valid() || data->get_size() == 0) {
     clear_artwork();
     return;
   }
 
-  // Create GDI+ bitmap from data
-  IStream *stream = nullptr;
-  HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, data->get_size());
-  if (hMem) {
-    void *pMem = GlobalLock(hMem);
-    if (pMem) {
-      memcpy(pMem, data->get_ptr(), data->get_size());
-      GlobalUnlock(hMem);
-
-      if (SUCCEEDED(CreateStreamOnHGlobal(hMem, TRUE, &stream))) {
-        m_artwork_bitmap.reset(Gdiplus::Bitmap::FromStream(stream));
-        stream->Release();
-
-        // Create thumbnail first (downscales full-res and releases it),
-        // then extract colors from the smaller thumbnail instead of full-res.
-        create_artwork_thumbnail();
-        extract_artwork_colors();
-
-        // Trigger background transition BEFORE invalidating cache
-        // Only requires m_prev_background to exist (it contains the rendered old state)
-        // m_bg_cache_valid check removed: it just indicates cache freshness, but
-        // m_prev_background already has the old background baked in from prior paints
-        int bg_style = get_nowbar_background_style();
-        if ((bg_style == 1 || bg_style == 2) && get_nowbar_smooth_animations_enabled()) {
-          if (m_prev_background) {
-            m_bg_transition_active = true;
-            m_bg_transition_start_time = std::chrono::steady_clock::now();
-          }
-        }
-        
-        // Invalidate blurred artwork cache so it regenerates with new artwork
-        m_blurred_artwork.reset();
-        m_target_background.reset(); // Invalidate target for new artwork
-        m_blurred_artwork_size = {0, 0};
-        m_bg_cache_valid = false;  // Invalidate cache for new artwork
-      }
-    }
-  }
-
-  invalidate();
+  // Decoded on the worker straight from the data object, which is reference
+  // counted and immutable; oversized JPEGs are reduced by the codec
+  start_artwork_task([data]() { return decode_album_art(data, ARTWORK_THUMBNAIL_DIM); },
+                     [data]() { return artwork_content_key(data->get_ptr(), data->get_size()); }, false);
 }
 
 void ControlPanelCore::set_artwork_from_hbitmap(HBITMAP bitmap) {
-  m_needs_full_repaint = true;
-  m_artwork_is_online = true;  // Online artwork from foo_artwork
   if (!bitmap) {
     clear_artwork();
     return;
   }
 
-  // Create GDI+ bitmap from HBITMAP
-  m_artwork_bitmap.reset(Gdiplus::Bitmap::FromHBITMAP(bitmap, nullptr));
+  // FromHBITMAP copies the pixels, which is cheap next to decoding and lets
+  // the caller free the handle as soon as this returns
+  auto copy = std::make_shared<std::unique_ptr<Gdiplus::Bitmap>>(Gdiplus::Bitmap::FromHBITMAP(bitmap, nullptr));
+  if (!*copy || (*copy)->GetLastStatus() != Gdiplus::Ok) {
+    clear_artwork();
+    return;
+  }
+  start_artwork_task([copy]() { return std::move(*copy); }, nullptr, true);
+}
+
+// Run decode and all per-artwork preprocessing on the artwork worker. A newer
+// request supersedes this one, and one that has not started yet never runs;
+// until its result arrives the current artwork stays on screen.
+void ControlPanelCore::start_artwork_task(std::function<std::unique_ptr<Gdiplus::Bitmap>()> decode,
+                                          std::function<std::string()> content_key, bool online) {
+  HWND hwnd = m_hwnd;
+  const int blur_size = get_nowbar_artwork_blur_size();
+  const int blur_radius = get_nowbar_artwork_blur_radius();
+  // Cached blur made with other settings counts as a miss
+  auto usable = [blur_size, blur_radius](const ArtworkDerivatives& d) {
+    return d.blur_size == static_cast<uint32_t>(blur_size) && d.blur_radius == static_cast<uint32_t>(blur_radius);
+  };
+  auto task = m_artwork_task.start([decode = std::move(decode), content_key = std::move(content_key), online,
+                                    inbox = m_artwork_inbox, hwnd, blur_size, blur_radius,
+                                    usable](const TaskSlot::TaskPtr& task) {
+    auto result = std::make_unique<ArtworkResult>();
+    result->generation = task->generation();
+    result->online = online;
+
+    // The same cover on the previous track (or in another panel) costs a
+    // hash and a thumbnail copy
+    std::string key = content_key ? content_key() : std::string();
+    if (!key.empty()) {
+      std::shared_ptr<const ArtworkDerivatives> cached;
+      if (g_artwork_memory_cache.lookup(key, cached) && cached && usable(*cached)) {
+        result->thumbnail = bitmap_from_derivatives(*cached);
+        if (result->thumbnail) result->derivatives = std::move(cached);
+      }
+    }
+
+    // Covers from earlier sessions come from artcache.db at the cost of
+    // unpacking the stored thumbnail
+    std::shared_ptr<ArtworkCacheFile> disk = key.empty() ? nullptr : get_artcache_file();
+    if (!result->thumbnail && disk) {
+      auto stored = std::make_shared<ArtworkDerivatives>();
+      if (disk->lookup(key, *stored) && usable(*stored)) {
+        result->thumbnail = bitmap_from_derivatives(*stored);
+        if (result->thumbnail) {
+          result->derivatives = stored;
+          g_artwork_memory_cache.set_capacity(artwork_memory_cache_capacity());
+          g_artwork_memory_cache.insert(key, std::move(stored));
+        }
+      }
+      if (task->cancelled()) return;
+    }
+
+    std::shared_ptr<const ArtworkDerivatives> to_store;
+
+    if (!result->thumbnail) {
+      // Superseded while hashing or reading artcache.db: skip the decode
+      if (task->cancelled()) return;
+      std::unique_ptr<Gdiplus::Bitmap> bitmap = decode();
+      if (task->cancelled()) return;
+      // Thumbnail first (downscales full-res and releases it), then colors and
+      // blur from the smaller thumbnail instead of full-res
+      result->thumbnail = make_artwork_thumbnail(std::move(bitmap));
+      if (task->cancelled()) return;
+      if (result->thumbnail) {
+        result->derivatives = make_artwork_derivatives(result->thumbnail.get(), blur_size, blur_radius);
+        if (!key.empty() && result->derivatives && !result->derivatives->pixels.empty()) {
+          g_artwork_memory_cache.set_capacity(artwork_memory_cache_capacity());
+          g_artwork_memory_cache.insert(key, result->derivatives);
+          to_store = result->derivatives;
+        }
+      }
+    }
+
+    bool published = task->publish([&]() {
+      std::lock_guard<std::mutex> lock(inbox->mutex);
+      inbox->result = std::move(result);
+    });
+    if (published && hwnd) ::PostMessage(hwnd, WM_NOWBAR_ARTWORK, 0, 0);
+
+    // Persist after the panel has its result; encoding takes a few ms
+    if (to_store && disk) disk->store(key, *to_store);
+  });
+  m_artwork_generation = task ? task->generation() : 0;
+}
+
+ArtworkMemoryCache::Stats ControlPanelCore::get_artwork_cache_stats() {
+  return g_artwork_memory_cache.get_stats();
+}
+
+void ControlPanelCore::on_artwork_ready() {
+  std::unique_ptr<ArtworkResult> result;
+  {
+    std::lock_guard<std::mutex> lock(m_artwork_inbox->mutex);
+    result = std::move(m_artwork_inbox->result);
+  }
+  // Superseded or cleared while the message was in flight
+  if (!result || result->generation != m_artwork_generation) return;
+  m_artwork_generation = 0;
 
-  if (m_artwork_bitmap && m_artwork_bitmap->GetLastStatus() == Gdiplus::Ok) {
-    // Create thumbnail first (downscales full-res and releases it),
-    // then extract colors from the smaller thumbnail instead of full-res.
-    create_artwork_thumbnail();
-    extract_artwork_colors();
+  m_needs_full_repaint = true;
+  m_artwork_is_online = result->online;
+  m_artwork_thumbnail = std::move(result->thumbnail);
+  m_artwork_derivatives = std::move(result->derivatives);
+  m_artwork_colors_valid = m_artwork_derivatives && m_artwork_derivatives->colors_valid;
+  if (m_artwork_colors_valid) {
+    m_artwork_color_primary = Gdiplus::Color(m_artwork_derivatives->primary);
+    m_artwork_color_secondary = Gdiplus::Color(m_artwork_derivatives->secondary);
+    nowbar_notify_color_changed();
+  }
 
-    // Trigger background transition BEFORE invalidating cache
-    // Only requires m_prev_background to exist (it contains the rendered old state)
+  // Trigger background transition BEFORE invalidating cache
+  // Only requires m_prev_background to exist (it contains the rendered old state)
+  // m_bg_cache_valid check removed: it just indicates cache freshness, but
+  // m_prev_background already has the old background baked in from prior paints
+  if (m_artwork_thumbnail) {
     int bg_style = get_nowbar_background_style();
     if ((bg_style == 1 || bg_style == 2) && get_nowbar_smooth_animations_enabled()) {
       if (m_prev_background) {
@@ -7342,27 +7593,30 @@ void ControlPanelCore::set_artwork_from_hbitmap(HBITMAP bitmap) {
         m_bg_transition_start_time = std::chrono::steady_clock::now();
       }
     }
-
-    // Invalidate blurred artwork cache so it regenerates with new artwork
-    m_blurred_artwork.reset();
-    m_target_background.reset();
-    m_blurred_artwork_size = {0, 0};
-    m_bg_cache_valid = false;
-  } else {
-    m_artwork_bitmap.reset();
-    m_artwork_thumbnail.reset();
   }
 
+  // Invalidate blurred artwork cache so it regenerates with new artwork
+  m_blurred_artwork.reset();
+  m_blurred_artwork_small.reset();
+  m_target_background.reset(); // Invalidate target for new artwork
+  m_blurred_artwork_size = {0, 0};
+  m_bg_cache_valid = false;  // Invalidate cache for new artwork
+
   invalidate();
 }
 
 void ControlPanelCore::clear_artwork() {
+  // Drop any artwork still being prepared
+  m_artwork_task.cancel();
+  m_artwork_generation = 0;
+
   m_needs_full_repaint = true;
   m_artwork_is_online = false;
-  m_artwork_bitmap.reset();
   m_artwork_thumbnail.reset();
+  m_artwork_derivatives.reset();
   m_artwork_colors_valid = false;
   m_blurred_artwork.reset();
+  m_blurred_artwork_small.reset();
   m_target_background.reset();
   m_blurred_artwork_size = {0, 0};
   m_bg_cache_valid = false;  // Invalidate cache when artwork cleared
@@ -8736,40 +8990,103 @@ void ControlPanelCore::draw_radio_icon(Gdiplus::Graphics &g, const RECT &rect,
 }
 
 
+// Location (path + subsong) plus the size/timestamp metadb recorded for the
+// file (0 when unknown, e.g. for tracks not yet in the library).
+static WaveformSourceId make_waveform_source_id(const metadb_handle_ptr& track) {
+  WaveformSourceId id;
+  id.path = track->get_path();
+  id.subsong = track->get_subsong_index();
+  metadb_info_container::ptr info = track->get_info_ref();
+  if (info.is_valid()) {
+    const t_filestats& stats = info->stats();
+    if (stats.m_size != filesize_invalid) id.file_size = stats.m_size;
+    if (stats.m_timestamp != filetimestamp_invalid) id.file_time = stats.m_timestamp;
+  }
+  return id;
+}
+
+// Reads the head and tail of a local file for the content fingerprint.
+// Returns 0 (no fingerprint) for remote or unreadable locations.
+static uint64_t compute_waveform_fingerprint(const char* path, uint32_t subsong, uint64_t file_size, abort_callback& abort) {
+  if (file_size == 0 || filesystem::g_is_remote_or_unrecognized(path)) return 0;
+  try {
+    service_ptr_t<file> f;
+    filesystem::g_open_read(f, path, abort);
+    t_filesize size = f->get_size(abort);
+    if (size == filesize_invalid || size != file_size || !f->can_seek()) return 0;
+
+    size_t span = (size_t)std::min<t_filesize>(size, WAVEFORM_FINGERPRINT_SPAN);
+    std::vector<uint8_t> head(span), tail(span);
+    f->read_object(head.data(), span, abort);
+    f->seek(size - span, abort);
+    f->read_object(tail.data(), span, abort);
+    return waveform_content_fingerprint(size, subsong, head.data(), span, tail.data(), span);
+  } catch (...) {
+    return 0;
+  }
+}
+
 void ControlPanelCore::start_waveform_computation() {
   cancel_waveform_computation();
 
-  // Guard: skip if no current track or stream (track_length <= 0)
+  // Streams (track_length <= 0) get a rolling history built while drawing;
+  // resuming the same stream keeps what was collected
   if (m_state.track_length <= 0 || !m_state.current_track.is_valid()) {
-    std::lock_guard<std::mutex> lock(m_waveform_mutex);
-    m_waveform_is_stream = (m_state.track_length <= 0 && m_state.is_playing);
-    m_waveform_valid = false;
-    m_waveform_peaks.clear();
+    bool is_stream = (m_state.track_length <= 0 && m_state.is_playing);
+    if (is_stream && m_waveform_is_stream) return;
+    m_waveform_is_stream = is_stream;
+    m_waveform_snapshot.clear();
+    m_stream_waveform.reset();
+    m_stream_waveform_published = m_stream_waveform.version();
     return;
   }
 
-  // Get the file path from the current track
-  pfc::string8 path;
+  // Files are decoded instead; in this mode the visualisation stream only
+  // feeds the stream history
+  if (m_vis_stream.is_valid()) release_vis_stream();
+
+  // Identify the track by path plus the file stats metadb knows about, so
+  // an edited file is recomputed instead of showing a stale waveform
+  WaveformSourceId source_id;
   try {
-    path = m_state.current_track->get_path();
+    source_id = make_waveform_source_id(m_state.current_track);
   } catch (...) {
     return;
   }
+  std::string track_key = waveform_memory_key(source_id);
+
+  // ReplayGain is read here, not cached with the waveform, so retagging a
+  // track takes effect on the next play
+  m_waveform_has_replaygain = false;
+  try {
+    replaygain_info rg = m_state.current_track->get_info_ref()->info().get_replaygain();
+    if (rg.is_track_gain_present()) {
+      m_waveform_replaygain_db = rg.m_track_gain;
+      m_waveform_has_replaygain = true;
+    } else if (rg.is_album_gain_present()) {
+      m_waveform_replaygain_db = rg.m_album_gain;
+      m_waveform_has_replaygain = true;
+    }
+  } catch (...) {
+  }
 
-  // Don't recompute if same track is already valid
-  if (m_waveform_valid && m_waveform_track_path == path) return;
+  // Don't recompute if same track is already valid, unless a wider display
+  // needs more detail than it has; the shown waveform stays up meanwhile
+  bool refine = false;
+  if (m_waveform_snapshot.complete() && m_waveform_track_key == track_key) {
+    WaveformSnapshotCell::Reader current(m_waveform_snapshot);
+    if (!current || current->pyramid->finest().size() >= g_waveform_detail.load()) return;
+    refine = true;
+  }
 
-  // Check waveform cache before spawning a decoding thread
+  // Check the memory cache before starting a job. wavecache.db is only
+  // opened and read by the job, never on the UI thread.
   {
-    std::vector<float> cached_peaks;
-    if (lookup_waveform_cache(path.c_str(), cached_peaks)) {
-      {
-        std::lock_guard<std::mutex> lock(m_waveform_mutex);
-        m_waveform_peaks = std::move(cached_peaks);
-        m_waveform_valid = true;
-        m_waveform_is_stream = false;
-        m_waveform_track_path = path.c_str();
-      }
+    WaveformLevel cached_level;
+    if (lookup_waveform_memory(source_id, cached_level)) {
+      m_waveform_snapshot.publish(WaveformPyramid::from_finest(std::move(cached_level)), true);
+      m_waveform_is_stream = false;
+      m_waveform_track_key = track_key;
       // All segments available — reveal animation will sweep across
       m_waveform_decode_count.store(WAVEFORM_SEGMENTS, std::memory_order_relaxed);
       m_waveform_reveal_active = true;
@@ -8779,295 +9096,556 @@ void ControlPanelCore::start_waveform_computation() {
     }
   }
 
-  m_waveform_cancel = false;
   m_waveform_computing = true;
+  m_waveform_refining = refine;
 
-  // Pre-size peaks so the render loop can read partially-filled data
-  {
-    std::lock_guard<std::mutex> lock(m_waveform_mutex);
-    m_waveform_peaks.assign(WAVEFORM_SEGMENTS, 0.0f);
-    m_waveform_is_stream = false;
-    m_waveform_track_path = path.c_str();
-  }
+  // Blank snapshot until the decoder publishes partial data
+  if (!refine) m_waveform_snapshot.publish(WaveformPyramid(), false);
+  m_waveform_is_stream = false;
+  m_waveform_track_key = track_key;
 
+  // One decode per track however many panels show it: the job is shared
+  // through the process-wide pool, keyed like the memory cache. Updates
+  // arrive on a worker thread and are posted to this panel's window.
   HWND hwnd = m_hwnd;
   double track_length = m_state.track_length;
-  metadb_handle_ptr track_handle = m_state.current_track;
-
-  m_waveform_thread = std::thread([this, path, hwnd, track_length, track_handle]() {
-    try {
-      int num_segments = WAVEFORM_SEGMENTS;
-      double segment_duration = track_length / num_segments;
-      std::vector<float> peaks(num_segments, 0.0f);
-      std::vector<double> rms_sums(num_segments, 0.0);
-      std::vector<int> rms_counts(num_segments, 0);
-
-      // Decode audio in a tight scope so the file handle is released
-      // immediately after reading. This prevents blocking tag writers
-      // that need write access to the same file (e.g., CUE sheets
-      // where the underlying full-track file is both played and tagged).
-      {
-        service_ptr_t<input_decoder> decoder;
-        input_entry::g_open_for_decoding(decoder, nullptr, path.c_str(), m_waveform_abort);
-        decoder->initialize(0, input_flag_simpledecode, m_waveform_abort);
-
-        audio_chunk_impl_temporary chunk;
-        int current_segment = 0;
-        double segment_start = 0.0;
-
-        while (current_segment < num_segments) {
-          if (m_waveform_cancel.load()) return;
-
-          bool got_data = false;
-          try {
-            got_data = decoder->run(chunk, m_waveform_abort);
-          } catch (...) {
-            break;
-          }
-
-          if (!got_data) break;
-
-          // Process samples in this chunk
-          const audio_sample* data = chunk.get_data();
-          t_size samples = chunk.get_sample_count();
-          int channels = chunk.get_channel_count();
-          int sample_rate = chunk.get_sample_rate();
+  auto abort = std::make_shared<abort_callback_impl>();
+  m_waveform_subscription = g_waveform_jobs.subscribe(
+      track_key, JobPriority::NowPlaying,
+      [abort, source_id, track_length](WaveformJobPool::Job& job) {
+        run_waveform_job(job, source_id, track_length, *abort);
+      },
+      [this, hwnd](const WaveformUpdate& update) {
+        {
+          std::lock_guard<std::mutex> lock(m_waveform_inbox_mutex);
+          m_waveform_inbox = update;
+        }
+        if (hwnd) ::PostMessage(hwnd, WM_NOWBAR_WAVEFORM, 0, 0);
+      },
+      [abort]() { abort->abort(); });
+  if (!m_waveform_subscription) m_waveform_computing = false;
+}
 
-          if (!data || samples == 0 || channels == 0 || sample_rate == 0) continue;
+// Runs on a pool worker and may be shared by several panels, so it touches
+// no instance state: results only leave through job.notify(). The job may
+// outlive every panel if it is stuck in I/O; it owns its abort callback.
+void ControlPanelCore::run_waveform_job(WaveformJobPool::Job& job, const WaveformSourceId& source_id,
+                                        double track_length, abort_callback& abort) {
+  try {
+    const char* path = source_id.path.c_str();
+
+    // wavecache.db by path and stats; the first lookup opens the file
+    WaveformLevel cached_level;
+    if (lookup_waveform_file(source_id, cached_level)) {
+      job.notify(WaveformUpdate{std::make_shared<const WaveformPyramid>(
+                                    WaveformPyramid::from_finest(std::move(cached_level))),
+                                WAVEFORM_SEGMENTS, true});
+      return;
+    }
+    if (job.cancelled()) return;
 
-          double chunk_duration = (double)samples / sample_rate;
-          double chunk_end_time = segment_start + chunk_duration;
+    // Path and stats missed; a moved or renamed file still matches by content
+    uint64_t fingerprint = compute_waveform_fingerprint(path, source_id.subsong, source_id.file_size, abort);
+    WaveformLevel moved_level;
+    if (lookup_waveform_fingerprint(fingerprint, source_id.file_size, moved_level)) {
+      auto moved = std::make_shared<const WaveformPyramid>(WaveformPyramid::from_finest(std::move(moved_level)));
+      save_waveform_entry(source_id, fingerprint, *moved);
+      job.notify(WaveformUpdate{std::move(moved), WAVEFORM_SEGMENTS, true});
+      return;
+    }
+    if (job.cancelled()) return;
+
+    // Measure the finest pyramid level; coarser levels are derived from it
+    int num_segments = WAVEFORM_PYRAMID_FINE;
+    double segment_duration = track_length / num_segments;
+    std::vector<WaveformSegmentStats> stats(num_segments);
+
+    // Integrated loudness is measured in the same pass so the display can
+    // be scaled by it without decoding again
+    LoudnessMeter meter;
+    uint32_t meter_rate = 0;
+    unsigned meter_channels = 0, meter_config = 0;
+    auto current_loudness = [&meter]() -> float {
+      double lufs;
+      if (!meter.integrated(lufs)) return 0.0f;
+      return (float)std::min(lufs, -0.01);  // 0 is reserved for "not measured"
+    };
 
-          // Accumulate squared sample values for RMS per segment
-          for (t_size s = 0; s < samples; s++) {
-            double sample_time = segment_start + (double)s / sample_rate;
-            int seg = (int)(sample_time / segment_duration);
-            if (seg >= num_segments) seg = num_segments - 1;
-            if (seg < 0) seg = 0;
+    // Decode audio in a tight scope so the file handle is released
+    // immediately after reading. This prevents blocking tag writers
+    // that need write access to the same file (e.g., CUE sheets
+    // where the underlying full-track file is both played and tagged).
+    //
+    // Opening at the track's subsong makes CUE sheets and multi-track
+    // containers decode only that track's range, starting at its offset.
+    {
+      service_ptr_t<input_decoder> decoder;
+      input_entry::g_open_for_decoding(decoder, nullptr, path, abort);
+      decoder->initialize(source_id.subsong, input_flag_simpledecode, abort);
+
+      audio_chunk_impl_temporary chunk;
+      int current_segment = 0;
+      double segment_start = 0.0;
+
+      // Stop at the track's length even if an input keeps producing audio
+      // past the end of the range
+      while (current_segment < num_segments && segment_start < track_length) {
+        if (job.cancelled()) return;
+
+        bool got_data = false;
+        try {
+          got_data = decoder->run(chunk, abort);
+        } catch (...) {
+          break;
+        }
 
-            // Average across channels, then accumulate squared value
-            float sum_ch = 0.0f;
-            for (int ch = 0; ch < channels; ch++) {
-              sum_ch += std::abs(data[s * channels + ch]);
+        if (!got_data) break;
+
+        // Process samples in this chunk
+        const audio_sample* data = chunk.get_data();
+        t_size samples = chunk.get_sample_count();
+        int channels = chunk.get_channel_count();
+        int sample_rate = chunk.get_sample_rate();
+
+        if (!data || samples == 0 || channels == 0 || sample_rate == 0) continue;
+
+        if ((uint32_t)sample_rate != meter_rate || (unsigned)channels != meter_channels ||
+            chunk.get_channel_config() != meter_config) {
+          meter_rate = (uint32_t)sample_rate;
+          meter_channels = (unsigned)channels;
+          meter_config = chunk.get_channel_config();
+          meter.set_format(meter_rate, meter_channels);
+          for (unsigned ch = 0; ch < meter_channels; ch++) {
+            unsigned flag = audio_chunk::g_extract_channel_flag(meter_config, ch);
+            if (flag == audio_chunk::channel_lfe) {
+              meter.set_channel_weight(ch, 0.0);
+            } else if (flag & (audio_chunk::channel_back_left | audio_chunk::channel_back_right |
+                               audio_chunk::channel_side_left | audio_chunk::channel_side_right)) {
+              meter.set_channel_weight(ch, 1.41);
             }
-            float val = sum_ch / channels;
-            rms_sums[seg] += (double)(val * val);
-            rms_counts[seg]++;
-
-            // Track segment progress and report with running normalization
-            if (seg > current_segment) {
-              // Finalize RMS for completed segments
-              for (int k = current_segment; k < seg; k++) {
-                if (rms_counts[k] > 0) {
-                  peaks[k] = std::sqrt((float)(rms_sums[k] / rms_counts[k]));
-                }
-              }
-              current_segment = seg;
-
-              // Publish normalized peaks periodically
-              if ((seg % 20) == 0 && hwnd && ::IsWindow(hwnd)) {
-                // Running max across all decoded segments
-                float running_max = 0.0f;
-                for (int k = 0; k < seg; k++) {
-                  if (peaks[k] > running_max) running_max = peaks[k];
-                }
-                if (running_max > 0.0f) {
-                  std::lock_guard<std::mutex> lock(m_waveform_mutex);
-                  for (int k = 0; k < seg; k++) {
-                    float norm = peaks[k] / running_max;
-                    m_waveform_peaks[k] = std::pow(norm, 0.65f);
-                  }
-                }
-                m_waveform_decode_count.store(seg, std::memory_order_relaxed);
-                ::InvalidateRect(hwnd, nullptr, FALSE);
-              }
+          }
+        }
+        meter.add(data, samples);
+
+        double chunk_duration = (double)samples / sample_rate;
+        double chunk_end_time = segment_start + chunk_duration;
+
+        // Hand each run of frames that falls into one segment to the
+        // shared reduction kernel (RMS plus peak envelope in one pass)
+        t_size s = 0;
+        while (s < samples) {
+          double sample_time = segment_start + (double)s / sample_rate;
+          int seg = (int)(sample_time / segment_duration);
+          if (seg >= num_segments) seg = num_segments - 1;
+          if (seg < 0) seg = 0;
+
+          t_size run = samples - s;
+          if (seg < num_segments - 1) {
+            double boundary = (seg + 1) * segment_duration;
+            double frames_left = std::ceil((boundary - segment_start) * sample_rate) - (double)s;
+            if (frames_left < 1.0) frames_left = 1.0;
+            if (frames_left < (double)run) run = (t_size)frames_left;
+          }
+          waveform_reduce(data + s * channels, run, (unsigned)channels, stats[seg]);
+          s += run;
+
+          // Track segment progress and report with running normalization
+          if (seg > current_segment) {
+            current_segment = seg;
+
+            // Publish normalized peaks periodically (every 20 reveal units)
+            if ((seg % (num_segments / WAVEFORM_SEGMENTS * 20)) == 0) {
+              int reveal_seg = seg * WAVEFORM_SEGMENTS / num_segments;
+              // Undecoded segments are still empty, so this normalizes to the running max.
+              // One immutable pyramid is shared by every subscribed panel.
+              job.notify(WaveformUpdate{std::make_shared<const WaveformPyramid>(WaveformPyramid::from_stats(
+                                            stats.data(), stats.size(), WAVEFORM_ENCODING, current_loudness())),
+                                        reveal_seg, false});
             }
           }
-
-          segment_start = chunk_end_time;
         }
-      }
-      // decoder is now destroyed — file handle released
 
-      // Compute RMS for each segment
-      for (int i = 0; i < num_segments; i++) {
-        if (rms_counts[i] > 0) {
-          peaks[i] = std::sqrt((float)(rms_sums[i] / rms_counts[i]));
-        }
+        segment_start = chunk_end_time;
       }
+    }
+    // decoder is now destroyed — file handle released
 
-      if (m_waveform_cancel.load()) return;
-
-      // Normalize to 0.0-1.0 with gentle perceptual scaling
-      float max_peak = 0.0f;
-      for (float p : peaks) {
-        if (p > max_peak) max_peak = p;
-      }
-      if (max_peak > 0.0f) {
-        for (float& p : peaks) {
-          p /= max_peak;
-          // Gentle power curve to slightly expand quieter segments
-          p = std::pow(p, 0.65f);
-        }
-      }
+    if (job.cancelled()) return;
 
-      // Persist to disk cache (file I/O only, no shared state)
-      save_waveform_entry(path.c_str(), peaks);
+    // Normalize and quantize every level once
+    WaveformPyramid pyramid = WaveformPyramid::from_stats(stats.data(), stats.size(), WAVEFORM_ENCODING,
+                                                          current_loudness());
 
-      // Store final normalized peaks and update in-memory cache
-      {
-        std::lock_guard<std::mutex> lock(m_waveform_mutex);
-        m_waveform_cache[std::string(path.c_str())] = peaks;
-        m_waveform_peaks = std::move(peaks);
-        m_waveform_valid = true;
-      }
-      m_waveform_computing = false;
+    // Persist to disk and the shared memory cache (no per-instance state)
+    save_waveform_entry(source_id, fingerprint, pyramid);
 
-      // All segments decoded — main thread will pick up via decode_count
-      m_waveform_decode_count.store(WAVEFORM_SEGMENTS, std::memory_order_relaxed);
+    // Hand the final peaks to every panel still subscribed
+    job.notify(WaveformUpdate{std::make_shared<const WaveformPyramid>(std::move(pyramid)), WAVEFORM_SEGMENTS, true});
+  } catch (...) {
+    job.notify(WaveformUpdate{nullptr, 0, true});
+  }
+}
 
-      // Trigger repaint on main thread via InvalidateRect (safe cross-thread).
-      if (hwnd && ::IsWindow(hwnd)) {
-        ::InvalidateRect(hwnd, nullptr, FALSE);
-      }
-    } catch (...) {
-      m_waveform_computing = false;
+// Apply the latest update from the waveform job on the UI thread
+// (WM_NOWBAR_WAVEFORM). Intermediate updates may have been coalesced.
+void ControlPanelCore::on_waveform_update() {
+  std::optional<WaveformUpdate> update;
+  {
+    std::lock_guard<std::mutex> lock(m_waveform_inbox_mutex);
+    update.swap(m_waveform_inbox);
+  }
+  if (!update) {
+    // Posted by paint: the shown waveform is coarser than the display
+    if (m_waveform_refine_pending && !m_waveform_computing.load()) {
+      m_waveform_refine_pending = false;
+      start_waveform_computation();
     }
-  });
-}
+    return;
+  }
 
-void ControlPanelCore::cancel_waveform_computation() {
-  m_waveform_cancel = true;
-  m_waveform_abort.abort();
-  if (m_waveform_thread.joinable()) {
-    m_waveform_thread.join();
+  // While refining, the coarser waveform stays up until the decode is done
+  if (m_waveform_refining && !update->complete) return;
+  if (update->pyramid) m_waveform_snapshot.publish(update->pyramid, update->complete);
+  if (update->pyramid || !m_waveform_refining) {
+    m_waveform_decode_count.store(update->decode_count, std::memory_order_relaxed);
   }
-  m_waveform_computing = false;
-  m_waveform_cancel = false;
-  m_waveform_abort.reset();
+  if (update->complete) {
+    m_waveform_computing = false;
+    m_waveform_refining = false;
+    m_waveform_subscription.reset();
+  }
+  if (m_hwnd) ::InvalidateRect(m_hwnd, nullptr, FALSE);
 }
 
-// Waveform cache magic and version
-static constexpr char WAVECACHE_MAGIC[4] = {'N', 'W', 'W', 'C'};
-static constexpr uint32_t WAVECACHE_VERSION = 1;
+// Feed the stream history with the audio played since the last call. At most
+// STREAM_WAVEFORM_MAX_CATCHUP seconds are read, so a frame after a stall costs
+// no more than a normal one; anything older is left as a gap.
+void ControlPanelCore::update_stream_waveform() {
+  if (!m_vis_stream.is_valid()) create_vis_stream();
+  if (!m_vis_stream.is_valid()) return;
 
-static pfc::string8 get_wavecache_path() {
-  pfc::string8 dir = get_config_dir_path();
-  dir << "\\wavecache.db";
-  return dir;
-}
+  double now;
+  if (!m_vis_stream->get_absolute_time(now)) return;
+  double from = m_stream_waveform.fed_until();
+  if (from < 0.0 || from > now || now - from > STREAM_WAVEFORM_MAX_CATCHUP) {
+    from = std::max(0.0, now - STREAM_WAVEFORM_MAX_CATCHUP);
+  }
+  if (now - from < 0.001) return;
 
-void ControlPanelCore::load_waveform_cache() {
-  if (m_waveform_cache_loaded) return;
-  m_waveform_cache_loaded = true;
+  audio_chunk_impl chunk;
+  if (m_vis_stream->get_chunk_absolute(chunk, from, now - from)) {
+    m_stream_waveform.add(chunk.get_data(), chunk.get_sample_count(), chunk.get_channel_count(),
+                          chunk.get_sample_rate(), from);
+  }
 
-  pfc::string8 cache_path = get_wavecache_path();
-  pfc::stringcvt::string_wide_from_utf8 wide_path(cache_path);
-  std::ifstream file(wide_path.get_ptr(), std::ios::binary);
-  if (!file.is_open()) return;
+  // Renormalize and publish only when a slot completed (10 times a second)
+  if (m_stream_waveform.version() != m_stream_waveform_published) {
+    m_stream_waveform_published = m_stream_waveform.version();
+    m_stream_waveform.history(m_stream_history);
+    m_waveform_snapshot.publish(
+        WaveformPyramid::from_stats(m_stream_history.data(), m_stream_history.size(), WAVEFORM_ENCODING), false);
+  }
+}
 
-  // Read and validate header
-  char magic[4];
-  uint32_t version = 0;
-  uint32_t entry_count = 0;
+// Keeps one decoder open across hovers and seeks it, instead of reopening
+// the file for every preview. Only used from the scrub worker thread.
+class ControlPanelCore::ScrubPreviewDecoder {
+public:
+  bool decode(const std::string& path, uint32_t subsong, double center, double track_length,
+              const std::atomic<bool>& cancelled, ScrubPreview& out);
+  void close() {
+    m_decoder.release();
+    m_path.clear();
+  }
+  // Any thread. Permanent: later decodes fail at once.
+  void abort() { m_abort.abort(); }
 
-  file.read(magic, 4);
-  if (!file || memcmp(magic, WAVECACHE_MAGIC, 4) != 0) return;
+private:
+  abort_callback_impl m_abort;
+  service_ptr_t<input_decoder> m_decoder;
+  std::string m_path;
+  uint32_t m_subsong = 0;
+};
 
-  file.read(reinterpret_cast<char*>(&version), 4);
-  if (!file || version != WAVECACHE_VERSION) return;
+// Decode SCRUB_PREVIEW_SECONDS around center into SCRUB_PREVIEW_BINS
+// segments. Cancellation is checked per chunk rather than through the abort
+// callback, so a superseded preview leaves the decoder usable; the abort
+// callback is only fired when the panel or the component goes away.
+bool ControlPanelCore::ScrubPreviewDecoder::decode(const std::string& path, uint32_t subsong, double center,
+                                                   double track_length, const std::atomic<bool>& cancelled,
+                                                   ScrubPreview& out) {
+  double window = std::min(SCRUB_PREVIEW_SECONDS, track_length);
+  if (window <= 0.0) return false;
+  double start = std::max(0.0, std::min(center - window / 2, track_length - window));
+  double bin_duration = window / SCRUB_PREVIEW_BINS;
+  std::vector<WaveformSegmentStats> bins(SCRUB_PREVIEW_BINS);
 
-  file.read(reinterpret_cast<char*>(&entry_count), 4);
-  if (!file) return;
+  try {
+    abort_callback& abort = m_abort;
+    abort.check();
+    if (m_decoder.is_empty() || m_path != path || m_subsong != subsong) {
+      close();
+      input_entry::g_open_for_decoding(m_decoder, nullptr, path.c_str(), abort);
+      m_decoder->initialize(subsong, input_flag_simpledecode, abort);
+      m_path = path;
+      m_subsong = subsong;
+    }
+    if (!m_decoder->can_seek()) {
+      close();
+      return false;
+    }
+    m_decoder->seek(start, abort);
+
+    audio_chunk_impl_temporary chunk;
+    double chunk_start = 0.0;  // Relative to start
+    while (chunk_start < window) {
+      if (cancelled.load(std::memory_order_relaxed)) return false;
+      if (!m_decoder->run(chunk, abort)) break;
+
+      const audio_sample* data = chunk.get_data();
+      t_size samples = chunk.get_sample_count();
+      unsigned channels = chunk.get_channel_count();
+      unsigned sample_rate = chunk.get_sample_rate();
+      if (!data || samples == 0 || channels == 0 || sample_rate == 0) continue;
+
+      // Same segment walk as the full decode
+      t_size s = 0;
+      while (s < samples) {
+        double t = chunk_start + (double)s / sample_rate;
+        if (t >= window) break;
+        int bin = std::min(SCRUB_PREVIEW_BINS - 1, (int)(t / bin_duration));
+        t_size run = samples - s;
+        double frames_left = std::ceil(((bin + 1) * bin_duration - chunk_start) * sample_rate) - (double)s;
+        if (frames_left < 1.0) frames_left = 1.0;
+        if (frames_left < (double)run) run = (t_size)frames_left;
+        waveform_reduce(data + s * channels, run, channels, bins[bin]);
+        s += run;
+      }
+      chunk_start += (double)samples / sample_rate;
+    }
+  } catch (...) {
+    // State is unknown after an error; reopen on the next request
+    close();
+    return false;
+  }
 
-  // Read entries
-  for (uint32_t i = 0; i < entry_count; i++) {
-    uint32_t path_len = 0;
-    file.read(reinterpret_cast<char*>(&path_len), 4);
-    if (!file || path_len > 4096) return;  // Sanity limit
+  out.path = path;
+  out.subsong = subsong;
+  out.start = start;
+  out.end = start + window;
+  out.level = WaveformPyramid::from_stats(bins.data(), bins.size(), PeakEncoding::U8).finest();
+  return true;
+}
 
-    std::string path(path_len, '\0');
-    file.read(&path[0], path_len);
-    if (!file) return;
+// Ask for a preview around `time`. Requests are debounced, so this is cheap
+// to call on every mouse move; hovering within the current bin is ignored.
+void ControlPanelCore::request_scrub_preview(double time) {
+  if (g_shutdown || !m_state.current_track.is_valid() || m_state.track_length <= 0) return;
+  double bin_duration = SCRUB_PREVIEW_SECONDS / SCRUB_PREVIEW_BINS;
+  if (m_scrub_requested_time >= 0.0 && std::fabs(time - m_scrub_requested_time) < bin_duration) return;
+  m_scrub_requested_time = time;
 
-    uint32_t peak_count = 0;
-    file.read(reinterpret_cast<char*>(&peak_count), 4);
-    if (!file || peak_count > 10000) return;  // Sanity limit
+  if (!m_scrub_decoder) m_scrub_decoder = std::make_shared<ScrubPreviewDecoder>();
+  if (!m_scrub_inbox) m_scrub_inbox = std::make_shared<ScrubPreviewInbox>();
 
-    std::vector<float> peaks(peak_count);
-    file.read(reinterpret_cast<char*>(peaks.data()), peak_count * sizeof(float));
-    if (!file) return;
+  std::string path = m_state.current_track->get_path();
+  uint32_t subsong = m_state.current_track->get_subsong_index();
+  double track_length = m_state.track_length;
+  HWND hwnd = m_hwnd;
+  m_scrub_worker.post([decoder = m_scrub_decoder, inbox = m_scrub_inbox, path, subsong, time, track_length,
+                       hwnd](const std::atomic<bool>& cancelled) {
+    ScrubPreview preview;
+    if (!decoder->decode(path, subsong, time, track_length, cancelled, preview)) return;
+    if (cancelled.load(std::memory_order_relaxed)) return;
+    {
+      std::lock_guard<std::mutex> lock(inbox->mutex);
+      inbox->result = std::move(preview);
+    }
+    if (hwnd) ::PostMessage(hwnd, WM_NOWBAR_SCRUB, 0, 0);
+  });
+}
 
-    m_waveform_cache[path] = std::move(peaks);
+// Hover ended: drop the preview and close the decoder so the file is not
+// held open (tag writers need it).
+void ControlPanelCore::release_scrub_preview() {
+  if (m_scrub_requested_time < 0.0 && !m_scrub_preview) return;
+  m_scrub_requested_time = -1.0;
+  m_scrub_preview.reset();
+  if (m_scrub_decoder) {
+    m_scrub_worker.post([decoder = m_scrub_decoder](const std::atomic<bool>&) { decoder->close(); });
   }
 }
 
-void ControlPanelCore::save_waveform_entry(const char* path, const std::vector<float>& peaks) {
-  ensure_config_dir_exists();
-
-  pfc::string8 cache_path = get_wavecache_path();
-  pfc::stringcvt::string_wide_from_utf8 wide_path(cache_path);
+// Drop pending previews and abort the decoder, unblocking a read in
+// progress. The decoder cannot be used afterwards.
+void ControlPanelCore::abort_scrub_preview() {
+  m_scrub_worker.cancel();
+  if (m_scrub_decoder) m_scrub_decoder->abort();
+}
 
-  // Check if file exists
-  bool file_exists = false;
+void ControlPanelCore::on_scrub_preview_ready() {
+  if (!m_scrub_inbox) return;
   {
-    std::ifstream test(wide_path.get_ptr(), std::ios::binary);
-    file_exists = test.is_open();
+    std::lock_guard<std::mutex> lock(m_scrub_inbox->mutex);
+    if (!m_scrub_inbox->result) return;
+    m_scrub_preview = std::move(m_scrub_inbox->result);
+    m_scrub_inbox->result.reset();
   }
+  // Dropped if the hover ended while it was decoding
+  if (m_scrub_requested_time < 0.0) m_scrub_preview.reset();
+  invalidate();
+}
 
-  std::fstream file(wide_path.get_ptr(),
-                    std::ios::binary | std::ios::in | std::ios::out |
-                    (file_exists ? std::ios::openmode(0) : std::ios::trunc));
+int ControlPanelCore::scrub_preview_height() const {
+  if (!get_nowbar_scrub_preview_enabled()) return 0;
+  return static_cast<int>(38 * m_dpi_scale);  // Box plus gap to the time tooltip
+}
 
-  if (!file.is_open()) {
-    // File doesn't exist yet or can't open with in|out — create fresh
-    file.open(wide_path.get_ptr(), std::ios::binary | std::ios::out | std::ios::trunc);
-    if (!file.is_open()) return;
-    file_exists = false;
+// Local waveform above the time tooltip: the peak envelope with the RMS body
+// inside, and a marker at the hovered position. Shown only while the hovered
+// time lies inside the decoded window of the current track.
+void ControlPanelCore::draw_scrub_preview(Gdiplus::Graphics& g, int center_x, int bottom_y, int min_x, int max_x) {
+  if (!m_scrub_preview || m_seeking || !get_nowbar_scrub_preview_enabled()) return;
+  const ScrubPreview& preview = *m_scrub_preview;
+  if (preview.level.empty() || preview.end <= preview.start) return;
+  if (m_preview_time < preview.start || m_preview_time > preview.end) return;
+  if (!m_state.current_track.is_valid() || preview.subsong != m_state.current_track->get_subsong_index() ||
+      preview.path != m_state.current_track->get_path()) {
+    return;
   }
 
-  uint32_t new_count = 1;
-
-  if (!file_exists) {
-    // Write header
-    file.write(WAVECACHE_MAGIC, 4);
-    file.write(reinterpret_cast<const char*>(&WAVECACHE_VERSION), 4);
-    file.write(reinterpret_cast<const char*>(&new_count), 4);
-  } else {
-    // Read current entry count
-    uint32_t current_count = 0;
-    file.seekg(8, std::ios::beg);
-    file.read(reinterpret_cast<char*>(&current_count), 4);
-    new_count = current_count + 1;
+  int box_w = static_cast<int>(SCRUB_PREVIEW_BINS * 1.5f * m_dpi_scale);
+  int box_h = static_cast<int>(32 * m_dpi_scale);
+  int box_x = std::max(min_x, std::min(center_x - box_w / 2, max_x - box_w));
+  int box_y = std::max(0, bottom_y - box_h);
 
-    // Update entry count in header
-    file.seekp(8, std::ios::beg);
-    file.write(reinterpret_cast<const char*>(&new_count), 4);
+  Gdiplus::Color bgColor = m_dark_mode ? Gdiplus::Color(220, 60, 60, 60) : Gdiplus::Color(220, 40, 40, 40);
+  Gdiplus::SolidBrush bgBrush(bgColor);
+  int corner = static_cast<int>(4 * m_dpi_scale);
+  Gdiplus::GraphicsPath path;
+  path.AddArc(box_x, box_y, corner * 2, corner * 2, 180, 90);
+  path.AddArc(box_x + box_w - corner * 2, box_y, corner * 2, corner * 2, 270, 90);
+  path.AddArc(box_x + box_w - corner * 2, box_y + box_h - corner * 2, corner * 2, corner * 2, 0, 90);
+  path.AddArc(box_x, box_y + box_h - corner * 2, corner * 2, corner * 2, 90, 90);
+  path.CloseFigure();
+  g.FillPath(&bgBrush, &path);
+
+  const WaveformLevel& level = preview.level;
+  float pad = 4.0f * m_dpi_scale;
+  float inner_w = box_w - pad * 2;
+  float half = (box_h - pad * 2) * 0.5f;
+  float mid_y = box_y + box_h * 0.5f;
+  float bin_w = inner_w / level.size();
+  float rms_in_envelope = std::pow(level.rms_scale, WAVEFORM_PEAK_CURVE);
+  float min_half_h = 0.5f * m_dpi_scale;
+
+  std::vector<Gdiplus::RectF> envelope, body;
+  envelope.reserve(level.size());
+  body.reserve(level.size());
+  for (size_t i = 0; i < level.size(); i++) {
+    float x = box_x + pad + i * bin_w;
+    float up = std::max(level.peak_max[i] * half, min_half_h);
+    float down = std::max(level.peak_min[i] * half, min_half_h);
+    envelope.emplace_back(x, mid_y - up, bin_w, up + down);
+    float b = std::max(level.rms[i] * rms_in_envelope * half, min_half_h);
+    body.emplace_back(x, mid_y - b, bin_w, b * 2.0f);
+  }
+  Gdiplus::SolidBrush envelopeBrush(Gdiplus::Color(96, 255, 255, 255));
+  Gdiplus::SolidBrush bodyBrush(Gdiplus::Color(230, 255, 255, 255));
+  g.FillRectangles(&envelopeBrush, envelope.data(), (INT)envelope.size());
+  g.FillRectangles(&bodyBrush, body.data(), (INT)body.size());
+
+  float marker_x = box_x + pad + (float)((m_preview_time - preview.start) / (preview.end - preview.start)) * inner_w;
+  Gdiplus::Pen markerPen(Gdiplus::Color(255, GetRValue(m_theme_highlight), GetGValue(m_theme_highlight),
+                                        GetBValue(m_theme_highlight)),
+                         std::max(1.0f, m_dpi_scale));
+  g.DrawLine(&markerPen, marker_x, (float)box_y + pad * 0.5f, marker_x, (float)(box_y + box_h) - pad * 0.5f);
+}
 
-    // Seek to end for appending
-    file.seekp(0, std::ios::end);
+void ControlPanelCore::cancel_waveform_computation() {
+  // Never joins: leaving the job cancels it only if no other panel is
+  // subscribed; an aborted decode finishes detached. No update arrives
+  // after unsubscribe(), so clearing the inbox afterwards drops the last one.
+  m_waveform_subscription.reset();
+  {
+    std::lock_guard<std::mutex> lock(m_waveform_inbox_mutex);
+    m_waveform_inbox.reset();
   }
+  m_waveform_computing = false;
+  m_waveform_refining = false;
+}
+
+static pfc::string8 get_wavecache_path() {
+  pfc::string8 dir = get_config_dir_path();
+  dir << "\\wavecache.db";
+  return dir;
+}
 
-  // Write entry
-  uint32_t path_len = static_cast<uint32_t>(strlen(path));
-  file.write(reinterpret_cast<const char*>(&path_len), 4);
-  file.write(path, path_len);
+// Returns a reference-counted handle so a decoder thread that is still
+// storing an entry keeps the mapping alive across shutdown(). Only called
+// from waveform jobs: the first call maps the file and, after a crash,
+// verifies or salvages it, which must not stall the UI thread.
+static std::shared_ptr<WaveformCacheFile> get_wavecache_file(uint32_t segment_count, PeakEncoding encoding) {
+  std::lock_guard<std::mutex> lock(g_wavecache_mutex);
+  if (g_shutdown) return nullptr;
+  if (!g_wavecache_open_attempted) {
+    g_wavecache_open_attempted = true;
+    ensure_config_dir_exists();
+    auto file = std::make_shared<WaveformCacheFile>(segment_count, encoding, WAVECACHE_MAX_BYTES);
+    if (file->open(get_wavecache_path().c_str())) {
+      g_wavecache_file = std::move(file);
+      // Drop torn and long-unused records off the UI thread
+      if (g_wavecache_file->needs_compaction()) {
+        g_wavecache_compact_thread = std::thread([file = g_wavecache_file]() {
+          file->compact();
+        });
+      }
+    }
+  }
+  return g_wavecache_file;
+}
 
-  uint32_t peak_count = static_cast<uint32_t>(peaks.size());
-  file.write(reinterpret_cast<const char*>(&peak_count), 4);
-  file.write(reinterpret_cast<const char*>(peaks.data()), peak_count * sizeof(float));
+static size_t waveform_memory_cache_capacity() {
+  return static_cast<size_t>(get_nowbar_waveform_memory_cache_mb()) << 20;
 }
 
-bool ControlPanelCore::lookup_waveform_cache(const char* path, std::vector<float>& out_peaks) {
-  load_waveform_cache();
+WaveformMemoryCache::Stats ControlPanelCore::get_waveform_cache_stats() {
+  return g_waveform_memory_cache.get_stats();
+}
 
-  std::lock_guard<std::mutex> lock(m_waveform_mutex);
-  auto it = m_waveform_cache.find(std::string(path));
-  if (it != m_waveform_cache.end()) {
-    out_peaks = it->second;
-    return true;
+// Memory keeps the finest level; disk keeps the coarsest one the widest
+// display needs, the rest of the pyramid being rebuilt from it on load.
+void ControlPanelCore::save_waveform_entry(const WaveformSourceId& id, uint64_t fingerprint,
+                                           const WaveformPyramid& pyramid) {
+  if (pyramid.empty()) return;
+  g_waveform_memory_cache.set_capacity(waveform_memory_cache_capacity());
+  g_waveform_memory_cache.insert(waveform_memory_key(id), pyramid.finest());
+  if (auto file = get_wavecache_file(WAVEFORM_PYRAMID_FINE, WAVEFORM_ENCODING)) {
+    file->store(id, fingerprint, pyramid.level_for(g_waveform_detail.load()));
   }
-  return false;
+}
+
+// Entries coarser than the widest display needs count as misses, so the
+// track is decoded again at full detail.
+bool ControlPanelCore::lookup_waveform_memory(const WaveformSourceId& id, WaveformLevel& out_level) {
+  return g_waveform_memory_cache.lookup(waveform_memory_key(id), out_level) &&
+         out_level.size() >= g_waveform_detail.load();
+}
+
+bool ControlPanelCore::lookup_waveform_file(const WaveformSourceId& id, WaveformLevel& out_level) {
+  // Query the mapped file in place; only the hit record is read.
+  auto file = get_wavecache_file(WAVEFORM_PYRAMID_FINE, WAVEFORM_ENCODING);
+  if (!file || !file->lookup(id, out_level) || out_level.size() < g_waveform_detail.load()) return false;
+
+  g_waveform_memory_cache.set_capacity(waveform_memory_cache_capacity());
+  g_waveform_memory_cache.insert(waveform_memory_key(id), out_level);
+  return true;
+}
+
+bool ControlPanelCore::lookup_waveform_fingerprint(uint64_t fingerprint, uint64_t file_size, WaveformLevel& out_level) {
+  auto file = get_wavecache_file(WAVEFORM_PYRAMID_FINE, WAVEFORM_ENCODING);
+  return file && file->lookup_fingerprint(fingerprint, file_size, out_level) &&
+         out_level.size() >= g_waveform_detail.load();
 }
 
 // Command state polling for custom buttons with fb2k actions
@@ -1,6 +1,13 @@
 #pragma once
 #include "pch.h"
+#include "artwork_cache.h"
+#include "debounced_worker.h"
+#include "job_pool.h"
 #include "playback_state.h"
+#include "stream_waveform.h"
+#include "task_slot.h"
+#include "waveform_cache.h"
+#include "waveform_snapshot.h"
 #include "../preferences.h"
 #include <unordered_map>
 
@@ -65,6 +72,7 @@ enum class HitRegion {
 
 // Callback for requesting artwork update from UI wrapper
 using ArtworkRequestCallback = std::function<void()>;
+using WaveformJobPool = KeyedJobPool<WaveformUpdate>;
 using SettingsChangedCallback = std::function<void()>;
 
 // The core control panel implementation (shared between DUI and CUI)
@@ -88,6 +96,12 @@ public:
 
     // Shutdown cleanup - must be called during on_quit() before services are gone
     static void shutdown();
+
+    // Process-wide waveform memory cache counters (diagnostics)
+    static WaveformMemoryCache::Stats get_waveform_cache_stats();
+
+    // Process-wide artwork memory cache counters (diagnostics)
+    static ArtworkMemoryCache::Stats get_artwork_cache_stats();
     
     // Painting
     void paint(HDC hdc, const RECT& rect);
@@ -127,6 +141,10 @@ public:
     }
     Gdiplus::Color get_artwork_primary() const { return m_artwork_color_primary; }
     bool artwork_colors_valid() const { return m_artwork_colors_valid; }
+    // Null when no artwork is shown or it has no usable colors
+    const ArtworkPalette* get_artwork_palette() const {
+        return m_artwork_colors_valid && m_artwork_derivatives ? &m_artwork_derivatives->palette : nullptr;
+    }
     bool get_dark_mode() const { return m_dark_mode; }
 
     // Spectrum-only repaint: redraws spectrum, thin progress bar, time display, and buttons
@@ -199,6 +217,11 @@ public:
     static constexpr UINT_PTR SHOW_PREFS_TIMER_ID = 1003;
     void do_show_preferences();
 
+    // Exact-size blurred background rebuild, armed while the panel is being
+    // resized (public for UI wrapper timer handling)
+    static constexpr UINT_PTR BLUR_SETTLE_TIMER_ID = 1004;
+    void on_blur_settle_timer();
+
     // Animation frame message — posted by thread-pool timer at normal priority
     // so it isn't starved by WM_MOUSEMOVE input from other panels.
     static constexpr UINT WM_NOWBAR_ANIMATE = WM_APP + 1;
@@ -206,6 +229,21 @@ public:
     // Releases the one-shot timer handle and resets the active flag.
     void on_animation_timer_fired();
 
+    // Waveform job update — posted by a pool worker; UI wrappers call
+    // on_waveform_update() when it arrives.
+    static constexpr UINT WM_NOWBAR_WAVEFORM = WM_APP + 2;
+    void on_waveform_update();
+
+    // Scrub preview result — posted by the preview worker; UI wrappers call
+    // on_scrub_preview_ready() when it arrives.
+    static constexpr UINT WM_NOWBAR_SCRUB = WM_APP + 3;
+    void on_scrub_preview_ready();
+
+    // Artwork decoded and preprocessed by the artwork worker; UI wrappers
+    // call on_artwork_ready() when it arrives.
+    static constexpr UINT WM_NOWBAR_ARTWORK = WM_APP + 4;
+    void on_artwork_ready();
+
 private:
     void update_layout(const RECT& rect);
     void invalidate();
@@ -213,9 +251,8 @@ private:
     void invalidate_rect(const RECT& rect);  // Partial invalidation for specific regions
     void invalidate_progress();  // Partial invalidation for progress-only updates (no full repaint)
     void update_fonts();
-    void extract_artwork_colors();  // Extract dominant colors from artwork for dynamic background
-    void create_artwork_thumbnail();
-    void create_blurred_artwork(int target_width, int target_height);  // Create blurred version at exact size
+    void create_blurred_artwork(int target_width, int target_height);  // Stretch the cached blur to exact size
+    void draw_blurred_artwork(Gdiplus::Graphics& g, int x, int y, int width, int height);  // Exact, or stretched while resizing
     
     // Drawing helpers
     void draw_background(Gdiplus::Graphics& g, const RECT& rect);
@@ -452,16 +489,62 @@ private:
     void draw_time_display_top_right(Gdiplus::Graphics& g);
 
     // Mode 2: Waveform pre-computation
-    static constexpr int WAVEFORM_SEGMENTS = 400;
-    std::vector<float> m_waveform_peaks;
-    std::mutex m_waveform_mutex;
+    static constexpr int WAVEFORM_SEGMENTS = 400;  // Reveal/progress units; detail comes from the pyramid
+    static constexpr PeakEncoding WAVEFORM_ENCODING = PeakEncoding::U8;  // Memory and wavecache.db
+    WaveformSnapshotCell m_waveform_snapshot;  // Published by the decoder, read by paint
     std::atomic<bool> m_waveform_computing{false};
-    std::atomic<bool> m_waveform_cancel{false};
-    abort_callback_impl m_waveform_abort;
-    std::thread m_waveform_thread;
-    pfc::string8 m_waveform_track_path;
-    bool m_waveform_valid = false;
+    WaveformJobPool::SubscriptionPtr m_waveform_subscription;  // Current decode, possibly shared
+    std::mutex m_waveform_inbox_mutex;
+    std::optional<WaveformUpdate> m_waveform_inbox;  // Latest update, applied on the UI thread
+    std::string m_waveform_track_key;  // waveform_memory_key() of the shown waveform
     bool m_waveform_is_stream = false;
+    bool m_waveform_refining = false;  // Decoding again for more detail; the shown waveform stays up
+    bool m_waveform_refine_pending = false;  // Paint asked for a finer waveform
+    std::string m_waveform_detail_key;  // Track a finer waveform was last asked for (once per track)
+
+    // Loudness scaling (advanced preferences): heights are scaled so a track
+    // at WAVEFORM_FULL_SCALE_LUFS fills the bar and quieter tracks look quieter
+    static constexpr float WAVEFORM_FULL_SCALE_LUFS = -10.0f;
+    float m_waveform_replaygain_db = 0.0f;  // Track gain (album gain if no track gain)
+    bool m_waveform_has_replaygain = false;
+    float waveform_display_gain(float loudness) const;
+
+    // Streams (no known length): a rolling history of the last minute fed
+    // from the visualisation stream while playing
+    static constexpr double STREAM_WAVEFORM_MAX_CATCHUP = 0.5;  // Seconds of audio read per frame at most
+    StreamWaveform m_stream_waveform;
+    uint64_t m_stream_waveform_published = 0;  // StreamWaveform::version() of the snapshot
+    std::vector<WaveformSegmentStats> m_stream_history;  // Scratch for history()
+    void update_stream_waveform();
+
+    // Scrub preview (advanced preferences): a local waveform of the few
+    // seconds around the hovered position, shown above the seek tooltip.
+    // One decoder stays open on a debounced worker and is seeked per hover.
+    struct ScrubPreview {
+        std::string path;
+        uint32_t subsong = 0;
+        double start = 0.0;  // Track time covered by level
+        double end = 0.0;
+        WaveformLevel level;
+    };
+    struct ScrubPreviewInbox {
+        std::mutex mutex;
+        std::optional<ScrubPreview> result;
+    };
+    class ScrubPreviewDecoder;
+    static constexpr double SCRUB_PREVIEW_SECONDS = 4.0;
+    static constexpr int SCRUB_PREVIEW_BINS = 96;
+    static constexpr int SCRUB_PREVIEW_DEBOUNCE_MS = 60;
+    DebouncedWorker m_scrub_worker{std::chrono::milliseconds(SCRUB_PREVIEW_DEBOUNCE_MS)};
+    std::shared_ptr<ScrubPreviewDecoder> m_scrub_decoder;  // Used only on the worker
+    std::shared_ptr<ScrubPreviewInbox> m_scrub_inbox;
+    std::optional<ScrubPreview> m_scrub_preview;  // Latest result (UI thread)
+    double m_scrub_requested_time = -1.0;
+    void request_scrub_preview(double time);
+    void release_scrub_preview();
+    void abort_scrub_preview();  // Panel destroy and component shutdown
+    int scrub_preview_height() const;  // Extra tooltip height when the preview is on
+    void draw_scrub_preview(Gdiplus::Graphics& g, int center_x, int bottom_y, int min_x, int max_x);
 
     // Waveform reveal animation
     std::atomic<int> m_waveform_decode_count{0};   // Segments decoded so far (0-WAVEFORM_SEGMENTS)
@@ -472,21 +555,44 @@ private:
     void draw_waveform_tooltip(Gdiplus::Graphics& g);
     void start_waveform_computation();
     void cancel_waveform_computation();
+    static void run_waveform_job(WaveformJobPool::Job& job, const WaveformSourceId& source_id,
+                                 double track_length, abort_callback& abort);
     void update_waveform_brushes();
 
-    // Waveform cache
-    std::unordered_map<std::string, std::vector<float>> m_waveform_cache;
-    bool m_waveform_cache_loaded = false;
-
-    void load_waveform_cache();
-    void save_waveform_entry(const char* path, const std::vector<float>& peaks);
-    bool lookup_waveform_cache(const char* path, std::vector<float>& out_peaks);
+    // Waveform cache: a process-wide LRU in memory in front of wavecache.db
+    // Static: detached decode jobs call these after their panel may be gone
+    static void save_waveform_entry(const WaveformSourceId& id, uint64_t fingerprint, const WaveformPyramid& pyramid);
+    static bool lookup_waveform_memory(const WaveformSourceId& id, WaveformLevel& out_level);
+    // wavecache.db: job threads only, as the first call opens and may salvage the file
+    static bool lookup_waveform_file(const WaveformSourceId& id, WaveformLevel& out_level);
+    static bool lookup_waveform_fingerprint(uint64_t fingerprint, uint64_t file_size, WaveformLevel& out_level);
 
     // Cached waveform brushes (avoid ~400 allocations per frame)
     std::unique_ptr<Gdiplus::SolidBrush> m_waveform_brush_accent;
     std::unique_ptr<Gdiplus::SolidBrush> m_waveform_brush_dim;
     bool m_waveform_brushes_dirty = true;
 
+    // Pre-rasterized waveform: every bar drawn once in the played and once in
+    // the unplayed color; a frame is two clipped blits split at the progress
+    struct WaveformRasterKey {
+        uint64_t version = 0;  // WaveformSnapshot::version
+        int width = 0;
+        int height = 0;
+        int style = -1;
+        int bar_width = -1;
+        float dpi_scale = 0.0f;
+        COLORREF played_color = 0;
+        COLORREF unplayed_color = 0;
+        int smoothing = 0;
+        float gain = 1.0f;  // waveform_display_gain()
+        bool operator==(const WaveformRasterKey&) const = default;
+    };
+    WaveformRasterKey m_waveform_raster_key;
+    std::unique_ptr<Gdiplus::Bitmap> m_waveform_played_bmp;
+    std::unique_ptr<Gdiplus::Bitmap> m_waveform_unplayed_bmp;
+    void rasterize_waveform(const WaveformLevel& level, const WaveformRasterKey& key,
+                            float bar_w_f, float gap, int display_count);
+
     // Smooth progress bar animation
     double m_animated_progress = 0.0;      // Current animated progress (0.0 - 1.0)
     double m_target_progress = 0.0;        // Target progress position
@@ -538,11 +644,32 @@ private:
     bool m_animation_dirty_partial = false;  // true = use m_animation_dirty_rect, false = full repaint
     
     // Artwork
-    std::unique_ptr<Gdiplus::Bitmap> m_artwork_bitmap;
     std::unique_ptr<Gdiplus::Bitmap> m_artwork_thumbnail;  // Pre-scaled artwork (max 512x512) for rendering
     std::unique_ptr<Gdiplus::Bitmap> m_default_artwork;
     bool m_artwork_is_online = false;  // True if current artwork is from foo_artwork (online)
 
+    // Artwork pipeline: decode, thumbnail, colors and blur run on a worker.
+    // The current artwork stays up until the new result arrives; results of
+    // a superseded request are dropped by generation.
+    struct ArtworkResult {
+        uint64_t generation = 0;
+        bool online = false;
+        std::unique_ptr<Gdiplus::Bitmap> thumbnail;
+        std::shared_ptr<const ArtworkDerivatives> derivatives;  // Colors and blur; shared with the cache
+    };
+    struct ArtworkInbox {
+        std::mutex mutex;
+        std::unique_ptr<ArtworkResult> result;
+    };
+    TaskSlot m_artwork_task;
+    std::shared_ptr<ArtworkInbox> m_artwork_inbox = std::make_shared<ArtworkInbox>();
+    uint64_t m_artwork_generation = 0;  // Request whose result is awaited; 0 = none
+    std::shared_ptr<const ArtworkDerivatives> m_artwork_derivatives;  // Of the current artwork
+    // content_key returns the artwork cache key, or an empty string to bypass
+    // the cache; it runs on the worker.
+    void start_artwork_task(std::function<std::unique_ptr<Gdiplus::Bitmap>()> decode,
+                            std::function<std::string()> content_key, bool online);
+
     // Colors
     Gdiplus::Color m_bg_color;
     Gdiplus::Color m_text_color;
@@ -564,6 +691,8 @@ private:
     // Blurred artwork for background
     std::unique_ptr<Gdiplus::Bitmap> m_blurred_artwork;
     SIZE m_blurred_artwork_size = {0, 0};  // Size the blur was created for
+    std::unique_ptr<Gdiplus::Bitmap> m_blurred_artwork_small;  // Intrinsic-size blur, stretched while resizing
+    static constexpr UINT BLUR_SETTLE_MS = 150;  // Resize quiet time before the exact rebuild
     
     // Background transition animation
     std::unique_ptr<Gdiplus::Bitmap> m_prev_background;  // Cached previous background for crossfade
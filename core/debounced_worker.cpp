@@ -0,0 +1,145 @@
+#include "debounced_worker.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace nowbar {
+
+namespace {
+
+std::mutex g_running_mutex;
+std::condition_variable g_running_cv;
+int g_running = 0;
+
+} // anonymous namespace
+
+struct DebouncedWorker::State {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::chrono::milliseconds delay{0};
+    std::chrono::steady_clock::time_point deadline;
+
+    Work pending;
+    std::function<void()> pending_on_cancel;
+
+    std::shared_ptr<std::atomic<bool>> running_flag;  // Null when idle
+    std::function<void()> running_on_cancel;
+
+    uint64_t runs = 0;
+    bool started = false;
+    bool stopping = false;
+
+    // Called with mutex held; returns the hook to invoke after unlocking.
+    std::function<void()> flag_running() {
+        if (!running_flag || running_flag->load(std::memory_order_relaxed)) return nullptr;
+        running_flag->store(true, std::memory_order_relaxed);
+        return std::move(running_on_cancel);
+    }
+};
+
+DebouncedWorker::DebouncedWorker(std::chrono::milliseconds delay) : m_state(std::make_shared<State>()) {
+    m_state->delay = delay;
+}
+
+DebouncedWorker::~DebouncedWorker() {
+    std::function<void()> hook;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->stopping = true;
+        m_state->pending = nullptr;
+        m_state->pending_on_cancel = nullptr;
+        hook = m_state->flag_running();
+    }
+    m_state->cv.notify_all();
+    if (hook) hook();
+}
+
+void DebouncedWorker::post(Work work, std::function<void()> on_cancel) {
+    std::function<void()> hook;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->pending = std::move(work);
+        m_state->pending_on_cancel = std::move(on_cancel);
+        m_state->deadline = std::chrono::steady_clock::now() + m_state->delay;
+        hook = m_state->flag_running();
+        if (!m_state->started) {
+            m_state->started = true;
+            std::thread(run, m_state).detach();
+        }
+    }
+    m_state->cv.notify_all();
+    if (hook) hook();
+}
+
+void DebouncedWorker::cancel() {
+    std::function<void()> hook;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->pending = nullptr;
+        m_state->pending_on_cancel = nullptr;
+        hook = m_state->flag_running();
+    }
+    m_state->cv.notify_all();
+    if (hook) hook();
+}
+
+uint64_t DebouncedWorker::run_count() const {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->runs;
+}
+
+int DebouncedWorker::running_count() {
+    std::lock_guard<std::mutex> lock(g_running_mutex);
+    return g_running;
+}
+
+bool DebouncedWorker::wait_all(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(g_running_mutex);
+    return g_running_cv.wait_for(lock, timeout, []() { return g_running == 0; });
+}
+
+void DebouncedWorker::run(std::shared_ptr<State> state) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    for (;;) {
+        state->cv.wait(lock, [&]() { return state->stopping || state->pending; });
+        if (state->stopping) return;
+
+        // Quiet period: every post() pushes the deadline out again
+        while (!state->stopping && state->pending && std::chrono::steady_clock::now() < state->deadline) {
+            state->cv.wait_until(lock, state->deadline);
+        }
+        if (state->stopping) return;
+        if (!state->pending) continue;  // Cancelled while waiting
+
+        Work work = std::move(state->pending);
+        state->pending = nullptr;
+        auto flag = std::make_shared<std::atomic<bool>>(false);
+        state->running_flag = flag;
+        state->running_on_cancel = std::move(state->pending_on_cancel);
+        state->pending_on_cancel = nullptr;
+        {
+            // Counted before the state lock is released, so wait_all()
+            // never misses a request that was already taken
+            std::lock_guard<std::mutex> running_lock(g_running_mutex);
+            g_running++;
+        }
+
+        lock.unlock();
+        try {
+            work(*flag);
+        } catch (...) {
+        }
+        work = nullptr;  // Release captures before taking the lock again
+        {
+            std::lock_guard<std::mutex> running_lock(g_running_mutex);
+            if (--g_running == 0) g_running_cv.notify_all();
+        }
+        lock.lock();
+
+        state->running_flag.reset();
+        state->running_on_cancel = nullptr;
+        state->runs++;
+    }
+}
+
+} // namespace nowbar
@@ -0,0 +1,58 @@
+#pragma once
+// Single background worker that runs only the latest request.
+//
+// post() replaces whatever is pending and restarts the quiet period; the
+// work runs once no newer request has arrived for `delay`. A newer post()
+// (or cancel()) also flags the work that is running and calls its cancel
+// hook, so rapid input never queues more than one job and stale work stops
+// early. Jobs run one at a time on the same thread, which lets them share
+// state that is not thread-safe (e.g. an open decoder) without locking.
+//
+// The thread is detached and owns the shared state: destroying the worker
+// cancels everything but never waits for a job stuck in I/O. At component
+// shutdown, wait_all() gives running jobs a bounded time to finish.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace nowbar {
+
+class DebouncedWorker {
+    struct State;
+
+public:
+    using Work = std::function<void(const std::atomic<bool>& cancelled)>;
+
+    explicit DebouncedWorker(std::chrono::milliseconds delay);
+    ~DebouncedWorker();
+    DebouncedWorker(const DebouncedWorker&) = delete;
+    DebouncedWorker& operator=(const DebouncedWorker&) = delete;
+
+    // Supersede the pending and the running request. on_cancel is invoked
+    // once if this work is flagged while running.
+    void post(Work work, std::function<void()> on_cancel = nullptr);
+
+    // Drop the pending request and flag the running one.
+    void cancel();
+
+    // Requests that actually ran (for diagnostics).
+    uint64_t run_count() const;
+
+    // Number of requests running right now, in any worker.
+    static int running_count();
+
+    // Block until no request is running in any worker or the timeout
+    // passes. For component shutdown, after all workers were cancelled.
+    static bool wait_all(std::chrono::milliseconds timeout);
+
+private:
+    static void run(std::shared_ptr<State> state);
+    std::shared_ptr<State> m_state;
+};
+
+} // namespace nowbar
@@ -0,0 +1,103 @@
+#include "image_blur.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// NOWBAR_NO_SIMD forces the scalar path, e.g. to test it on x86.
+#if (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)) && !defined(NOWBAR_NO_SIMD)
+#include <emmintrin.h>
+#define NOWBAR_BLUR_SSE2 1
+#endif
+
+namespace nowbar {
+
+namespace {
+
+// Window sums of one pixel (B, G, R, A). The average is sum * (1 / window)
+// rounded; window is odd, so no sum lies halfway between two integers and
+// single-precision rounding gives the exact integer result in both paths.
+#ifdef NOWBAR_BLUR_SSE2
+
+struct Sum {
+    __m128i v;
+};
+
+inline __m128i load_pixel(const uint8_t* p) {
+    int32_t packed;
+    memcpy(&packed, p, 4);
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+}
+
+inline Sum zero_sum() { return Sum{_mm_setzero_si128()}; }
+inline void add(Sum& s, const uint8_t* p, int times = 1) {
+    __m128i px = load_pixel(p);
+    for (int i = 0; i < times; i++) s.v = _mm_add_epi32(s.v, px);
+}
+inline void slide(Sum& s, const uint8_t* in, const uint8_t* out) {
+    s.v = _mm_add_epi32(s.v, _mm_sub_epi32(load_pixel(in), load_pixel(out)));
+}
+inline void store_average(const Sum& s, float inv, uint8_t* dst) {
+    __m128 avg = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(s.v), _mm_set1_ps(inv)), _mm_set1_ps(0.5f));
+    __m128i i32 = _mm_cvttps_epi32(avg);
+    __m128i i16 = _mm_packs_epi32(i32, i32);
+    int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(i16, i16));
+    memcpy(dst, &packed, 4);
+}
+
+#else
+
+struct Sum {
+    int32_t c[4];
+};
+
+inline Sum zero_sum() { return Sum{{0, 0, 0, 0}}; }
+inline void add(Sum& s, const uint8_t* p, int times = 1) {
+    for (int c = 0; c < 4; c++) s.c[c] += p[c] * times;
+}
+inline void slide(Sum& s, const uint8_t* in, const uint8_t* out) {
+    for (int c = 0; c < 4; c++) s.c[c] += in[c] - out[c];
+}
+inline void store_average(const Sum& s, float inv, uint8_t* dst) {
+    for (int c = 0; c < 4; c++) dst[c] = static_cast<uint8_t>(static_cast<int32_t>(s.c[c] * inv + 0.5f));
+}
+
+#endif
+
+// One box pass along a line of count pixels; steps are in bytes.
+void blur_line(const uint8_t* src, ptrdiff_t src_step, uint8_t* dst, ptrdiff_t dst_step, int count, int radius,
+               float inv) {
+    auto at = [&](int i) { return src + static_cast<ptrdiff_t>(std::clamp(i, 0, count - 1)) * src_step; };
+
+    Sum sum = zero_sum();
+    add(sum, src, radius + 1);  // Left edge repeated
+    for (int i = 1; i <= radius; i++) add(sum, at(i));
+    for (int i = 0; i < count; i++) {
+        store_average(sum, inv, dst + static_cast<ptrdiff_t>(i) * dst_step);
+        slide(sum, at(i + radius + 1), at(i - radius));
+    }
+}
+
+} // anonymous namespace
+
+bool blur_bgra(uint8_t* pixels, int width, int height, ptrdiff_t stride, int radius, int passes) {
+    if (!pixels || width <= 0 || height <= 0 || radius <= 0 || passes <= 0) return false;
+
+    const float inv = 1.0f / (2 * radius + 1);
+    const size_t row_bytes = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> tmp(row_bytes * height);
+
+    for (int pass = 0; pass < passes; pass++) {
+        // Rows into tmp, then columns back into pixels
+        for (int y = 0; y < height; y++) {
+            blur_line(pixels + static_cast<ptrdiff_t>(y) * stride, 4, &tmp[y * row_bytes], 4, width, radius, inv);
+        }
+        for (int x = 0; x < width; x++) {
+            blur_line(&tmp[static_cast<size_t>(x) * 4], static_cast<ptrdiff_t>(row_bytes),
+                      pixels + static_cast<ptrdiff_t>(x) * 4, stride, height, radius, inv);
+        }
+    }
+    return true;
+}
+
+} // namespace nowbar
@@ -0,0 +1,25 @@
+#pragma once
+// Blur of 32-bit images (four 8-bit channels, e.g. GDI+ 32bppARGB which is
+// BGRA in memory).
+//
+// blur_bgra() runs a separable box filter with running sums: each output
+// pixel adds the pixel entering the window and subtracts the one leaving it,
+// so the cost per pixel does not depend on the radius. Repeating the box
+// (three passes by default) approximates a Gaussian. Edges repeat the
+// border pixel, so borders neither darken nor fade to transparent. The four
+// channels of a pixel are processed together with SSE2 where available.
+// Channels are filtered independently (straight alpha).
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include <cstddef>
+#include <cstdint>
+
+namespace nowbar {
+
+// Blur pixels in place with a (2 * radius + 1) wide box, passes times in
+// each direction. Stride is in bytes. Returns false (leaving pixels
+// untouched) if a size, the radius or passes is not positive.
+bool blur_bgra(uint8_t* pixels, int width, int height, ptrdiff_t stride, int radius, int passes = 3);
+
+} // namespace nowbar
@@ -0,0 +1,228 @@
+#include "image_resample.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// NOWBAR_NO_SIMD forces the scalar path, e.g. to test it on x86.
+#if (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)) && !defined(NOWBAR_NO_SIMD)
+#include <emmintrin.h>
+#define NOWBAR_RESAMPLE_SSE2 1
+#endif
+
+namespace nowbar {
+
+namespace {
+
+constexpr int WEIGHT_BITS = 14;
+constexpr int32_t WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+// Filter taps of every output pixel along one axis: output i reads
+// count[i] source pixels starting at first[i], with weights
+// weights[i * taps .. i * taps + count[i]).
+struct Taps {
+    int taps = 0;
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<int32_t> weights;
+};
+
+Taps make_taps(int in_size, int out_size) {
+    double scale = (double)in_size / out_size;
+    double filter_scale = std::max(scale, 1.0);
+    double support = filter_scale;  // Triangle of radius 1, widened when shrinking
+
+    Taps t;
+    t.taps = (int)std::ceil(support) * 2 + 1;
+    t.first.resize(out_size);
+    t.count.resize(out_size);
+    t.weights.assign((size_t)out_size * t.taps, 0);
+
+    std::vector<double> w(t.taps);
+    for (int i = 0; i < out_size; i++) {
+        double center = (i + 0.5) * scale;
+        int lo = std::max((int)(center - support + 0.5), 0);
+        int hi = std::min((int)(center + support + 0.5), in_size);
+        int n = std::min(hi - lo, t.taps);
+
+        double total = 0.0;
+        for (int k = 0; k < n; k++) {
+            double x = (lo + k + 0.5 - center) / filter_scale;
+            w[k] = std::max(0.0, 1.0 - std::fabs(x));
+            total += w[k];
+        }
+
+        // Quantize, then give the rounding error to the largest weight so the
+        // taps sum to exactly WEIGHT_ONE
+        int32_t* out = &t.weights[(size_t)i * t.taps];
+        int32_t sum = 0;
+        int largest = 0;
+        for (int k = 0; k < n; k++) {
+            out[k] = total > 0.0 ? (int32_t)std::lround(w[k] / total * WEIGHT_ONE) : 0;
+            sum += out[k];
+            if (out[k] > out[largest]) largest = k;
+        }
+        if (n > 0) out[largest] += WEIGHT_ONE - sum;
+
+        t.first[i] = lo;
+        t.count[i] = n;
+    }
+    return t;
+}
+
+inline uint8_t clamp_channel(int32_t acc) {
+    acc >>= WEIGHT_BITS;
+    return (uint8_t)(acc < 0 ? 0 : (acc > 255 ? 255 : acc));
+}
+
+// Bilinear stretch: 7-bit weights keep a row blend within int16
+// (255 * 128) and a pixel within int32, so SSE2 can use pmaddwd.
+constexpr int LERP_BITS = 7;
+constexpr int32_t LERP_ONE = 1 << LERP_BITS;
+
+// Source pair and weight of every output position along one axis.
+struct LerpTable {
+    std::vector<int> first;      // Left/top source pixel
+    std::vector<int> second;     // Right/bottom source pixel
+    std::vector<int16_t> weight;  // Of second, 0..LERP_ONE
+};
+
+LerpTable make_lerp_table(int in_size, double crop_pos, double crop_size, int out_size) {
+    LerpTable t;
+    t.first.resize(out_size);
+    t.second.resize(out_size);
+    t.weight.resize(out_size);
+
+    // 16.16 fixed point position of each output pixel, computed from its
+    // index: stepping by a rounded increment drifts by up to 0.03 px across
+    // a 4K-wide output
+    const double scale = crop_size / out_size;
+    for (int i = 0; i < out_size; i++) {
+        int64_t p = std::max<int64_t>(std::llround((crop_pos + i * scale) * 65536.0), 0);
+        int lo = static_cast<int>(std::min<int64_t>(p >> 16, in_size - 1));
+        t.first[i] = lo;
+        t.second[i] = std::min(lo + 1, in_size - 1);
+        // Rounded to nearest; LERP_ONE takes all of second
+        t.weight[i] = static_cast<int16_t>(((p & 0xFFFF) + (1 << (15 - LERP_BITS))) >> (16 - LERP_BITS));
+    }
+    return t;
+}
+
+} // anonymous namespace
+
+bool resample_bgra(const uint8_t* src, int src_width, int src_height, ptrdiff_t src_stride,
+                   uint8_t* dst, int dst_width, int dst_height, ptrdiff_t dst_stride) {
+    if (!src || !dst || src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) return false;
+
+    Taps horizontal = make_taps(src_width, dst_width);
+    Taps vertical = make_taps(src_height, dst_height);
+
+    // Horizontal pass into a dst_width x src_height buffer, only for the rows
+    // the vertical pass reads
+    int row_lo = vertical.first.front();
+    int row_hi = vertical.first.back() + vertical.count.back();
+    size_t tmp_stride = (size_t)dst_width * 4;
+    std::vector<uint8_t> tmp(tmp_stride * (size_t)(row_hi - row_lo));
+
+    for (int y = row_lo; y < row_hi; y++) {
+        const uint8_t* in = src + (ptrdiff_t)y * src_stride;
+        uint8_t* out = &tmp[(size_t)(y - row_lo) * tmp_stride];
+        for (int x = 0; x < dst_width; x++) {
+            const int32_t* w = &horizontal.weights[(size_t)x * horizontal.taps];
+            const uint8_t* p = in + (size_t)horizontal.first[x] * 4;
+            int32_t acc[4] = {WEIGHT_ONE / 2, WEIGHT_ONE / 2, WEIGHT_ONE / 2, WEIGHT_ONE / 2};
+            for (int k = 0; k < horizontal.count[x]; k++, p += 4) {
+                acc[0] += p[0] * w[k];
+                acc[1] += p[1] * w[k];
+                acc[2] += p[2] * w[k];
+                acc[3] += p[3] * w[k];
+            }
+            out[x * 4 + 0] = clamp_channel(acc[0]);
+            out[x * 4 + 1] = clamp_channel(acc[1]);
+            out[x * 4 + 2] = clamp_channel(acc[2]);
+            out[x * 4 + 3] = clamp_channel(acc[3]);
+        }
+    }
+
+    // Vertical pass
+    std::vector<int32_t> acc(tmp_stride);
+    for (int y = 0; y < dst_height; y++) {
+        const int32_t* w = &vertical.weights[(size_t)y * vertical.taps];
+        std::fill(acc.begin(), acc.end(), WEIGHT_ONE / 2);
+        for (int k = 0; k < vertical.count[y]; k++) {
+            const uint8_t* in = &tmp[(size_t)(vertical.first[y] + k - row_lo) * tmp_stride];
+            int32_t weight = w[k];
+            for (size_t i = 0; i < tmp_stride; i++) acc[i] += in[i] * weight;
+        }
+        uint8_t* out = dst + (ptrdiff_t)y * dst_stride;
+        for (size_t i = 0; i < tmp_stride; i++) out[i] = clamp_channel(acc[i]);
+    }
+    return true;
+}
+
+bool stretch_bilinear_bgra(const uint8_t* src, int src_width, int src_height, ptrdiff_t src_stride,
+                           double crop_x, double crop_y, double crop_width, double crop_height,
+                           uint8_t* dst, int dst_width, int dst_height, ptrdiff_t dst_stride) {
+    if (!src || !dst || src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0 ||
+        !(crop_width > 0.0) || !(crop_height > 0.0)) {
+        return false;
+    }
+
+    LerpTable columns = make_lerp_table(src_width, crop_x, crop_width, dst_width);
+    LerpTable rows = make_lerp_table(src_height, crop_y, crop_height, dst_height);
+
+    // Only the source columns the table reads are blended per row
+    int col_lo = *std::min_element(columns.first.begin(), columns.first.end());
+    int col_hi = *std::max_element(columns.second.begin(), columns.second.end()) + 1;
+    size_t blend_channels = static_cast<size_t>(col_hi - col_lo) * 4;
+    std::vector<int16_t> blend(blend_channels + 8);  // Padded for 8-channel loads
+
+    for (int y = 0; y < dst_height; y++) {
+        const uint8_t* top = src + static_cast<ptrdiff_t>(rows.first[y]) * src_stride + static_cast<size_t>(col_lo) * 4;
+        const uint8_t* bottom = src + static_cast<ptrdiff_t>(rows.second[y]) * src_stride + static_cast<size_t>(col_lo) * 4;
+        int16_t wy = rows.weight[y];
+
+        // Vertical blend of the two source rows, scaled by LERP_ONE
+        size_t i = 0;
+#ifdef NOWBAR_RESAMPLE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i w_top = _mm_set1_epi16(static_cast<int16_t>(LERP_ONE - wy));
+        const __m128i w_bottom = _mm_set1_epi16(wy);
+        for (; i + 8 <= blend_channels; i += 8) {
+            __m128i t = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(top + i)), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bottom + i)), zero);
+            __m128i v = _mm_add_epi16(_mm_mullo_epi16(t, w_top), _mm_mullo_epi16(b, w_bottom));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&blend[i]), v);
+        }
+#endif
+        for (; i < blend_channels; i++) {
+            blend[i] = static_cast<int16_t>(top[i] * (LERP_ONE - wy) + bottom[i] * wy);
+        }
+
+        // Horizontal: one weighted pair per output pixel
+        uint8_t* out = dst + static_cast<ptrdiff_t>(y) * dst_stride;
+        for (int x = 0; x < dst_width; x++) {
+            const int16_t* a = &blend[static_cast<size_t>(columns.first[x] - col_lo) * 4];
+            const int16_t* b = &blend[static_cast<size_t>(columns.second[x] - col_lo) * 4];
+            int16_t wx = columns.weight[x];
+#ifdef NOWBAR_RESAMPLE_SSE2
+            __m128i pa = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a));
+            __m128i pb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b));
+            __m128i w = _mm_set1_epi32((static_cast<int32_t>(wx) << 16) | static_cast<uint16_t>(LERP_ONE - wx));
+            __m128i acc = _mm_madd_epi16(_mm_unpacklo_epi16(pa, pb), w);
+            acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(1 << (2 * LERP_BITS - 1))), 2 * LERP_BITS);
+            __m128i px16 = _mm_packs_epi32(acc, acc);
+            int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(px16, px16));
+            memcpy(out + static_cast<size_t>(x) * 4, &packed, 4);
+#else
+            for (int c = 0; c < 4; c++) {
+                int32_t acc = a[c] * (LERP_ONE - wx) + b[c] * wx + (1 << (2 * LERP_BITS - 1));
+                out[x * 4 + c] = static_cast<uint8_t>(acc >> (2 * LERP_BITS));
+            }
+#endif
+        }
+    }
+    return true;
+}
+
+} // namespace nowbar
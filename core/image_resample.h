@@ -0,0 +1,41 @@
+#pragma once
+// Resizing of 32-bit images (four 8-bit channels, e.g. GDI+ 32bppARGB which
+// is BGRA in memory).
+//
+// resample_bgra() is a separable triangle (bilinear) filter. When enlarging
+// it is plain bilinear interpolation, the same as GDI+ InterpolationModeBilinear;
+// when shrinking the filter widens with the scale factor so every source
+// pixel contributes, where GDI+ bilinear only looks at the 2x2 pixels around
+// each sample and aliases on large reductions. Weights are 14-bit fixed
+// point and sum to exactly one per output pixel, so flat areas stay flat.
+// Channels are filtered independently (straight alpha).
+//
+// stretch_bilinear_bgra() is the cheap path for enlarging a small image to
+// a large one (the blurred background): plain bilinear interpolation of a
+// source window, with the source position and weights of every column and
+// row computed once in 16.16 fixed point. Each output row blends its two
+// source rows once, then every output pixel is a single weighted pair,
+// four channels at a time with SSE2 where available.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include <cstddef>
+#include <cstdint>
+
+namespace nowbar {
+
+// Resize src into dst. Strides are in bytes and may differ from width * 4.
+// Returns false (leaving dst untouched) if a size is not positive.
+bool resample_bgra(const uint8_t* src, int src_width, int src_height, ptrdiff_t src_stride,
+                   uint8_t* dst, int dst_width, int dst_height, ptrdiff_t dst_stride);
+
+// Map the source window at (crop_x, crop_y) of crop_width x crop_height
+// source pixels (fractions allowed) onto all of dst. Output pixel x samples
+// source x = crop_x + x * crop_width / dst_width, likewise for y, clamped
+// to the image. Returns false (leaving dst untouched) if a size is not
+// positive.
+bool stretch_bilinear_bgra(const uint8_t* src, int src_width, int src_height, ptrdiff_t src_stride,
+                           double crop_x, double crop_y, double crop_width, double crop_height,
+                           uint8_t* dst, int dst_width, int dst_height, ptrdiff_t dst_stride);
+
+} // namespace nowbar
@@ -0,0 +1,311 @@
+#pragma once
+// Process-wide pool of keyed background jobs.
+//
+// A small fixed number of workers runs queued jobs, highest priority first
+// and in submission order within a priority. Jobs are deduplicated by key:
+// subscribing to a key that is already queued or running attaches to that
+// job instead of starting another one, and the newcomer is sent the job's
+// latest update right away. A job is cancelled when its last subscriber
+// leaves; a queued job is dropped, a running one is flagged and its cancel
+// hook runs (e.g. to abort blocking I/O) without waiting for it.
+//
+// A cancelled job that is still running no longer counts against the
+// worker limit, so a decode stuck in blocking I/O cannot starve the queue:
+// a replacement worker starts if work is waiting, and whichever worker is
+// then surplus exits once it returns. Replacements stop at
+// MAX_EXTRA_WORKERS above the limit: past that, queued work waits for a
+// stuck job to return rather than piling up threads.
+//
+// Listeners run on the worker thread under the job's lock, so once
+// unsubscribe() returns a listener is never called again. They should hand
+// the update off (e.g. post it to a window) and must not subscribe or
+// unsubscribe from inside the call.
+//
+// Workers are detached and share the pool state, so a worker stuck in I/O
+// at shutdown cannot take the process down with it.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace nowbar {
+
+enum class JobPriority : int {
+    NowPlaying = 0,  // A panel is waiting to show the result
+    Prefetch = 1,    // Likely needed soon (e.g. the next track)
+    Batch = 2,       // Background work nobody is waiting for
+};
+
+template <typename Update>
+class KeyedJobPool {
+    struct State;
+
+public:
+    static constexpr unsigned MAX_EXTRA_WORKERS = 2;  // Replacements for workers stuck in cancelled jobs
+
+    using Listener = std::function<void(const Update&)>;
+
+    class Job {
+    public:
+        const std::string& key() const { return m_key; }
+        bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+        // Deliver an update to every current subscriber; it is also kept
+        // for subscribers that join later.
+        void notify(const Update& update) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_last = update;
+            for (auto& entry : m_listeners) entry.second(update);
+        }
+
+    private:
+        friend class KeyedJobPool;
+
+        std::string m_key;
+        JobPriority m_priority = JobPriority::Batch;
+        uint64_t m_sequence = 0;
+        std::function<void(Job&)> m_body;
+        std::function<void()> m_on_cancel;
+        std::atomic<bool> m_cancelled{false};
+        bool m_running = false;    // Taken by a worker; guarded by State::mutex
+        bool m_abandoned = false;  // Cancelled while running; guarded by State::mutex
+
+        std::mutex m_mutex;  // Guards the listeners and the last update
+        std::vector<std::pair<uint64_t, Listener>> m_listeners;
+        std::optional<Update> m_last;
+    };
+    using Body = std::function<void(Job&)>;
+
+    // One subscriber's interest in a job. Destroying it unsubscribes.
+    class Subscription {
+    public:
+        ~Subscription() { unsubscribe(); }
+        Subscription(const Subscription&) = delete;
+        Subscription& operator=(const Subscription&) = delete;
+
+        void unsubscribe();
+
+    private:
+        friend class KeyedJobPool;
+        Subscription(std::weak_ptr<State> state, std::shared_ptr<Job> job, uint64_t id)
+            : m_state(std::move(state)), m_job(std::move(job)), m_id(id) {}
+
+        std::weak_ptr<State> m_state;
+        std::shared_ptr<Job> m_job;
+        uint64_t m_id;
+    };
+    using SubscriptionPtr = std::unique_ptr<Subscription>;
+
+    explicit KeyedJobPool(unsigned workers) : m_state(std::make_shared<State>()) {
+        m_state->max_workers = std::max(1u, workers);
+    }
+    ~KeyedJobPool() { stop(); }
+    KeyedJobPool(const KeyedJobPool&) = delete;
+    KeyedJobPool& operator=(const KeyedJobPool&) = delete;
+
+    // Attach listener to the job for key, queueing body if no such job is
+    // pending. body and on_cancel are ignored when joining an existing job,
+    // whose priority is raised if the new one is higher. Returns null after
+    // shutdown().
+    SubscriptionPtr subscribe(const std::string& key, JobPriority priority, Body body, Listener listener,
+                              std::function<void()> on_cancel = nullptr);
+
+    // Cancel every job, stop the workers and wait up to timeout for them to
+    // leave their current job. For component shutdown.
+    bool shutdown(std::chrono::milliseconds timeout);
+
+    // Jobs queued or running (for diagnostics).
+    size_t pending_count() const {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        return m_state->active.size();
+    }
+
+    // Worker threads alive, stuck ones included (for diagnostics).
+    unsigned worker_count() const {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        return m_state->workers;
+    }
+
+private:
+    struct State {
+        mutable std::mutex mutex;  // Taken before any Job::m_mutex
+        std::condition_variable work_cv;
+        std::condition_variable idle_cv;
+        std::vector<std::shared_ptr<Job>> queue;
+        std::unordered_map<std::string, std::shared_ptr<Job>> active;  // Queued or running
+        unsigned max_workers = 1;
+        unsigned workers = 0;    // Started and not yet exited
+        unsigned abandoned = 0;  // Workers still running a cancelled job
+        uint64_t next_sequence = 0;
+        uint64_t next_listener = 0;
+        bool stopping = false;
+    };
+
+    static void worker(std::shared_ptr<State> state);
+    static void start_worker_if_needed(const std::shared_ptr<State>& state);
+    static bool cancel_job(State& state, const std::shared_ptr<Job>& job);
+    void stop();
+
+    std::shared_ptr<State> m_state;
+};
+
+// Called with state.mutex held once the job has no subscribers left. False
+// if the job already finished or was cancelled.
+template <typename Update>
+bool KeyedJobPool<Update>::cancel_job(State& state, const std::shared_ptr<Job>& job) {
+    auto it = state.active.find(job->m_key);
+    if (it == state.active.end() || it->second != job) return false;
+    state.active.erase(it);
+    state.queue.erase(std::remove(state.queue.begin(), state.queue.end(), job), state.queue.end());
+    job->m_cancelled.store(true, std::memory_order_relaxed);
+    if (job->m_running) {
+        job->m_abandoned = true;
+        state.abandoned++;
+    }
+    return true;
+}
+
+// Called with state->mutex held. Workers whose job was cancelled under
+// them do not count toward max_workers, but every thread counts toward the
+// hard cap.
+template <typename Update>
+void KeyedJobPool<Update>::start_worker_if_needed(const std::shared_ptr<State>& state) {
+    if (state->stopping || state->queue.empty()) return;
+    if (state->workers - state->abandoned >= state->max_workers) return;
+    if (state->workers >= state->max_workers + MAX_EXTRA_WORKERS) return;
+    state->workers++;
+    std::thread(worker, state).detach();
+}
+
+template <typename Update>
+void KeyedJobPool<Update>::Subscription::unsubscribe() {
+    if (!m_job) return;
+    std::shared_ptr<Job> job = std::move(m_job);
+    std::shared_ptr<State> state = m_state.lock();
+    bool cancelled = false;
+    {
+        std::unique_lock<std::mutex> pool_lock;
+        if (state) pool_lock = std::unique_lock<std::mutex>(state->mutex);
+        std::lock_guard<std::mutex> lock(job->m_mutex);
+        auto& listeners = job->m_listeners;
+        listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+                                       [this](const auto& entry) { return entry.first == m_id; }),
+                        listeners.end());
+        if (listeners.empty() && state) {
+            cancelled = cancel_job(*state, job);
+            if (cancelled) start_worker_if_needed(state);
+        }
+    }
+    if (cancelled && job->m_on_cancel) job->m_on_cancel();
+}
+
+template <typename Update>
+typename KeyedJobPool<Update>::SubscriptionPtr KeyedJobPool<Update>::subscribe(
+    const std::string& key, JobPriority priority, Body body, Listener listener, std::function<void()> on_cancel) {
+    State& state = *m_state;
+    std::lock_guard<std::mutex> pool_lock(state.mutex);
+    if (state.stopping) return nullptr;
+
+    uint64_t id = ++state.next_listener;
+    std::shared_ptr<Job> job;
+    auto it = state.active.find(key);
+    if (it != state.active.end()) {
+        job = it->second;
+        if (priority < job->m_priority) job->m_priority = priority;  // Only matters while queued
+        std::lock_guard<std::mutex> lock(job->m_mutex);
+        if (job->m_last) listener(*job->m_last);
+        job->m_listeners.emplace_back(id, std::move(listener));
+    } else {
+        job = std::make_shared<Job>();
+        job->m_key = key;
+        job->m_priority = priority;
+        job->m_sequence = ++state.next_sequence;
+        job->m_body = std::move(body);
+        job->m_on_cancel = std::move(on_cancel);
+        job->m_listeners.emplace_back(id, std::move(listener));
+        state.active.emplace(key, job);
+        state.queue.push_back(job);
+        start_worker_if_needed(m_state);
+        state.work_cv.notify_one();
+    }
+    return SubscriptionPtr(new Subscription(m_state, job, id));
+}
+
+template <typename Update>
+void KeyedJobPool<Update>::worker(std::shared_ptr<State> state) {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->work_cv.wait(lock, [&]() { return state->stopping || !state->queue.empty(); });
+            if (state->stopping) break;
+            auto best = std::min_element(state->queue.begin(), state->queue.end(),
+                                         [](const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) {
+                                             if (a->m_priority != b->m_priority) return a->m_priority < b->m_priority;
+                                             return a->m_sequence < b->m_sequence;
+                                         });
+            job = *best;
+            job->m_running = true;
+            state->queue.erase(best);
+        }
+
+        try {
+            job->m_body(*job);
+        } catch (...) {
+        }
+
+        job->m_body = nullptr;  // Release whatever the body captured
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            auto it = state->active.find(job->m_key);
+            if (it != state->active.end() && it->second == job) state->active.erase(it);
+            job->m_running = false;
+            if (job->m_abandoned) state->abandoned--;
+            // A replacement took this worker's place while it was stuck
+            if (state->workers - state->abandoned > state->max_workers) break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (--state->workers == 0) state->idle_cv.notify_all();
+}
+
+template <typename Update>
+void KeyedJobPool<Update>::stop() {
+    std::vector<std::shared_ptr<Job>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        if (m_state->stopping) return;
+        m_state->stopping = true;
+        for (auto& entry : m_state->active) jobs.push_back(entry.second);
+        m_state->active.clear();
+        m_state->queue.clear();
+        for (auto& job : jobs) job->m_cancelled.store(true, std::memory_order_relaxed);
+    }
+    m_state->work_cv.notify_all();
+    for (auto& job : jobs) {
+        if (job->m_on_cancel) job->m_on_cancel();
+    }
+}
+
+template <typename Update>
+bool KeyedJobPool<Update>::shutdown(std::chrono::milliseconds timeout) {
+    stop();
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    return m_state->idle_cv.wait_for(lock, timeout, [this]() { return m_state->workers == 0; });
+}
+
+} // namespace nowbar
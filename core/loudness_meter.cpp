@@ -0,0 +1,150 @@
+#include "loudness_meter.h"
+#include <cmath>
+
+namespace nowbar {
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double ABSOLUTE_GATE_LUFS = -70.0;
+constexpr double RELATIVE_GATE_LU = -10.0;
+constexpr size_t HOPS_PER_BLOCK = 4;  // 400 ms blocks, 100 ms step
+
+double energy_to_lufs(double energy) {
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+} // anonymous namespace
+
+// Filter coefficients from BS.1770 for any sample rate (the standard only
+// tabulates 48 kHz), using the analog prototypes' published parameters.
+void LoudnessMeter::set_format(uint32_t sample_rate, unsigned channels) {
+    // Close the partial hop at its own mean; its frame count means nothing
+    // at the new rate.
+    if (m_hop_filled > 0) m_hops.push_back(m_hop_energy / static_cast<double>(m_hop_filled));
+    m_hop_filled = 0;
+    m_hop_energy = 0.0;
+
+    m_sample_rate = sample_rate;
+    m_channels.assign(channels, ChannelState());
+    m_hop_frames = sample_rate >= 10 ? sample_rate / 10 : 1;
+    if (sample_rate == 0) return;
+
+    // Stage 1: high shelf modelling the acoustic effect of the head
+    {
+        const double f0 = 1681.974450955533;
+        const double gain_db = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        double k = std::tan(PI * f0 / sample_rate);
+        double vh = std::pow(10.0, gain_db / 20.0);
+        double vb = std::pow(vh, 0.4996667741545416);
+        double a0 = 1.0 + k / q + k * k;
+        Biquad& s = m_stage[0];
+        s.b0 = (vh + vb * k / q + k * k) / a0;
+        s.b1 = 2.0 * (k * k - vh) / a0;
+        s.b2 = (vh - vb * k / q + k * k) / a0;
+        s.a1 = 2.0 * (k * k - 1.0) / a0;
+        s.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    // Stage 2: RLB high pass
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        double k = std::tan(PI * f0 / sample_rate);
+        double a0 = 1.0 + k / q + k * k;
+        Biquad& s = m_stage[1];
+        s.b0 = 1.0;
+        s.b1 = -2.0;
+        s.b2 = 1.0;
+        s.a1 = 2.0 * (k * k - 1.0) / a0;
+        s.a2 = (1.0 - k / q + k * k) / a0;
+    }
+}
+
+void LoudnessMeter::set_channel_weight(unsigned channel, double weight) {
+    if (channel < m_channels.size()) m_channels[channel].weight = weight;
+}
+
+template <typename Sample>
+void LoudnessMeter::add_frames(const Sample* frames, size_t frame_count) {
+    const unsigned channels = static_cast<unsigned>(m_channels.size());
+    if (channels == 0 || m_sample_rate == 0) return;
+    const Biquad s0 = m_stage[0], s1 = m_stage[1];
+
+    for (size_t f = 0; f < frame_count; f++) {
+        const Sample* frame = frames + f * channels;
+        for (unsigned ch = 0; ch < channels; ch++) {
+            ChannelState& c = m_channels[ch];
+            double x = static_cast<double>(frame[ch]);
+            double y = s0.b0 * x + c.z1[0];
+            c.z1[0] = s0.b1 * x - s0.a1 * y + c.z2[0];
+            c.z2[0] = s0.b2 * x - s0.a2 * y;
+            double v = s1.b0 * y + c.z1[1];
+            c.z1[1] = s1.b1 * y - s1.a1 * v + c.z2[1];
+            c.z2[1] = s1.b2 * y - s1.a2 * v;
+            m_hop_energy += c.weight * v * v;
+        }
+        if (++m_hop_filled >= m_hop_frames) {
+            m_hops.push_back(m_hop_energy / static_cast<double>(m_hop_frames));
+            m_hop_energy = 0.0;
+            m_hop_filled = 0;
+        }
+    }
+}
+
+void LoudnessMeter::add(const float* frames, size_t frame_count) {
+    add_frames(frames, frame_count);
+}
+
+void LoudnessMeter::add(const double* frames, size_t frame_count) {
+    add_frames(frames, frame_count);
+}
+
+bool LoudnessMeter::integrated(double& out_lufs) const {
+    if (m_hops.size() < HOPS_PER_BLOCK) return false;
+
+    // Block energies: mean of four consecutive hops
+    std::vector<double> blocks;
+    blocks.reserve(m_hops.size() - HOPS_PER_BLOCK + 1);
+    for (size_t i = 0; i + HOPS_PER_BLOCK <= m_hops.size(); i++) {
+        double sum = 0.0;
+        for (size_t k = 0; k < HOPS_PER_BLOCK; k++) sum += m_hops[i + k];
+        blocks.push_back(sum / HOPS_PER_BLOCK);
+    }
+
+    // Absolute gate, then relative gate 10 LU below the absolute-gated mean
+    double sum = 0.0;
+    size_t count = 0;
+    for (double e : blocks) {
+        if (e > 0.0 && energy_to_lufs(e) > ABSOLUTE_GATE_LUFS) {
+            sum += e;
+            count++;
+        }
+    }
+    if (count == 0) return false;
+    double relative_gate = energy_to_lufs(sum / count) + RELATIVE_GATE_LU;
+
+    sum = 0.0;
+    count = 0;
+    for (double e : blocks) {
+        if (e > 0.0) {
+            double l = energy_to_lufs(e);
+            if (l > ABSOLUTE_GATE_LUFS && l > relative_gate) {
+                sum += e;
+                count++;
+            }
+        }
+    }
+    if (count == 0) return false;
+    out_lufs = energy_to_lufs(sum / count);
+    return true;
+}
+
+void LoudnessMeter::reset() {
+    for (ChannelState& c : m_channels) c = ChannelState{{0, 0}, {0, 0}, c.weight};
+    m_hop_filled = 0;
+    m_hop_energy = 0.0;
+    m_hops.clear();
+}
+
+} // namespace nowbar
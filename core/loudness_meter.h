@@ -0,0 +1,62 @@
+#pragma once
+// Integrated loudness (EBU R128 / ITU-R BS.1770-4), measured alongside the
+// waveform in the same decode pass.
+//
+// Samples are K-weighted (high shelf + high pass), mean square energy is
+// collected per 100 ms, and the integrated value is computed at the end from
+// 400 ms blocks with 75% overlap, gated at -70 LUFS absolute and -10 LU
+// relative. Only the 100 ms energies are kept (10 doubles per second).
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and checked against reference signals outside foobar2000.
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nowbar {
+
+class LoudnessMeter {
+public:
+    LoudnessMeter() = default;
+
+    // (Re)configure for a stream format. Filter state restarts; energy
+    // already collected is kept and a partly filled 100 ms hop is closed,
+    // so a mid-track format change is harmless. Channel weights reset to 1.
+    void set_format(uint32_t sample_rate, unsigned channels);
+
+    // BS.1770 weights: 1 for front channels, 1.41 for surround, 0 for LFE.
+    void set_channel_weight(unsigned channel, double weight);
+
+    // Feed interleaved frames in the configured format.
+    void add(const float* frames, size_t frame_count);
+    void add(const double* frames, size_t frame_count);
+
+    // Integrated loudness in LUFS. False if less than one gated 400 ms block
+    // was measured (silence or very short audio).
+    bool integrated(double& out_lufs) const;
+
+    void reset();
+
+private:
+    struct Biquad {
+        double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    };
+    struct ChannelState {
+        double z1[2] = {0, 0};   // Transposed direct form II state, per stage
+        double z2[2] = {0, 0};
+        double weight = 1.0;
+    };
+
+    template <typename Sample>
+    void add_frames(const Sample* frames, size_t frame_count);
+
+    uint32_t m_sample_rate = 0;
+    Biquad m_stage[2];
+    std::vector<ChannelState> m_channels;
+    size_t m_hop_frames = 0;        // Frames per 100 ms
+    size_t m_hop_filled = 0;
+    double m_hop_energy = 0.0;      // Weighted sum of squares in the current hop
+    std::vector<double> m_hops;     // Mean square energy per completed 100 ms hop
+};
+
+} // namespace nowbar
@@ -0,0 +1,128 @@
+#pragma once
+// Thread-safe map from string keys to values, bounded by a byte budget and
+// evicting least-recently-used entries. Backs the in-memory waveform and
+// artwork caches, which differ only in what they store and how its size is
+// counted.
+//
+// Size is a functor returning the heap bytes a value holds; the key, list
+// node and hash bucket are added on top. An entry larger than the whole
+// budget is not inserted, since it would evict everything else for nothing.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace nowbar {
+
+template <typename Value, typename Size>
+class LruByteCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t capacity_bytes = 0;
+    };
+
+    explicit LruByteCache(size_t capacity_bytes) : m_capacity(capacity_bytes) {}
+
+    // Shrinking the budget evicts immediately.
+    void set_capacity(size_t capacity_bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_capacity = capacity_bytes;
+        evict_to(m_capacity);
+    }
+
+    // Copies the value into out and marks the entry most recently used.
+    bool lookup(const std::string& key, Value& out) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(key);
+        if (it == m_index.end()) {
+            m_misses++;
+            return false;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        out = it->second->value;
+        m_hits++;
+        return true;
+    }
+
+    void insert(const std::string& key, Value value) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t bytes = entry_bytes(key, value);
+        if (bytes > m_capacity) return;
+
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_bytes -= it->second->bytes;
+            it->second->value = std::move(value);
+            it->second->bytes = bytes;
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+        } else {
+            m_lru.push_front(Entry{key, std::move(value), bytes});
+            m_index[key] = m_lru.begin();
+        }
+        m_bytes += bytes;
+        evict_to(m_capacity);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_lru.clear();
+        m_index.clear();
+        m_bytes = 0;
+    }
+
+    Stats get_stats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Stats stats;
+        stats.hits = m_hits;
+        stats.misses = m_misses;
+        stats.evictions = m_evictions;
+        stats.entries = m_lru.size();
+        stats.bytes = m_bytes;
+        stats.capacity_bytes = m_capacity;
+        return stats;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        Value value;
+        size_t bytes;
+    };
+
+    static size_t entry_bytes(const std::string& key, const Value& value) {
+        // Approximate heap footprint: value, key, list node and hash bucket.
+        return Size()(value) + key.size() * 2 + sizeof(Entry) + 64;
+    }
+
+    void evict_to(size_t budget) {
+        while (m_bytes > budget && !m_lru.empty()) {
+            Entry& victim = m_lru.back();
+            m_bytes -= victim.bytes;
+            m_index.erase(victim.key);
+            m_lru.pop_back();
+            m_evictions++;
+        }
+    }
+
+    size_t m_capacity;
+    size_t m_bytes = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    uint64_t m_evictions = 0;
+    std::list<Entry> m_lru;  // Front = most recently used
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> m_index;
+    std::mutex m_mutex;
+};
+
+} // namespace nowbar
@@ -0,0 +1,211 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+namespace nowbar {
+
+#ifdef _WIN32
+
+static std::wstring widen(const std::string& utf8) {
+    if (utf8.empty()) return std::wstring();
+    int len = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), nullptr, 0);
+    std::wstring out(len, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), &out[0], len);
+    return out;
+}
+
+bool MappedFile::open(const std::string& utf8_path, uint64_t min_size) {
+    close();
+    std::wstring wide = widen(utf8_path);
+    HANDLE file = CreateFileW(wide.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    m_file = file;
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size)) {
+        close();
+        return false;
+    }
+    m_size = static_cast<uint64_t>(size.QuadPart);
+    m_open = true;
+
+    if (m_size < min_size) return resize(min_size);
+    if (!map()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::map() {
+    // A zero-length file cannot be mapped; treat it as an empty view.
+    if (m_size == 0) return true;
+    HANDLE mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(m_size >> 32),
+                                        static_cast<DWORD>(m_size & 0xFFFFFFFF), nullptr);
+    if (!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_data = static_cast<uint8_t*>(view);
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+}
+
+void MappedFile::close() {
+    unmap();
+    if (m_file) {
+        CloseHandle(m_file);
+        m_file = nullptr;
+    }
+    m_size = 0;
+    m_open = false;
+}
+
+bool MappedFile::resize(uint64_t new_size) {
+    if (!m_open) return false;
+    unmap();
+    LARGE_INTEGER pos;
+    pos.QuadPart = static_cast<LONGLONG>(new_size);
+    if (!SetFilePointerEx(m_file, pos, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file)) {
+        close();
+        return false;
+    }
+    m_size = new_size;
+    if (!map()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::flush() {
+    if (!m_data) return m_open;
+    return FlushViewOfFile(m_data, 0) && FlushFileBuffers(m_file);
+}
+
+bool file_exists(const std::string& utf8_path) {
+    DWORD attr = GetFileAttributesW(widen(utf8_path).c_str());
+    return attr != INVALID_FILE_ATTRIBUTES && !(attr & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+bool replace_file(const std::string& src_utf8, const std::string& dst_utf8) {
+    return MoveFileExW(widen(src_utf8).c_str(), widen(dst_utf8).c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+}
+
+bool remove_file(const std::string& utf8_path) {
+    return DeleteFileW(widen(utf8_path).c_str()) != FALSE;
+}
+
+#else  // POSIX
+
+bool MappedFile::open(const std::string& utf8_path, uint64_t min_size) {
+    close();
+    int fd = ::open(utf8_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    m_fd = fd;
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    m_size = static_cast<uint64_t>(st.st_size);
+    m_open = true;
+
+    if (m_size < min_size) return resize(min_size);
+    if (!map()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::map() {
+    if (m_size == 0) return true;
+    void* view = mmap(nullptr, static_cast<size_t>(m_size), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, m_fd, 0);
+    if (view == MAP_FAILED) return false;
+    m_data = static_cast<uint8_t*>(view);
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (m_data) {
+        munmap(m_data, static_cast<size_t>(m_size));
+        m_data = nullptr;
+    }
+}
+
+void MappedFile::close() {
+    unmap();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_size = 0;
+    m_open = false;
+}
+
+bool MappedFile::resize(uint64_t new_size) {
+    if (!m_open) return false;
+    unmap();
+    if (ftruncate(m_fd, static_cast<off_t>(new_size)) != 0) {
+        close();
+        return false;
+    }
+    m_size = new_size;
+    if (!map()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::flush() {
+    if (!m_data) return m_open;
+    return msync(m_data, static_cast<size_t>(m_size), MS_SYNC) == 0 && fsync(m_fd) == 0;
+}
+
+bool file_exists(const std::string& utf8_path) {
+    struct stat st = {};
+    return stat(utf8_path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+bool replace_file(const std::string& src_utf8, const std::string& dst_utf8) {
+    return std::rename(src_utf8.c_str(), dst_utf8.c_str()) == 0;
+}
+
+bool remove_file(const std::string& utf8_path) {
+    return std::remove(utf8_path.c_str()) == 0;
+}
+
+#endif
+
+} // namespace nowbar
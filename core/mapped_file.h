@@ -0,0 +1,53 @@
+#pragma once
+// Platform-neutral memory-mapped file used by the on-disk caches.
+// Deliberately free of pch.h / SDK dependencies so the storage layers built
+// on top of it can be compiled and exercised outside foobar2000.
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace nowbar {
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Open (or create) the file read/write and map all of it.
+    // The file is grown to min_size first if it is smaller.
+    bool open(const std::string& utf8_path, uint64_t min_size = 0);
+    void close();
+
+    // Unmap, change the file length, and map again. Invalidates data().
+    bool resize(uint64_t new_size);
+
+    // Flush dirty pages of the mapping to disk.
+    bool flush();
+
+    bool is_open() const { return m_open; }
+    uint8_t* data() const { return m_data; }
+    uint64_t size() const { return m_size; }
+
+private:
+    bool map();
+    void unmap();
+
+    bool m_open = false;
+    uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;      // HANDLE
+    void* m_mapping = nullptr;   // HANDLE
+#else
+    int m_fd = -1;
+#endif
+};
+
+// File helpers used for atomic cache rebuilds (UTF-8 paths).
+bool file_exists(const std::string& utf8_path);
+bool replace_file(const std::string& src_utf8, const std::string& dst_utf8);
+bool remove_file(const std::string& utf8_path);
+
+} // namespace nowbar
@@ -0,0 +1,103 @@
+#include "stream_waveform.h"
+#include <algorithm>
+#include <cmath>
+
+namespace nowbar {
+
+namespace {
+
+// Slot boundaries are multiples of slot_seconds, which is rarely exact in
+// binary; the tolerance keeps a frame on a boundary in the later slot.
+constexpr double SLOT_EPSILON = 1e-9;
+
+} // anonymous namespace
+
+StreamWaveform::StreamWaveform(uint32_t slots, double slot_seconds)
+    : m_slots(std::max<uint32_t>(slots, 1)),
+      m_slot_seconds(slot_seconds > 0.0 ? slot_seconds : 0.1),
+      m_ring(m_slots + 1) {}
+
+void StreamWaveform::reset() {
+    std::fill(m_ring.begin(), m_ring.end(), WaveformSegmentStats());
+    m_head = 0;
+    m_started = false;
+    m_fed_until = -1.0;
+    m_version++;
+}
+
+// Move the write position forward to `slot`, completing the current slot
+// and clearing any skipped ones. A jump of a whole ring clears everything.
+void StreamWaveform::advance_to(uint64_t slot) {
+    if (slot <= m_head) return;
+    uint64_t steps = std::min<uint64_t>(slot - m_head, m_ring.size());
+    for (uint64_t k = slot - steps + 1; k <= slot; k++) m_ring[k % m_ring.size()] = WaveformSegmentStats();
+    m_head = slot;
+    m_version++;
+}
+
+template <typename Sample>
+void StreamWaveform::add_frames(const Sample* frames, size_t frame_count, unsigned channels,
+                                uint32_t sample_rate, double start_time) {
+    if (!frames || frame_count == 0 || channels == 0 || sample_rate == 0 || start_time < 0.0) return;
+
+    if (m_started) {
+        // A jump back further than the ring (seek, restarted stream) starts over
+        if (start_time + m_slots * m_slot_seconds < m_fed_until) reset();
+    }
+    if (m_started && start_time < m_fed_until) {
+        // Skip frames that were already consumed
+        double overlap = std::ceil((m_fed_until - start_time) * sample_rate - 1e-6);
+        if (overlap >= (double)frame_count) return;
+        size_t skip = (size_t)overlap;
+        frames += skip * channels;
+        frame_count -= skip;
+        start_time += (double)skip / sample_rate;
+    }
+
+    uint64_t first = (uint64_t)(start_time / m_slot_seconds + SLOT_EPSILON);
+    if (!m_started) {
+        m_head = first;
+        m_started = true;
+    }
+    advance_to(first);
+
+    size_t s = 0;
+    while (s < frame_count) {
+        double t = start_time + (double)s / sample_rate;
+        uint64_t slot = std::max(m_head, (uint64_t)(t / m_slot_seconds + SLOT_EPSILON));
+        advance_to(slot);
+
+        double boundary = (double)(slot + 1) * m_slot_seconds;
+        double frames_left = std::ceil((boundary - start_time) * sample_rate - 1e-6) - (double)s;
+        size_t run = frame_count - s;
+        if (frames_left < 1.0) frames_left = 1.0;
+        if (frames_left < (double)run) run = (size_t)frames_left;
+
+        waveform_reduce(frames + s * channels, run, channels, m_ring[slot % m_ring.size()]);
+        s += run;
+    }
+    m_fed_until = start_time + (double)frame_count / sample_rate;
+}
+
+void StreamWaveform::add(const float* frames, size_t frame_count, unsigned channels, uint32_t sample_rate,
+                         double start_time) {
+    add_frames(frames, frame_count, channels, sample_rate, start_time);
+}
+
+void StreamWaveform::add(const double* frames, size_t frame_count, unsigned channels, uint32_t sample_rate,
+                         double start_time) {
+    add_frames(frames, frame_count, channels, sample_rate, start_time);
+}
+
+void StreamWaveform::history(std::vector<WaveformSegmentStats>& out) const {
+    out.assign(m_slots, WaveformSegmentStats());
+    if (!m_started) return;
+    // Completed slots are m_head - m_slots .. m_head - 1
+    for (uint32_t i = 0; i < m_slots; i++) {
+        uint64_t back = m_slots - i;
+        if (back > m_head) continue;
+        out[i] = m_ring[(m_head - back) % m_ring.size()];
+    }
+}
+
+} // namespace nowbar
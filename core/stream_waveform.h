@@ -0,0 +1,59 @@
+#pragma once
+// Rolling waveform history for streams and tracks of unknown length.
+//
+// A fixed ring of time slots (by default 600 x 100 ms, the last minute) is
+// filled from live PCM as it plays, using the same reduction kernel as the
+// file decoder. Slots are addressed by absolute stream time, so chunks may
+// overlap or leave gaps: overlapping frames are skipped and skipped time
+// reads as silence. Each add() costs the frames passed in plus at most one
+// clear per slot advanced, never more than the ring size.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include "waveform_reduce.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nowbar {
+
+class StreamWaveform {
+public:
+    explicit StreamWaveform(uint32_t slots = 600, double slot_seconds = 0.1);
+
+    // Feed interleaved frames that start at start_time seconds of stream time.
+    void add(const float* frames, size_t frame_count, unsigned channels, uint32_t sample_rate, double start_time);
+    void add(const double* frames, size_t frame_count, unsigned channels, uint32_t sample_rate, double start_time);
+
+    // Stream time up to which audio has been consumed; negative before the
+    // first add(). The next chunk should start here.
+    double fed_until() const { return m_fed_until; }
+
+    // Bumped every time a slot completes, i.e. when history() changes.
+    uint64_t version() const { return m_version; }
+
+    uint32_t slot_count() const { return m_slots; }
+    double slot_seconds() const { return m_slot_seconds; }
+
+    // The completed slots, oldest first, resized to slot_count(). Slots
+    // before the first audio or inside a gap are empty.
+    void history(std::vector<WaveformSegmentStats>& out) const;
+
+    void reset();
+
+private:
+    template <typename Sample>
+    void add_frames(const Sample* frames, size_t frame_count, unsigned channels, uint32_t sample_rate,
+                    double start_time);
+    void advance_to(uint64_t slot);
+
+    uint32_t m_slots;
+    double m_slot_seconds;
+    std::vector<WaveformSegmentStats> m_ring;   // slot_count() + 1; slot k lives at k % size
+    uint64_t m_head = 0;                        // Slot currently being filled
+    bool m_started = false;
+    double m_fed_until = -1.0;
+    uint64_t m_version = 0;
+};
+
+} // namespace nowbar
@@ -0,0 +1,109 @@
+#include "task_slot.h"
+#include <thread>
+
+namespace nowbar {
+
+namespace {
+
+std::mutex g_running_mutex;
+std::condition_variable g_running_cv;
+int g_running = 0;
+
+} // anonymous namespace
+
+void TaskSlot::Task::cancel() {
+    m_cancelled.store(true, std::memory_order_relaxed);
+    std::call_once(m_cancel_once, [this]() {
+        if (m_on_cancel) m_on_cancel();
+    });
+}
+
+TaskSlot::TaskPtr TaskSlot::start(Body body, std::function<void()> on_cancel) {
+    TaskPtr task;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_current) m_current->cancel();
+    {
+        std::lock_guard<std::mutex> state_lock(m_state->mutex);
+        if (m_state->closed) return nullptr;
+        task.reset(new Task(m_state, ++m_state->generation, std::move(on_cancel)));
+        // A task still waiting for the worker was just cancelled; replace it
+        if (!m_state->next) {
+            // Counted while queued, so wait_all() never misses a task the
+            // worker has not taken yet
+            std::lock_guard<std::mutex> running_lock(g_running_mutex);
+            g_running++;
+        }
+        m_state->next = task;
+        m_state->next_body = std::move(body);
+        if (!m_state->worker) {
+            m_state->worker = true;
+            std::thread(run, m_state).detach();
+        }
+    }
+    m_state->cv.notify_one();
+    m_current = task;
+    return task;
+}
+
+void TaskSlot::run(std::shared_ptr<State> state) {
+    for (;;) {
+        TaskPtr task;
+        Body body;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cv.wait(lock, [&]() { return state->closed || state->next; });
+            if (!state->next) {
+                state->worker = false;
+                break;
+            }
+            task = std::move(state->next);
+            body = std::move(state->next_body);
+            state->next_body = nullptr;
+        }
+        // Superseded or cancelled between start() and now: never run it
+        if (!task->cancelled()) {
+            try {
+                body(task);
+            } catch (...) {
+            }
+        }
+        body = nullptr;  // Release captures before wait_all() can return
+        task.reset();
+        std::lock_guard<std::mutex> running_lock(g_running_mutex);
+        if (--g_running == 0) g_running_cv.notify_all();
+    }
+}
+
+void TaskSlot::cancel() {
+    TaskPtr current;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        current = std::move(m_current);
+    }
+    if (!current) return;
+    current->cancel();
+    // Bump the generation so a publish racing with the flag is rejected too.
+    std::lock_guard<std::mutex> state_lock(m_state->mutex);
+    m_state->generation++;
+}
+
+void TaskSlot::close() {
+    cancel();
+    {
+        std::lock_guard<std::mutex> state_lock(m_state->mutex);
+        m_state->closed = true;
+    }
+    m_state->cv.notify_one();
+}
+
+int TaskSlot::running_count() {
+    std::lock_guard<std::mutex> lock(g_running_mutex);
+    return g_running;
+}
+
+bool TaskSlot::wait_all(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(g_running_mutex);
+    return g_running_cv.wait_for(lock, timeout, []() { return g_running == 0; });
+}
+
+} // namespace nowbar
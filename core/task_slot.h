@@ -0,0 +1,106 @@
+#pragma once
+// Background job runner with supersede-on-start semantics.
+//
+// A TaskSlot owns at most one current task and one worker thread, started
+// on first use and kept until the slot is closed. Starting a new task, or
+// calling cancel(), never waits for the previous one: the old task is
+// flagged and its cancel hook runs (e.g. to abort blocking I/O). A task
+// that has not started yet is dropped, so a burst of starts coalesces to
+// the newest one; a running one finishes on the worker once it notices,
+// and anything it tries to publish afterwards is discarded because its
+// generation is no longer current.
+//
+// The worker is detached and owns the slot's shared state, so a task stuck
+// in I/O never blocks the slot's owner; it only delays the next task.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace nowbar {
+
+class TaskSlot {
+    struct State;
+
+public:
+    class Task {
+    public:
+        uint64_t generation() const { return m_generation; }
+        bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+        // Run fn under the slot lock if this task is still the current one.
+        // Returns false (without running fn) once the task was superseded,
+        // cancelled, or its owner closed the slot.
+        template <typename Fn>
+        bool publish(Fn&& fn) {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            if (m_state->closed || m_state->generation != m_generation || cancelled()) return false;
+            fn();
+            return true;
+        }
+
+    private:
+        friend class TaskSlot;
+        Task(std::shared_ptr<State> state, uint64_t generation, std::function<void()> on_cancel)
+            : m_state(std::move(state)), m_generation(generation), m_on_cancel(std::move(on_cancel)) {}
+        void cancel();
+
+        std::shared_ptr<State> m_state;
+        const uint64_t m_generation;
+        std::atomic<bool> m_cancelled{false};
+        std::function<void()> m_on_cancel;
+        std::once_flag m_cancel_once;
+    };
+    using TaskPtr = std::shared_ptr<Task>;
+    using Body = std::function<void(const TaskPtr&)>;
+
+    TaskSlot() : m_state(std::make_shared<State>()) {}
+    ~TaskSlot() { close(); }
+    TaskSlot(const TaskSlot&) = delete;
+    TaskSlot& operator=(const TaskSlot&) = delete;
+
+    // Supersede the current task and queue body for the slot's worker.
+    // on_cancel is invoked once if the task is cancelled or superseded,
+    // whether or not it started.
+    TaskPtr start(Body body, std::function<void()> on_cancel = nullptr);
+
+    // Cancel the current task without waiting for it.
+    void cancel();
+
+    // Cancel and refuse all further publishes. Only waits for a publish that
+    // is already running, never for the task body itself.
+    void close();
+
+    // Number of tasks queued or running, in any slot. A closed slot's
+    // worker exits once its current task returns.
+    static int running_count();
+
+    // Block until no task is queued or running in any slot, or the timeout
+    // passes. For component shutdown, after all slots were closed.
+    static bool wait_all(std::chrono::milliseconds timeout);
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cv;
+        uint64_t generation = 0;
+        bool closed = false;
+        bool worker = false;   // Worker thread started and not yet exited
+        TaskPtr next;          // Newest task not yet taken by the worker
+        Body next_body;
+    };
+
+    static void run(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> m_state;
+    TaskPtr m_current;
+    std::mutex m_mutex;  // Guards m_current
+};
+
+} // namespace nowbar
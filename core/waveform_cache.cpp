@@ -0,0 +1,589 @@
+#include "waveform_cache.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+namespace nowbar {
+
+namespace {
+
+constexpr char WAVECACHE_MAGIC[4] = {'N', 'W', 'W', 'C'};
+constexpr uint32_t WAVECACHE_VERSION = 6;
+constexpr uint32_t INITIAL_SLOT_COUNT = 1024;  // Both tables; must be a power of two
+constexpr uint64_t CHECK_BASIS = 0x84222325cbf29ce4ULL;
+constexpr uint32_t COMPACT_INTERVAL_DAYS = 7;
+constexpr uint32_t STALE_AFTER_DAYS = 365;     // Entries not shown for a year are dropped
+constexpr uint64_t PAYLOAD_ALIGN = 8;          // Payload offsets are stored in these units
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t slot_size;       // sizeof(SlotHeader)
+    uint32_t slot_count;      // Power of two
+    uint32_t used_count;
+    uint32_t segment_count;   // Most segments a record may hold
+    uint8_t encoding;         // PeakEncoding of the payloads
+    uint8_t dirty;            // Set while mapped; still set on open means we crashed
+    uint8_t reserved0[2];
+    uint32_t compacted_day;   // Day number of the last compaction
+    uint32_t alias_count;     // Power of two
+    uint32_t alias_used;
+    uint32_t reserved1;
+    uint64_t data_end;        // Bytes of the data area holding payloads
+    uint64_t garbage_bytes;   // Payloads no slot refers to any more
+};
+static_assert(sizeof(FileHeader) == 64, "wavecache header must stay 64 bytes");
+
+// Path records: the index slot holds the key, the file stats and content
+// fingerprint seen when the level was stored, and where its payload lies in
+// the data area. The payload is WaveformLevel::PLANES planes of peak_count
+// encoded values (RMS, positive peak, negative peak). key_hash == 0 marks an
+// empty slot; it is written last on insert. The checksum covers everything
+// but the key hash and access day, including the payload, so a record torn
+// by a crash reads as a miss and is dropped by compaction.
+struct SlotHeader {
+    uint64_t key_hash;
+    uint64_t key_check;
+    uint64_t file_size;       // 0 = unknown
+    uint64_t file_time;       // 0 = unknown
+    uint64_t fingerprint;     // 0 = none
+    uint32_t data_offset;     // In PAYLOAD_ALIGN units from the start of the data area
+    uint32_t peak_count;      // Segments per plane
+    uint32_t checksum;
+    uint32_t used_day;        // Day number of the last store or lookup hit
+    float rms_scale;          // WaveformLevel::rms_scale
+    float loudness;           // WaveformLevel::loudness (0 = not measured)
+};
+static_assert(sizeof(SlotHeader) == 64, "wavecache slot header must stay 64 bytes");
+
+// Fingerprint aliases live in a table of their own and only name the path
+// record's key. A torn alias is harmless: the path record it leads to must
+// still carry the same fingerprint and size.
+struct AliasSlot {
+    uint64_t key_hash;        // 0 = empty
+    uint64_t key_check;
+    uint64_t target_hash;
+    uint64_t target_check;
+};
+static_assert(sizeof(AliasSlot) == 32, "wavecache alias slot must stay 32 bytes");
+
+// Everything a path record carries besides its key and payload.
+struct RecordMeta {
+    uint64_t file_size = 0;
+    uint64_t file_time = 0;
+    uint64_t fingerprint = 0;
+    uint32_t used_day = 0;
+};
+
+FileHeader* header_of(const MappedFile& file) {
+    return reinterpret_cast<FileHeader*>(file.data());
+}
+
+uint32_t current_day() {
+    return static_cast<uint32_t>(std::time(nullptr) / 86400);
+}
+
+uint64_t data_start(const FileHeader* hdr) {
+    return sizeof(FileHeader) + static_cast<uint64_t>(hdr->slot_count) * sizeof(SlotHeader) +
+           static_cast<uint64_t>(hdr->alias_count) * sizeof(AliasSlot);
+}
+
+uint64_t payload_size(uint32_t peak_count, PeakEncoding enc) {
+    return WaveformLevel::PLANES * static_cast<uint64_t>(peak_count) * peak_encoding_size(enc);
+}
+
+uint64_t aligned(uint64_t bytes) {
+    return (bytes + PAYLOAD_ALIGN - 1) & ~(PAYLOAD_ALIGN - 1);
+}
+
+SlotHeader* slot_at(const uint8_t* base, uint32_t index) {
+    return reinterpret_cast<SlotHeader*>(const_cast<uint8_t*>(base) + sizeof(FileHeader)) + index;
+}
+
+AliasSlot* alias_at(const uint8_t* base, uint32_t index) {
+    const FileHeader* hdr = reinterpret_cast<const FileHeader*>(base);
+    return reinterpret_cast<AliasSlot*>(const_cast<uint8_t*>(base) + sizeof(FileHeader) +
+                                        static_cast<uint64_t>(hdr->slot_count) * sizeof(SlotHeader)) +
+           index;
+}
+
+uint8_t* payload_of(const uint8_t* base, const SlotHeader* sh) {
+    const FileHeader* hdr = reinterpret_cast<const FileHeader*>(base);
+    return const_cast<uint8_t*>(base) + data_start(hdr) + static_cast<uint64_t>(sh->data_offset) * PAYLOAD_ALIGN;
+}
+
+void hash_key(const std::string& key, uint64_t& hash, uint64_t& check) {
+    hash = waveform_key_hash(key.data(), key.size());
+    check = waveform_key_hash(key.data(), key.size(), CHECK_BASIS);
+    if (hash == 0) hash = 1;  // 0 is reserved for empty slots
+}
+
+// Alias keys start with a byte no path can begin with.
+std::string alias_key(uint64_t fingerprint, uint64_t file_size) {
+    std::string key(1 + 2 * sizeof(uint64_t), '\x01');
+    memcpy(&key[1], &fingerprint, sizeof(fingerprint));
+    memcpy(&key[1 + sizeof(fingerprint)], &file_size, sizeof(file_size));
+    return key;
+}
+
+uint32_t record_checksum(const SlotHeader* sh, const uint8_t* payload, size_t payload_bytes) {
+    uint64_t h = waveform_key_hash(&sh->key_check, sizeof(sh->key_check));
+    h = waveform_key_hash(&sh->file_size, sizeof(uint64_t) * 3, h);      // size, time, fingerprint
+    h = waveform_key_hash(&sh->data_offset, sizeof(uint32_t) * 2, h);    // data_offset, peak_count
+    h = waveform_key_hash(&sh->rms_scale, sizeof(float) * 2, h);         // rms_scale, loudness
+    h = waveform_key_hash(payload, payload_bytes, h);
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// True if the record's payload lies within the data area and within the
+// first available bytes of the image, and the checksum matches.
+bool slot_valid(const uint8_t* base, uint64_t available, const SlotHeader* sh) {
+    const FileHeader* hdr = reinterpret_cast<const FileHeader*>(base);
+    if (sh->peak_count == 0 || sh->peak_count > hdr->segment_count) return false;
+    uint64_t bytes = payload_size(sh->peak_count, static_cast<PeakEncoding>(hdr->encoding));
+    uint64_t offset = static_cast<uint64_t>(sh->data_offset) * PAYLOAD_ALIGN;
+    if (offset + bytes > hdr->data_end || data_start(hdr) + offset + bytes > available) return false;
+    return sh->checksum == record_checksum(sh, payload_of(base, sh), static_cast<size_t>(bytes));
+}
+
+// Linear probe for key in a table of count slots (power of two); returns
+// the matching slot (found=true) or the first empty slot (found=false).
+// nullptr only if the table is completely full.
+template <typename Slot>
+Slot* probe(Slot* table, uint32_t count, uint64_t hash, uint64_t check, bool& found) {
+    found = false;
+    uint32_t mask = count - 1;
+    uint32_t idx = static_cast<uint32_t>(hash) & mask;
+    for (uint32_t n = 0; n < count; n++) {
+        Slot* slot = table + idx;
+        if (slot->key_hash == 0) return slot;
+        if (slot->key_hash == hash && slot->key_check == check) {
+            found = true;
+            return slot;
+        }
+        idx = (idx + 1) & mask;
+    }
+    return nullptr;
+}
+
+SlotHeader* probe_path(const MappedFile& file, uint64_t hash, uint64_t check, bool& found) {
+    return probe(slot_at(file.data(), 0), header_of(file)->slot_count, hash, check, found);
+}
+
+AliasSlot* probe_alias(const MappedFile& file, uint64_t hash, uint64_t check, bool& found) {
+    return probe(alias_at(file.data(), 0), header_of(file)->alias_count, hash, check, found);
+}
+
+// Append a level for key to the data area, re-encoding it to the file's
+// encoding, and point the key's slot at it. The caller makes sure the slot
+// table has room and the file is large enough. The payload is written
+// first and the slot published last, so a crash leaves either the old
+// record or a torn one that fails its checksum.
+bool insert_level(MappedFile& file, uint64_t hash, uint64_t check, const RecordMeta& meta,
+                  const WaveformLevel& level) {
+    FileHeader* hdr = header_of(file);
+    PeakEncoding enc = static_cast<PeakEncoding>(hdr->encoding);
+    uint64_t bytes = payload_size(static_cast<uint32_t>(level.size()), enc);
+    if (level.empty() || level.size() > hdr->segment_count) return false;
+    if (hdr->data_end / PAYLOAD_ALIGN > UINT32_MAX) return false;
+    if (data_start(hdr) + hdr->data_end + aligned(bytes) > file.size()) return false;
+    bool found = false;
+    SlotHeader* sh = probe_path(file, hash, check, found);
+    if (!sh) return false;
+
+    WaveformPeaks packed = level.converted(enc).packed();
+    uint8_t* payload = file.data() + data_start(hdr) + hdr->data_end;
+    memcpy(payload, packed.bytes(), static_cast<size_t>(bytes));
+    memset(payload + bytes, 0, static_cast<size_t>(aligned(bytes) - bytes));
+    if (found) hdr->garbage_bytes += aligned(payload_size(sh->peak_count, enc));
+
+    sh->key_check = check;
+    sh->file_size = meta.file_size;
+    sh->file_time = meta.file_time;
+    sh->fingerprint = meta.fingerprint;
+    sh->data_offset = static_cast<uint32_t>(hdr->data_end / PAYLOAD_ALIGN);
+    sh->peak_count = static_cast<uint32_t>(level.size());
+    sh->used_day = meta.used_day;
+    sh->rms_scale = level.rms_scale;
+    sh->loudness = level.loudness;
+    sh->checksum = record_checksum(sh, payload, static_cast<size_t>(bytes));
+    hdr->data_end += aligned(bytes);
+    sh->key_hash = hash;  // Publish last
+    if (!found) hdr->used_count++;
+    return true;
+}
+
+bool insert_alias(MappedFile& file, uint64_t hash, uint64_t check, uint64_t target_hash, uint64_t target_check) {
+    FileHeader* hdr = header_of(file);
+    bool found = false;
+    AliasSlot* alias = probe_alias(file, hash, check, found);
+    if (!alias) return false;
+    alias->key_check = check;
+    alias->target_hash = target_hash;
+    alias->target_check = target_check;
+    alias->key_hash = hash;  // Publish last
+    if (!found) hdr->alias_used++;
+    return true;
+}
+
+WaveformLevel read_level(const uint8_t* base, const SlotHeader* sh) {
+    const FileHeader* hdr = reinterpret_cast<const FileHeader*>(base);
+    WaveformLevel level = WaveformLevel::unpacked(payload_of(base, sh), sh->peak_count,
+                                                  static_cast<PeakEncoding>(hdr->encoding), sh->rms_scale);
+    level.loudness = sh->loudness;
+    return level;
+}
+
+bool power_of_two(uint32_t v) { return v != 0 && (v & (v - 1)) == 0; }
+
+// Header fields that must hold before any slot of src can be trusted.
+// Only current-version tables qualify: older ones hold a fixed-size record
+// per entry (and before that RMS values alone) and are started over.
+bool layout_valid(const uint8_t* src, uint64_t src_size, uint32_t segment_count) {
+    if (src_size < sizeof(FileHeader)) return false;
+    const FileHeader* hdr = reinterpret_cast<const FileHeader*>(src);
+    if (memcmp(hdr->magic, WAVECACHE_MAGIC, 4) != 0) return false;
+    if (hdr->version != WAVECACHE_VERSION || hdr->header_size != sizeof(FileHeader)) return false;
+    if (hdr->slot_size != sizeof(SlotHeader)) return false;
+    if (hdr->encoding != static_cast<uint8_t>(PeakEncoding::U8) &&
+        hdr->encoding != static_cast<uint8_t>(PeakEncoding::U16)) {
+        return false;
+    }
+    if (hdr->segment_count != segment_count) return false;
+    return power_of_two(hdr->slot_count) && power_of_two(hdr->alias_count);
+}
+
+// Smallest power-of-two table that keeps entries at or under half load.
+uint32_t slot_count_for(uint32_t entries) {
+    uint32_t slots = INITIAL_SLOT_COUNT;
+    while (slots < (1u << 30) && entries * 2 > slots) slots *= 2;
+    return slots;
+}
+
+// File bytes ahead of the data area once a rebuild sizes both tables for
+// entries records.
+uint64_t index_bytes(uint32_t entries) {
+    uint64_t slots = slot_count_for(entries + 1);
+    return sizeof(FileHeader) + slots * (sizeof(SlotHeader) + sizeof(AliasSlot));
+}
+
+// Mark a record as used today. Only dirties the page when the day changes,
+// so repeat hits stay read-only.
+void touch_slot(SlotHeader* sh, uint32_t today) {
+    if (sh->used_day != today) sh->used_day = today;
+}
+
+} // anonymous namespace
+
+uint64_t waveform_key_hash(const void* data, size_t len, uint64_t basis) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = basis;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+bool WaveformCacheFile::init_empty(MappedFile& file, uint32_t slot_count, uint32_t alias_count, uint64_t data_bytes) {
+    FileHeader fresh = {};
+    memcpy(fresh.magic, WAVECACHE_MAGIC, 4);
+    fresh.version = WAVECACHE_VERSION;
+    fresh.header_size = sizeof(FileHeader);
+    fresh.slot_size = sizeof(SlotHeader);
+    fresh.slot_count = slot_count;
+    fresh.segment_count = m_segment_count;
+    fresh.encoding = static_cast<uint8_t>(m_encoding);
+    fresh.compacted_day = current_day();
+    fresh.alias_count = alias_count;
+    if (!file.resize(0) || !file.resize(data_start(&fresh) + data_bytes)) return false;  // Zero-filled
+    memcpy(file.data(), &fresh, sizeof(fresh));
+    return true;
+}
+
+// True if the mapped file is a complete current-version table in our
+// encoding that can be used in place.
+bool WaveformCacheFile::header_valid(const MappedFile& file) const {
+    if (!layout_valid(file.data(), file.size(), m_segment_count)) return false;
+    const FileHeader* hdr = header_of(file);
+    if (hdr->encoding != static_cast<uint8_t>(m_encoding)) return false;
+    return hdr->used_count <= hdr->slot_count && hdr->alias_used <= hdr->alias_count &&
+           data_start(hdr) + hdr->data_end <= file.size();
+}
+
+// After a crash: verify every record and recount. Returns false if any
+// record is torn, in which case the caller rebuilds without it.
+bool WaveformCacheFile::verify_in_place() {
+    FileHeader* hdr = header_of(m_file);
+    uint32_t used = 0, aliases = 0;
+    for (uint32_t s = 0; s < hdr->slot_count; s++) {
+        const SlotHeader* sh = slot_at(m_file.data(), s);
+        if (sh->key_hash == 0) continue;
+        if (!slot_valid(m_file.data(), m_file.size(), sh)) return false;
+        used++;
+    }
+    for (uint32_t a = 0; a < hdr->alias_count; a++) {
+        if (alias_at(m_file.data(), a)->key_hash != 0) aliases++;
+    }
+    hdr->used_count = used;
+    hdr->alias_used = aliases;
+    return true;
+}
+
+bool WaveformCacheFile::open(const std::string& utf8_path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file.close();
+    m_path = utf8_path;
+
+    if (!m_file.open(utf8_path)) return false;
+    if (header_valid(m_file)) {
+        FileHeader* hdr = header_of(m_file);
+        if (!hdr->dirty || verify_in_place()) {
+            hdr->dirty = 1;
+            return true;
+        }
+    }
+
+    // Other encoding, torn records, or a truncated file: salvage every
+    // intact record into a fresh table.
+    if (layout_valid(m_file.data(), m_file.size(), m_segment_count)) {
+        if (rebuild(0, 0, data_budget())) return true;
+        if (!m_file.is_open() && !m_file.open(utf8_path)) return false;
+    }
+
+    // Missing, empty, foreign, older or unsalvageable: start over with an empty table.
+    if (!init_empty(m_file, INITIAL_SLOT_COUNT, INITIAL_SLOT_COUNT, 0)) return false;
+    header_of(m_file)->dirty = 1;
+    return true;
+}
+
+// How large a rebuild may make the file: three quarters of the size cap, so
+// it does not hit the cap again right away.
+uint64_t WaveformCacheFile::data_budget() const {
+    return m_capacity == UINT64_MAX ? UINT64_MAX : m_capacity / 4 * 3;
+}
+
+bool WaveformCacheFile::rebuild(uint32_t stale_day, uint64_t reserve, uint64_t max_bytes) {
+    // Collect the intact records that are still in use. Only slots and
+    // payloads lying entirely within the file are read, so a truncated file
+    // yields everything before the cut.
+    const uint8_t* src = m_file.data();
+    const uint64_t src_size = m_file.size();
+    const FileHeader* src_hdr = header_of(m_file);
+    uint64_t table_end = sizeof(FileHeader) + static_cast<uint64_t>(src_hdr->slot_count) * sizeof(SlotHeader);
+    uint32_t slots = static_cast<uint32_t>(std::min<uint64_t>(
+        src_hdr->slot_count, src_size > sizeof(FileHeader) ? (src_size - sizeof(FileHeader)) / sizeof(SlotHeader) : 0));
+    struct Live {
+        const SlotHeader* slot;
+        uint64_t bytes;
+    };
+    std::vector<Live> live;
+    uint64_t live_bytes = 0;
+    for (uint32_t s = 0; s < slots; s++) {
+        const SlotHeader* sh = slot_at(src, s);
+        if (sh->key_hash == 0 || sh->used_day < stale_day || !slot_valid(src, src_size, sh)) continue;
+        live.push_back({sh, aligned(payload_size(sh->peak_count, m_encoding))});
+        live_bytes += live.back().bytes;
+    }
+
+    // Over the size limit: keep the most recently used records that fit
+    if (index_bytes(static_cast<uint32_t>(live.size())) + live_bytes + reserve > max_bytes) {
+        std::stable_sort(live.begin(), live.end(),
+                         [](const Live& a, const Live& b) { return a.slot->used_day > b.slot->used_day; });
+        live_bytes = 0;
+        size_t keep = 0;
+        while (keep < live.size() &&
+               index_bytes(static_cast<uint32_t>(keep + 1)) + live_bytes + live[keep].bytes + reserve <= max_bytes) {
+            live_bytes += live[keep++].bytes;
+        }
+        live.resize(keep);
+    }
+    uint32_t fingerprinted = 0;
+    for (const Live& record : live) {
+        if (record.slot->fingerprint != 0) fingerprinted++;
+    }
+
+    // Rebuild into a temp file and swap it in, so a crash mid-rebuild leaves
+    // the previous table intact.
+    std::string tmp_path = m_path + ".tmp";
+    MappedFile dst;
+    if (!dst.open(tmp_path) || !init_empty(dst, slot_count_for(static_cast<uint32_t>(live.size()) + 1),
+                                           slot_count_for(fingerprinted + 1), live_bytes + reserve)) {
+        return false;
+    }
+    for (const Live& record : live) {
+        const SlotHeader* sh = record.slot;
+        RecordMeta meta;
+        meta.file_size = sh->file_size;
+        meta.file_time = sh->file_time;
+        meta.fingerprint = sh->fingerprint;
+        meta.used_day = sh->used_day;
+        // Payloads are re-encoded into the table's encoding
+        WaveformLevel level = WaveformLevel::unpacked(payload_of(src, sh), sh->peak_count,
+                                                      static_cast<PeakEncoding>(src_hdr->encoding), sh->rms_scale);
+        level.loudness = sh->loudness;
+        insert_level(dst, sh->key_hash, sh->key_check, meta, level);
+    }
+
+    // Keep the aliases that lead to a record that made it and still carries
+    // the fingerprint they were made for; that is at most one per record.
+    uint32_t alias_slots = 0;
+    if (src_size > table_end) {
+        alias_slots = static_cast<uint32_t>(
+            std::min<uint64_t>(src_hdr->alias_count, (src_size - table_end) / sizeof(AliasSlot)));
+    }
+    for (uint32_t a = 0; a < alias_slots; a++) {
+        const AliasSlot* alias = alias_at(src, a);
+        if (alias->key_hash == 0) continue;
+        bool found = false;
+        const SlotHeader* target = probe_path(dst, alias->target_hash, alias->target_check, found);
+        if (!found || target->fingerprint == 0) continue;
+        uint64_t hash, check;
+        hash_key(alias_key(target->fingerprint, target->file_size), hash, check);
+        if (hash == alias->key_hash && check == alias->key_check) {
+            insert_alias(dst, hash, check, alias->target_hash, alias->target_check);
+        }
+    }
+    header_of(dst)->dirty = 1;
+    dst.flush();
+    dst.close();
+
+    m_file.close();
+    if (!replace_file(tmp_path, m_path)) remove_file(tmp_path);
+    return m_file.open(m_path) && header_valid(m_file);
+}
+
+void WaveformCacheFile::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file.data()) {
+        header_of(m_file)->dirty = 0;
+        m_file.flush();
+    }
+    m_file.close();
+}
+
+bool WaveformCacheFile::is_open() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file.is_open() && m_file.data() != nullptr;
+}
+
+bool WaveformCacheFile::lookup(const WaveformSourceId& id, WaveformLevel& out_level) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.data()) return false;
+
+    uint64_t hash, check;
+    hash_key(waveform_location_key(id), hash, check);
+    bool found = false;
+    SlotHeader* sh = probe_path(m_file, hash, check, found);
+    if (!found || !slot_valid(m_file.data(), m_file.size(), sh)) return false;
+
+    // Different stats mean the file was edited or replaced since the
+    // waveform was stored; the next store() overwrites this record.
+    if (!waveform_stats_match(sh->file_size, sh->file_time, id.file_size, id.file_time)) return false;
+
+    // Records stored while the file's stats were unknown have none; adopt the current ones.
+    if (sh->file_size == 0 && sh->file_time == 0 && (id.file_size != 0 || id.file_time != 0)) {
+        sh->file_size = id.file_size;
+        sh->file_time = id.file_time;
+        sh->checksum = record_checksum(sh, payload_of(m_file.data(), sh),
+                                       static_cast<size_t>(payload_size(sh->peak_count, m_encoding)));
+    }
+
+    touch_slot(sh, current_day());
+    out_level = read_level(m_file.data(), sh);
+    return true;
+}
+
+bool WaveformCacheFile::lookup_fingerprint(uint64_t fingerprint, uint64_t file_size, WaveformLevel& out_level) {
+    if (fingerprint == 0) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.data()) return false;
+
+    uint64_t hash, check;
+    hash_key(alias_key(fingerprint, file_size), hash, check);
+    bool found = false;
+    const AliasSlot* alias = probe_alias(m_file, hash, check, found);
+    if (!found) return false;
+
+    // The alias only names a path record; confirm it still holds this content.
+    SlotHeader* sh = probe_path(m_file, alias->target_hash, alias->target_check, found);
+    if (!found || !slot_valid(m_file.data(), m_file.size(), sh)) return false;
+    if (sh->fingerprint != fingerprint || sh->file_size != file_size) return false;
+
+    touch_slot(sh, current_day());
+    out_level = read_level(m_file.data(), sh);
+    return true;
+}
+
+bool WaveformCacheFile::store(const WaveformSourceId& id, uint64_t fingerprint, const WaveformLevel& level) {
+    if (level.empty() || level.size() > m_segment_count) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.data()) return false;
+
+    // Keep both tables under 75% load so probe chains stay short, and the
+    // file under its size cap; either rebuilds it.
+    uint64_t bytes = aligned(payload_size(static_cast<uint32_t>(level.size()), m_encoding));
+    const FileHeader* hdr = header_of(m_file);
+    bool tables_full = (hdr->used_count + 1) * 4 > hdr->slot_count * 3 ||
+                       (hdr->alias_used + 1) * 4 > hdr->alias_count * 3;
+    bool over_cap = data_start(hdr) + hdr->data_end + bytes > m_capacity;
+    if (over_cap && index_bytes(0) + bytes > m_capacity) return false;  // Could never fit
+    if (tables_full || over_cap) {
+        if (!rebuild(0, bytes, over_cap ? data_budget() : UINT64_MAX)) return false;
+        hdr = header_of(m_file);
+    }
+
+    // Grow the data area by half again, so appends stay amortized
+    uint64_t needed = data_start(hdr) + hdr->data_end + bytes;
+    if (needed > m_file.size()) {
+        uint64_t grown = std::max(needed, std::min(needed + (needed - data_start(hdr)) / 2, m_capacity));
+        if (!m_file.resize(grown)) return false;
+    }
+
+    RecordMeta meta;
+    meta.file_size = id.file_size;
+    meta.file_time = id.file_time;
+    meta.fingerprint = fingerprint;
+    meta.used_day = current_day();
+    uint64_t hash, check;
+    hash_key(waveform_location_key(id), hash, check);
+    if (!insert_level(m_file, hash, check, meta, level)) return false;
+
+    if (fingerprint == 0) return true;
+    uint64_t alias_hash, alias_check;
+    hash_key(alias_key(fingerprint, id.file_size), alias_hash, alias_check);
+    insert_alias(m_file, alias_hash, alias_check, hash, check);
+    return true;
+}
+
+bool WaveformCacheFile::needs_compaction() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.data()) return false;
+    const FileHeader* hdr = header_of(m_file);
+    bool overdue = current_day() >= hdr->compacted_day + COMPACT_INTERVAL_DAYS;
+    bool oversized = hdr->slot_count > slot_count_for(hdr->used_count) * 2 ||
+                     hdr->alias_count > slot_count_for(hdr->alias_used) * 2;
+    bool wasteful = hdr->garbage_bytes > hdr->data_end / 4;
+    return overdue || oversized || wasteful;
+}
+
+bool WaveformCacheFile::compact() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.data()) return false;
+    uint32_t today = current_day();
+    return rebuild(today > STALE_AFTER_DAYS ? today - STALE_AFTER_DAYS : 0, 0, data_budget());
+}
+
+uint32_t WaveformCacheFile::entry_count() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.data()) return 0;
+    return header_of(m_file)->used_count;
+}
+
+uint64_t WaveformCacheFile::file_bytes() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file.data() ? m_file.size() : 0;
+}
+
+} // namespace nowbar
@@ -0,0 +1,101 @@
+#pragma once
+// On-disk waveform cache (wavecache.db).
+//
+// Version 6 layout: a 64-byte header, an open-addressing hash table of
+// 64-byte index slots keyed by path, a second table of 32-byte fingerprint
+// aliases, and a data area holding the payloads. A record stores one
+// pyramid level (RMS plus peak envelope) of any resolution up to the
+// table's segment count, so its size follows the detail the display needs
+// rather than the finest level the decoder measures. The whole file is
+// memory-mapped and queried in place, so nothing is read until a lookup
+// actually touches a slot. Payloads are appended; overwritten ones become
+// garbage until the next rebuild. Resizes, compaction and the size cap
+// write a temp file and swap it in, keeping the most recently used records.
+//
+// A header flag records whether the file was closed cleanly. After a crash
+// every record is verified; torn records and anything lost to truncation
+// are dropped while all intact records are salvaged. Tables stored in a
+// different PeakEncoding are converted on open. Older versions hold one
+// fixed-size record per entry (or RMS values only) and are started over.
+//
+// Records are keyed by path and subsong and remember the file stats they
+// were computed from (see waveform_key.h); a fingerprint alias per entry
+// lets a moved file be found by content.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include "lru_byte_cache.h"
+#include "mapped_file.h"
+#include "waveform_key.h"
+#include "waveform_peaks.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace nowbar {
+
+class WaveformCacheFile {
+public:
+    // segment_count is the most segments a stored level may have. The file
+    // is kept under capacity_bytes; a smaller cap applies at the next store().
+    WaveformCacheFile(uint32_t segment_count, PeakEncoding encoding, uint64_t capacity_bytes = UINT64_MAX)
+        : m_segment_count(segment_count), m_encoding(encoding), m_capacity(capacity_bytes) {}
+    ~WaveformCacheFile() { close(); }
+
+    // Map the cache file, creating or converting it as needed.
+    bool open(const std::string& utf8_path);
+    void close();
+    bool is_open();
+
+    // Copy the level stored for id's location into out_level. A record whose file
+    // stats differ from id's is stale and reported as a miss.
+    bool lookup(const WaveformSourceId& id, WaveformLevel& out_level);
+
+    // Secondary lookup by content, for files that were moved or renamed.
+    bool lookup_fingerprint(uint64_t fingerprint, uint64_t file_size, WaveformLevel& out_level);
+
+    // Insert or overwrite the level for id, re-encoding it if needed, and
+    // index it by fingerprint unless it is 0. level.size() may be anything
+    // from 1 to the segment count the cache was created with.
+    bool store(const WaveformSourceId& id, uint64_t fingerprint, const WaveformLevel& level);
+
+    // Compaction drops torn records, overwritten payloads and entries unused
+    // for a year, and shrinks oversized tables. Meant to run off the UI thread.
+    bool needs_compaction();
+    bool compact();
+
+    // Waveforms stored; aliases are not counted.
+    uint32_t entry_count();
+    uint64_t file_bytes();
+
+private:
+    bool init_empty(MappedFile& file, uint32_t slot_count, uint32_t alias_count, uint64_t data_bytes);
+    bool header_valid(const MappedFile& file) const;
+    bool verify_in_place();
+    uint64_t data_budget() const;
+    // Copy the intact records used since stale_day into a fresh file with
+    // reserve bytes of room, and swap it in. If that would exceed max_bytes,
+    // only the most recently used records that fit are kept.
+    bool rebuild(uint32_t stale_day, uint64_t reserve, uint64_t max_bytes);
+
+    const uint32_t m_segment_count;
+    const PeakEncoding m_encoding;
+    uint64_t m_capacity;
+    std::string m_path;
+    MappedFile m_file;
+    std::mutex m_mutex;
+};
+
+struct WaveformLevelBytes {
+    size_t operator()(const WaveformLevel& level) const { return level.byte_size(); }
+};
+
+// Process-wide in-memory waveform cache in front of wavecache.db.
+using WaveformMemoryCache = LruByteCache<WaveformLevel, WaveformLevelBytes>;
+
+// 64-bit FNV-1a with a selectable offset basis; two different bases give the
+// slot hash and an independent check value used to reject collisions.
+uint64_t waveform_key_hash(const void* data, size_t len, uint64_t basis = 0xcbf29ce484222325ULL);
+
+} // namespace nowbar
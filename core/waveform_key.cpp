@@ -0,0 +1,42 @@
+#include "waveform_key.h"
+#include "waveform_cache.h"
+
+namespace nowbar {
+
+bool waveform_stats_match(uint64_t stored_size, uint64_t stored_time,
+                          uint64_t size, uint64_t time) {
+    bool stored_known = stored_size != 0 || stored_time != 0;
+    bool known = size != 0 || time != 0;
+    if (!stored_known || !known) return true;
+    return stored_size == size && stored_time == time;
+}
+
+// Paths never contain a newline, so the suffixes below cannot collide.
+std::string waveform_location_key(const WaveformSourceId& id) {
+    if (id.subsong == 0) return id.path;
+    std::string key = id.path;
+    key += "\n#";
+    key += std::to_string(id.subsong);
+    return key;
+}
+
+std::string waveform_memory_key(const WaveformSourceId& id) {
+    std::string key = waveform_location_key(id);
+    key += '\n';
+    key += std::to_string(id.file_size);
+    key += ':';
+    key += std::to_string(id.file_time);
+    return key;
+}
+
+uint64_t waveform_content_fingerprint(uint64_t file_size, uint32_t subsong,
+                                      const void* head, size_t head_len,
+                                      const void* tail, size_t tail_len) {
+    uint64_t h = waveform_key_hash(&file_size, sizeof(file_size));
+    h = waveform_key_hash(&subsong, sizeof(subsong), h);
+    h = waveform_key_hash(head, head_len, h);
+    h = waveform_key_hash(tail, tail_len, h);
+    return h ? h : 1;
+}
+
+} // namespace nowbar
@@ -0,0 +1,48 @@
+#pragma once
+// Identity of a waveform cache entry.
+//
+// Entries are keyed by location (path plus subsong, so each track of a CUE
+// image or multi-track container has its own entry) and tagged with the
+// file size and timestamp foobar2000 reports, so an edited or re-encoded
+// file misses instead of serving a stale waveform. A fingerprint of the
+// file's head and tail lets a moved or renamed file find its old entry
+// again.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so the keying rules
+// can be built and exercised outside foobar2000.
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace nowbar {
+
+// Bytes hashed from each end of the file for the content fingerprint.
+constexpr size_t WAVEFORM_FINGERPRINT_SPAN = 64 * 1024;
+
+struct WaveformSourceId {
+    std::string path;
+    uint32_t subsong = 0;
+    uint64_t file_size = 0;  // 0 = unknown
+    uint64_t file_time = 0;  // Filesystem timestamp, 0 = unknown
+};
+
+// Stats match if they are equal, or if either side does not know them
+// (entries written before stats were recorded, or files without stats).
+bool waveform_stats_match(uint64_t stored_size, uint64_t stored_time,
+                          uint64_t size, uint64_t time);
+
+// Key for the on-disk record: the path alone for subsong 0 (matching entries
+// written before subsongs were tracked), otherwise path plus subsong.
+std::string waveform_location_key(const WaveformSourceId& id);
+
+// Key for the in-memory cache: a stats change produces a different key.
+std::string waveform_memory_key(const WaveformSourceId& id);
+
+// Fingerprint of file_size plus up to WAVEFORM_FINGERPRINT_SPAN bytes from
+// the start and the end of the file, mixed with the subsong so tracks of
+// one image stay distinct. Never returns 0 (reserved for "none").
+uint64_t waveform_content_fingerprint(uint64_t file_size, uint32_t subsong,
+                                      const void* head, size_t head_len,
+                                      const void* tail, size_t tail_len);
+
+} // namespace nowbar
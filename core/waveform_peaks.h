@@ -0,0 +1,146 @@
+#pragma once
+// Quantized waveform peak storage shared by the renderer and wavecache.db.
+//
+// Peaks are normalized to 0..1 with the 0.65 perceptual power curve already
+// applied before quantization, so decoding is a single multiply. U8 keeps the
+// worst-case error at 1/510 of the bar height (0.2 px on a 100 px bar).
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace nowbar {
+
+// Values are stored in wavecache.db headers. 0 was unquantized floats,
+// only ever written by the v2 format that is no longer read.
+enum class PeakEncoding : uint8_t {
+    U8 = 1,
+    U16 = 2,
+};
+
+inline size_t peak_encoding_size(PeakEncoding enc) {
+    return enc == PeakEncoding::U16 ? 2 : 1;
+}
+
+class WaveformPeaks {
+public:
+    WaveformPeaks() = default;
+    WaveformPeaks(PeakEncoding enc, size_t count)
+        : m_encoding(enc), m_count(count), m_bytes(count * peak_encoding_size(enc), 0) {}
+
+    static WaveformPeaks from_floats(const float* values, size_t count, PeakEncoding enc) {
+        WaveformPeaks out(enc, count);
+        for (size_t i = 0; i < count; i++) out.set(i, values[i]);
+        return out;
+    }
+
+    // Wrap already-encoded bytes (e.g. a wavecache.db record).
+    static WaveformPeaks from_encoded(const uint8_t* bytes, size_t count, PeakEncoding enc) {
+        WaveformPeaks out(enc, count);
+        if (count) memcpy(out.m_bytes.data(), bytes, out.m_bytes.size());
+        return out;
+    }
+
+    void set(size_t i, float v) {
+        if (v < 0.0f) v = 0.0f;
+        if (v > 1.0f) v = 1.0f;
+        uint8_t* p = m_bytes.data() + i * peak_encoding_size(m_encoding);
+        if (m_encoding == PeakEncoding::U16) {
+            uint16_t q = static_cast<uint16_t>(std::lround(v * 65535.0f));
+            memcpy(p, &q, 2);
+        } else {
+            *p = static_cast<uint8_t>(std::lround(v * 255.0f));
+        }
+    }
+
+    float operator[](size_t i) const {
+        const uint8_t* p = m_bytes.data() + i * peak_encoding_size(m_encoding);
+        if (m_encoding == PeakEncoding::U16) {
+            uint16_t q;
+            memcpy(&q, p, 2);
+            return q * (1.0f / 65535.0f);
+        }
+        return *p * (1.0f / 255.0f);
+    }
+
+    // Re-encode into another representation (no-op copy if already matching).
+    WaveformPeaks converted(PeakEncoding enc) const {
+        if (enc == m_encoding) return *this;
+        WaveformPeaks out(enc, m_count);
+        for (size_t i = 0; i < m_count; i++) out.set(i, (*this)[i]);
+        return out;
+    }
+
+    size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    PeakEncoding encoding() const { return m_encoding; }
+    const uint8_t* bytes() const { return m_bytes.data(); }
+    uint8_t* bytes() { return m_bytes.data(); }
+    size_t byte_size() const { return m_bytes.size(); }
+
+private:
+    PeakEncoding m_encoding = PeakEncoding::U8;
+    size_t m_count = 0;
+    std::vector<uint8_t> m_bytes;
+};
+
+// One resolution of a track's waveform. All planes have one value per
+// segment. The RMS plane is normalized to the loudest segment's RMS (the
+// classic bar height); the peak planes share one scale, normalized to the
+// largest sample magnitude, and rms_scale relates the two so the RMS can be
+// drawn inside the envelope. loudness is a property of the whole track and
+// travels with its finest level.
+struct WaveformLevel {
+    static constexpr size_t PLANES = 3;
+
+    WaveformPeaks rms;
+    WaveformPeaks peak_max;  // Positive peak
+    WaveformPeaks peak_min;  // Magnitude of the negative peak
+    float rms_scale = 1.0f;  // Largest RMS / largest sample magnitude (linear)
+    float loudness = 0.0f;   // Integrated loudness in LUFS, 0 = not measured
+
+    WaveformLevel() = default;
+    WaveformLevel(PeakEncoding enc, size_t count)
+        : rms(enc, count), peak_max(enc, count), peak_min(enc, count) {}
+
+    size_t size() const { return rms.size(); }
+    bool empty() const { return rms.empty(); }
+    PeakEncoding encoding() const { return rms.encoding(); }
+    size_t byte_size() const { return rms.byte_size() + peak_max.byte_size() + peak_min.byte_size(); }
+
+    // The planes back to back (rms, peak_max, peak_min), as stored on disk.
+    WaveformPeaks packed() const {
+        WaveformPeaks out(encoding(), size() * PLANES);
+        uint8_t* dst = out.bytes();
+        size_t plane = rms.byte_size();
+        if (plane) {
+            memcpy(dst, rms.bytes(), plane);
+            memcpy(dst + plane, peak_max.bytes(), plane);
+            memcpy(dst + plane * 2, peak_min.bytes(), plane);
+        }
+        return out;
+    }
+
+    static WaveformLevel unpacked(const uint8_t* bytes, size_t count, PeakEncoding enc, float rms_scale) {
+        WaveformLevel out;
+        size_t plane = count * peak_encoding_size(enc);
+        out.rms = WaveformPeaks::from_encoded(bytes, count, enc);
+        out.peak_max = WaveformPeaks::from_encoded(bytes + plane, count, enc);
+        out.peak_min = WaveformPeaks::from_encoded(bytes + plane * 2, count, enc);
+        out.rms_scale = rms_scale;
+        return out;
+    }
+
+    WaveformLevel converted(PeakEncoding enc) const {
+        WaveformLevel out;
+        out.rms = rms.converted(enc);
+        out.peak_max = peak_max.converted(enc);
+        out.peak_min = peak_min.converted(enc);
+        out.rms_scale = rms_scale;
+        out.loudness = loudness;
+        return out;
+    }
+};
+
+} // namespace nowbar
@@ -0,0 +1,166 @@
+#include "waveform_pyramid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace nowbar {
+
+namespace {
+
+// A level in linear units, before normalization. Peaks are magnitudes.
+struct LinearLevel {
+    std::vector<float> rms;
+    std::vector<float> peak_max;
+    std::vector<float> peak_min;
+};
+
+// Normalize the RMS plane to its loudest segment, the peak planes to the
+// largest magnitude of either, and apply the curve.
+WaveformLevel encode_level(const LinearLevel& lin, PeakEncoding enc) {
+    size_t count = lin.rms.size();
+    WaveformLevel out(enc, count);
+    float max_rms = 0.0f, max_peak = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        max_rms = std::max(max_rms, lin.rms[i]);
+        max_peak = std::max({max_peak, lin.peak_max[i], lin.peak_min[i]});
+    }
+    if (max_rms > 0.0f) {
+        for (size_t i = 0; i < count; i++) out.rms.set(i, std::pow(lin.rms[i] / max_rms, WAVEFORM_PEAK_CURVE));
+    }
+    if (max_peak > 0.0f) {
+        for (size_t i = 0; i < count; i++) {
+            out.peak_max.set(i, std::pow(lin.peak_max[i] / max_peak, WAVEFORM_PEAK_CURVE));
+            out.peak_min.set(i, std::pow(lin.peak_min[i] / max_peak, WAVEFORM_PEAK_CURVE));
+        }
+        out.rms_scale = std::min(1.0f, max_rms / max_peak);
+    }
+    return out;
+}
+
+// Segments of one level cover equal time spans, so the RMS of a merged
+// segment is the root of the mean of its children's squared RMS; peaks
+// merge by taking the largest.
+LinearLevel merge_level(const LinearLevel& lin) {
+    size_t count = lin.rms.size() / WAVEFORM_PYRAMID_FACTOR;
+    LinearLevel out;
+    out.rms.resize(count);
+    out.peak_max.resize(count);
+    out.peak_min.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        float sum = 0.0f, hi = 0.0f, lo = 0.0f;
+        for (uint32_t k = 0; k < WAVEFORM_PYRAMID_FACTOR; k++) {
+            size_t src = i * WAVEFORM_PYRAMID_FACTOR + k;
+            sum += lin.rms[src] * lin.rms[src];
+            hi = std::max(hi, lin.peak_max[src]);
+            lo = std::max(lo, lin.peak_min[src]);
+        }
+        out.rms[i] = std::sqrt(sum / WAVEFORM_PYRAMID_FACTOR);
+        out.peak_max[i] = hi;
+        out.peak_min[i] = lo;
+    }
+    return out;
+}
+
+// True for the segment counts of the pyramid's levels: 400, 800 and 1600.
+bool is_pyramid_size(size_t count) {
+    size_t size = WAVEFORM_PYRAMID_COARSE;
+    for (uint32_t i = 0; i < WAVEFORM_PYRAMID_LEVELS; i++, size *= WAVEFORM_PYRAMID_FACTOR) {
+        if (count == size) return true;
+    }
+    return false;
+}
+
+// Merge down to the coarsest level; lin must have one of the pyramid's sizes.
+void add_coarser_levels(std::vector<WaveformLevel>& levels, LinearLevel lin, PeakEncoding enc) {
+    while (lin.rms.size() > WAVEFORM_PYRAMID_COARSE) {
+        lin = merge_level(lin);
+        levels.push_back(encode_level(lin, enc));
+    }
+}
+
+} // anonymous namespace
+
+WaveformPyramid WaveformPyramid::from_stats(const WaveformSegmentStats* stats, size_t count, PeakEncoding enc,
+                                            float loudness) {
+    LinearLevel lin;
+    lin.rms.resize(count);
+    lin.peak_max.resize(count);
+    lin.peak_min.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        lin.rms[i] = stats[i].rms();
+        lin.peak_max[i] = std::max(0.0f, stats[i].max);
+        lin.peak_min[i] = std::max(0.0f, -stats[i].min);
+    }
+
+    WaveformPyramid out;
+    out.m_levels.push_back(encode_level(lin, enc));
+    out.m_levels.front().loudness = loudness;
+    if (is_pyramid_size(count)) add_coarser_levels(out.m_levels, std::move(lin), enc);
+    return out;
+}
+
+WaveformPyramid WaveformPyramid::from_finest(WaveformLevel finest) {
+    WaveformPyramid out;
+    size_t count = finest.size();
+    PeakEncoding enc = finest.encoding();
+    LinearLevel lin;
+    if (is_pyramid_size(count) && count > WAVEFORM_PYRAMID_COARSE) {
+        // Undo the curve and bring the RMS onto the peak scale; the common
+        // scale factor cancels when each level is normalized again.
+        const float inv_curve = 1.0f / WAVEFORM_PEAK_CURVE;
+        lin.rms.resize(count);
+        lin.peak_max.resize(count);
+        lin.peak_min.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            lin.rms[i] = std::pow(finest.rms[i], inv_curve) * finest.rms_scale;
+            lin.peak_max[i] = std::pow(finest.peak_max[i], inv_curve);
+            lin.peak_min[i] = std::pow(finest.peak_min[i], inv_curve);
+        }
+    }
+    out.m_levels.push_back(std::move(finest));
+    if (!lin.rms.empty()) add_coarser_levels(out.m_levels, std::move(lin), enc);
+    return out;
+}
+
+WaveformBar waveform_bar(const WaveformLevel& level, size_t index, size_t bars) {
+    WaveformBar bar;
+    size_t count = level.size();
+    if (count == 0 || bars == 0 || index >= bars) return bar;
+    size_t first = index * count / bars;
+    size_t last = std::max(first + 1, ((index + 1) * count + bars - 1) / bars);
+    last = std::min(last, count);
+
+    // Mean square on the linear scale: undo the curve, square, average, and
+    // apply it again
+    const float to_square = 2.0f / WAVEFORM_PEAK_CURVE;
+    float sum = 0.0f;
+    for (size_t i = first; i < last; i++) {
+        sum += std::pow(level.rms[i], to_square);
+        bar.peak_max = std::max(bar.peak_max, level.peak_max[i]);
+        bar.peak_min = std::max(bar.peak_min, level.peak_min[i]);
+    }
+    bar.rms = std::pow(sum / (last - first), WAVEFORM_PEAK_CURVE * 0.5f);
+    return bar;
+}
+
+uint32_t waveform_pyramid_size_for(size_t bars) {
+    uint32_t size = WAVEFORM_PYRAMID_COARSE;
+    while (size < bars && size < WAVEFORM_PYRAMID_FINE) size *= WAVEFORM_PYRAMID_FACTOR;
+    return size;
+}
+
+const WaveformLevel& WaveformPyramid::level_for(size_t bars) const {
+    static const WaveformLevel no_level;
+    if (m_levels.empty()) return no_level;
+    for (size_t i = m_levels.size(); i-- > 0;) {
+        if (m_levels[i].size() >= bars) return m_levels[i];
+    }
+    return m_levels.front();
+}
+
+size_t WaveformPyramid::byte_size() const {
+    size_t bytes = 0;
+    for (const WaveformLevel& level : m_levels) bytes += level.byte_size();
+    return bytes;
+}
+
+} // namespace nowbar
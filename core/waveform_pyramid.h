@@ -0,0 +1,81 @@
+#pragma once
+// Multi-resolution waveform (mip-style pyramid).
+//
+// The decoder measures the finest level only; each coarser level combines
+// WAVEFORM_PYRAMID_FACTOR segments of the level below it, so no audio is
+// decoded twice. Only one level is stored in wavecache.db, the coarsest
+// that still covers the widest display, and the coarser ones are rebuilt on
+// load, which is a few thousand multiplies.
+//
+// Every level is normalized to its own loudest segment and has the
+// perceptual curve applied, like the single-level peaks before it, so the
+// renderer can pick whichever level matches the display width.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and exercised outside foobar2000.
+#include "waveform_peaks.h"
+#include "waveform_reduce.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nowbar {
+
+constexpr uint32_t WAVEFORM_PYRAMID_COARSE = 400;   // Segments in the coarsest level
+constexpr uint32_t WAVEFORM_PYRAMID_FACTOR = 2;     // Segments merged per coarser segment
+constexpr uint32_t WAVEFORM_PYRAMID_LEVELS = 3;     // 1600, 800 and 400
+constexpr uint32_t WAVEFORM_PYRAMID_FINE = 1600;    // COARSE * FACTOR^(LEVELS-1)
+
+constexpr float WAVEFORM_PEAK_CURVE = 0.65f;        // Gently expands quieter segments
+
+// Segments of the coarsest pyramid level with at least `bars` segments, or
+// WAVEFORM_PYRAMID_FINE if none has that many.
+uint32_t waveform_pyramid_size_for(size_t bars);
+
+// One display bar, in the same curved 0..1 units as the level it came from.
+struct WaveformBar {
+    float rms = 0.0f;
+    float peak_max = 0.0f;
+    float peak_min = 0.0f;
+};
+
+// Reduce the segments that bar `index` of `bars` covers across the level:
+// the largest of each peak plane and the root mean square of the RMS, so a
+// short transient survives however many segments share a bar. A bar
+// narrower than a segment takes the segment under it.
+WaveformBar waveform_bar(const WaveformLevel& level, size_t index, size_t bars);
+
+class WaveformPyramid {
+public:
+    WaveformPyramid() = default;
+
+    // Build every level from the finest level's segment statistics (count
+    // is normally WAVEFORM_PYRAMID_FINE; segments not decoded yet are empty).
+    // loudness is the track's integrated LUFS, 0 if not measured.
+    static WaveformPyramid from_stats(const WaveformSegmentStats* stats, size_t count, PeakEncoding enc,
+                                      float loudness = 0.0f);
+
+    // Rebuild the coarser levels from a stored level of one of the pyramid's
+    // resolutions. A level of any other resolution becomes a single-level
+    // pyramid.
+    static WaveformPyramid from_finest(WaveformLevel finest);
+
+    bool empty() const { return m_levels.empty() || m_levels.front().empty(); }
+    size_t level_count() const { return m_levels.size(); }
+
+    // Level 0 is the finest.
+    const WaveformLevel& level(size_t index) const { return m_levels[index]; }
+    const WaveformLevel& finest() const { return m_levels.front(); }
+    float loudness() const { return m_levels.empty() ? 0.0f : m_levels.front().loudness; }
+
+    // The coarsest level with at least `bars` segments, so every displayed
+    // bar maps to real data; the finest level if none is that detailed.
+    const WaveformLevel& level_for(size_t bars) const;
+
+    size_t byte_size() const;
+
+private:
+    std::vector<WaveformLevel> m_levels;
+};
+
+} // namespace nowbar
@@ -0,0 +1,77 @@
+#pragma once
+// Per-segment reduction kernel shared by every waveform producer.
+//
+// One pass over interleaved frames collects the statistics the waveform
+// needs: the RMS of the channel-averaged magnitude (what the bar height has
+// always been based on) plus the true peak envelope, i.e. the largest and
+// smallest sample of any channel, so transients and clipping show up.
+// Per-channel statistics are optional and cost nothing when not requested.
+//
+// Kept free of pch.h / SDK dependencies (NotUsing PCH) so it can be built
+// and benchmarked outside foobar2000.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace nowbar {
+
+struct WaveformSegmentStats {
+    float min = 0.0f;      // Most negative sample (<= 0)
+    float max = 0.0f;      // Most positive sample (>= 0)
+    double sum_sq = 0.0;   // Sum of squared values feeding the RMS
+    uint64_t count = 0;    // Frames accumulated
+
+    float rms() const { return count ? static_cast<float>(std::sqrt(sum_sq / count)) : 0.0f; }
+};
+
+// Fold frame_count interleaved frames into mix and, if per_channel is not
+// null, into per_channel[0..channels). Sample is float or double.
+template <typename Sample>
+void waveform_reduce(const Sample* frames, size_t frame_count, unsigned channels,
+                     WaveformSegmentStats& mix, WaveformSegmentStats* per_channel = nullptr) {
+    if (frame_count == 0 || channels == 0) return;
+    const float inv_channels = 1.0f / static_cast<float>(channels);
+
+    // Accumulate in locals so the loop stays in registers; the sum is
+    // flushed to double per call, which keeps float error bounded by the
+    // chunk length rather than the track length.
+    float lo = mix.min, hi = mix.max, sum_sq = 0.0f;
+    if (channels == 2 && !per_channel) {
+        // Stereo fast path: no inner loop, no division
+        for (size_t f = 0; f < frame_count; f++) {
+            float l = static_cast<float>(frames[f * 2]);
+            float r = static_cast<float>(frames[f * 2 + 1]);
+            float m = (std::fabs(l) + std::fabs(r)) * 0.5f;
+            sum_sq += m * m;
+            lo = std::min(lo, std::min(l, r));
+            hi = std::max(hi, std::max(l, r));
+        }
+    } else {
+        for (size_t f = 0; f < frame_count; f++) {
+            const Sample* frame = frames + f * channels;
+            float sum_abs = 0.0f;
+            for (unsigned ch = 0; ch < channels; ch++) {
+                float v = static_cast<float>(frame[ch]);
+                sum_abs += std::fabs(v);
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+                if (per_channel) {
+                    WaveformSegmentStats& c = per_channel[ch];
+                    c.sum_sq += static_cast<double>(v) * v;
+                    c.min = std::min(c.min, v);
+                    c.max = std::max(c.max, v);
+                    c.count++;
+                }
+            }
+            float m = sum_abs * inv_channels;
+            sum_sq += m * m;
+        }
+    }
+    mix.min = lo;
+    mix.max = hi;
+    mix.sum_sq += sum_sq;
+    mix.count += frame_count;
+}
+
+} // namespace nowbar
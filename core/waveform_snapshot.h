@@ -0,0 +1,113 @@
+#pragma once
+// Hand-off of waveform peaks from the decoder to the renderer.
+//
+// The decoder builds a fresh WaveformPyramid and publishes it as an immutable
+// snapshot by swapping one atomic pointer. The pyramid itself is shared, so
+// every panel showing the same decode job publishes the same one. The paint path opens a Reader,
+// which is two atomic increments and a load: it never locks, never copies
+// the peaks and never waits for the decoder. Replaced snapshots are retired
+// and freed by a later writer once no Reader is open (RCU-style grace
+// period), so readers need no reference counting either.
+//
+// Kept free of pch.h / SDK dependencies so it can be built and exercised
+// outside foobar2000.
+#include "waveform_pyramid.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace nowbar {
+
+struct WaveformSnapshot {
+    std::shared_ptr<const WaveformPyramid> pyramid;  // Never null
+    uint64_t version = 0;    // Increases with every publish() on the same cell
+    bool complete = false;   // Fully decoded (or loaded from cache)
+};
+
+// One progress report from a waveform decode job. The pyramid is shared by
+// every panel subscribed to the job; each publishes it into its own cell.
+struct WaveformUpdate {
+    std::shared_ptr<const WaveformPyramid> pyramid;  // Null if the decode failed
+    int decode_count = 0;    // Reveal units decoded so far
+    bool complete = false;   // Last update of the job
+};
+
+class WaveformSnapshotCell {
+public:
+    // Read-side critical section. The snapshot stays valid until the Reader
+    // is destroyed; keep it short (one paint).
+    class Reader {
+    public:
+        explicit Reader(const WaveformSnapshotCell& cell) : m_cell(cell) {
+            m_cell.m_readers.fetch_add(1);
+            m_snapshot = m_cell.m_current.load();
+        }
+        ~Reader() { m_cell.m_readers.fetch_sub(1); }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        const WaveformSnapshot* get() const { return m_snapshot; }
+        const WaveformSnapshot* operator->() const { return m_snapshot; }
+        explicit operator bool() const { return m_snapshot != nullptr; }
+
+    private:
+        const WaveformSnapshotCell& m_cell;
+        const WaveformSnapshot* m_snapshot;
+    };
+
+    WaveformSnapshotCell() = default;
+    WaveformSnapshotCell(const WaveformSnapshotCell&) = delete;
+    WaveformSnapshotCell& operator=(const WaveformSnapshotCell&) = delete;
+
+    // No Reader or writer may be active during destruction.
+    ~WaveformSnapshotCell() {
+        delete m_current.load();
+        for (const WaveformSnapshot* old : m_retired) delete old;
+    }
+
+    // A null pyramid publishes an empty one.
+    void publish(std::shared_ptr<const WaveformPyramid> pyramid, bool complete) {
+        auto* snapshot = new WaveformSnapshot();
+        snapshot->pyramid = pyramid ? std::move(pyramid) : std::make_shared<const WaveformPyramid>();
+        snapshot->complete = complete;
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+        snapshot->version = ++m_version;
+        retire(m_current.exchange(snapshot));
+    }
+
+    void publish(WaveformPyramid pyramid, bool complete) {
+        publish(std::make_shared<const WaveformPyramid>(std::move(pyramid)), complete);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+        retire(m_current.exchange(nullptr));
+    }
+
+    bool complete() const {
+        Reader reader(*this);
+        return reader && reader->complete;
+    }
+
+private:
+    // Called with m_writer_mutex held, after old was swapped out. A Reader
+    // that registered before the swap may still hold old (or an earlier
+    // retiree); once the count is seen at zero, every later Reader is
+    // guaranteed to load the new pointer, so all retirees can go.
+    void retire(const WaveformSnapshot* old) {
+        if (old) m_retired.push_back(old);
+        if (m_readers.load() != 0) return;
+        for (const WaveformSnapshot* retired : m_retired) delete retired;
+        m_retired.clear();
+    }
+
+    mutable std::atomic<int> m_readers{0};
+    std::atomic<const WaveformSnapshot*> m_current{nullptr};
+    std::mutex m_writer_mutex;  // Serializes writers only; readers never take it
+    std::vector<const WaveformSnapshot*> m_retired;
+    uint64_t m_version = 0;
+};
+
+} // namespace nowbar
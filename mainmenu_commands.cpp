@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "preferences.h"
+#include "core/control_panel_core.h"
 #include <shellapi.h>
 #include <shlobj.h>
 
@@ -26,6 +27,12 @@ static const GUID guid_cbutton_commands[] = {
     { 0xD6A5E8F1, 0x1234, 0x5678, { 0xAB, 0xCD, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C } }
 };
 
+// Diagnostics commands (hidden, shown with Shift)
+static const GUID guid_nowbar_waveform_cache_stats =
+    { 0xD6A5E8F2, 0x1234, 0x5678, { 0xAB, 0xCD, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 } };
+static const GUID guid_nowbar_artwork_cache_stats =
+    { 0xD6A5E8F2, 0x1234, 0x5678, { 0xAB, 0xCD, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02 } };
+
 // Execute custom button action (shared implementation)
 // Supports buttons 0-11 (1-12 in UI)
 static void execute_cbutton_action(int button_index) {
@@ -304,3 +311,62 @@ public:
 
 // Register the mainmenu commands
 static mainmenu_commands_factory_t<nowbar_mainmenu_commands> g_nowbar_mainmenu_commands;
+
+// Diagnostics: prints cache counters to the console
+class nowbar_diagnostics_commands : public mainmenu_commands {
+public:
+    t_uint32 get_command_count() override {
+        return 2;
+    }
+
+    GUID get_command(t_uint32 p_index) override {
+        return p_index == 1 ? guid_nowbar_artwork_cache_stats : guid_nowbar_waveform_cache_stats;
+    }
+
+    void get_name(t_uint32 p_index, pfc::string_base& p_out) override {
+        p_out = p_index == 1 ? "Print artwork cache statistics" : "Print waveform cache statistics";
+    }
+
+    bool get_description(t_uint32 p_index, pfc::string_base& p_out) override {
+        p_out = p_index == 1 ? "Writes artwork memory cache hit/miss/eviction counters to the console"
+                             : "Writes waveform memory cache hit/miss/eviction counters to the console";
+        return true;
+    }
+
+    GUID get_parent() override {
+        return guid_nowbar_menu_group;
+    }
+
+    t_uint32 get_sort_priority() override {
+        return mainmenu_commands::sort_priority_base + 100;
+    }
+
+    bool get_display(t_uint32 p_index, pfc::string_base& p_text, t_uint32& p_flags) override {
+        get_name(p_index, p_text);
+        p_flags = flag_defaulthidden;
+        return true;
+    }
+
+    void execute(t_uint32 p_index, service_ptr ctx) override {
+        (void)ctx;
+        if (p_index == 1) {
+            print_stats("artwork", nowbar::ControlPanelCore::get_artwork_cache_stats());
+        } else {
+            print_stats("waveform", nowbar::ControlPanelCore::get_waveform_cache_stats());
+        }
+    }
+
+private:
+    template <typename Stats>
+    static void print_stats(const char* name, const Stats& stats) {
+        uint64_t lookups = stats.hits + stats.misses;
+        console::formatter() << "foo_nowbar: " << name << " cache "
+            << (uint64_t)stats.entries << " entries, "
+            << (uint64_t)(stats.bytes / 1024) << " / " << (uint64_t)(stats.capacity_bytes / 1024) << " KB, "
+            << stats.hits << " hits, " << stats.misses << " misses ("
+            << (lookups ? (unsigned)(stats.hits * 100 / lookups) : 0u) << "% hit rate), "
+            << stats.evictions << " evictions";
+    }
+};
+
+static mainmenu_commands_factory_t<nowbar_diagnostics_commands> g_nowbar_diagnostics_commands;
@@ -32,5 +32,34 @@ public:
 FOOGUIDDECL const GUID nowbar_color_provider::class_guid =
     { 0xa7e3b4c1, 0x8f2d, 0x4a6e, { 0xb5, 0xc9, 0x1d, 0x3f, 0x7e, 0x8a, 0x2b, 0x4c } };
 
+// Palette swatch roles for nowbar_color_provider_v2::get_artwork_swatch()
+enum nowbar_swatch_role : uint32_t {
+    nowbar_swatch_dominant = 0,  // Largest share of the artwork
+    nowbar_swatch_vibrant = 1,   // Most saturated color with a fair share
+    nowbar_swatch_muted = 2,     // Largest low-saturation, mid-lightness color
+};
+
+struct nowbar_palette_swatch {
+    uint8_t r, g, b;
+    float population;  // Share of the artwork, 0..1
+};
+
+// Palette access, added after v1. Consumers query it from the provider
+// (service_query_t) and fall back to v1 with older foo_nowbar versions.
+class NOVTABLE nowbar_color_provider_v2 : public nowbar_color_provider {
+    FB2K_MAKE_SERVICE_INTERFACE(nowbar_color_provider_v2, nowbar_color_provider)
+public:
+    // Copies up to max_count swatches, most populous first, and returns the
+    // palette size. Returns 0 when no artwork is loaded.
+    virtual size_t get_artwork_palette(nowbar_palette_swatch* out, size_t max_count) = 0;
+
+    // Sets valid=false when no artwork is loaded or no swatch fits the role.
+    virtual void get_artwork_swatch(uint32_t role, uint8_t& r, uint8_t& g, uint8_t& b, bool& valid) = 0;
+};
+
+// {0740CBFE-F565-4B34-8820-293AB082DC0E}
+FOOGUIDDECL const GUID nowbar_color_provider_v2::class_guid =
+    { 0x0740cbfe, 0xf565, 0x4b34, { 0x88, 0x20, 0x29, 0x3a, 0xb0, 0x82, 0xdc, 0x0e } };
+
 // Called by ControlPanelCore when colors change
 void nowbar_notify_color_changed();
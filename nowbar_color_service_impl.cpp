@@ -2,12 +2,13 @@
 #include "nowbar_color_service.h"
 #include "core/control_panel_core.h"
 #include "preferences.h"  // provides get_nowbar_background_style() and other config accessors
+#include <algorithm>
 #include <vector>
 #include <mutex>
 
 namespace {
 
-class nowbar_color_provider_impl : public nowbar_color_provider {
+class nowbar_color_provider_impl : public nowbar_color_provider_v2 {
 public:
     void get_resolved_bg_color(uint8_t& r, uint8_t& g, uint8_t& b) override {
         auto* core = get_first_instance();
@@ -49,6 +50,44 @@ public:
         valid = true;
     }
 
+    size_t get_artwork_palette(nowbar_palette_swatch* out, size_t max_count) override {
+        auto* core = get_first_instance();
+        const nowbar::ArtworkPalette* palette = core ? core->get_artwork_palette() : nullptr;
+        if (!palette || !palette->valid() || palette->total == 0) return 0;
+        size_t count = std::min<size_t>(palette->count, nowbar::ArtworkPalette::MAX_SWATCHES);
+        for (size_t i = 0; i < count && i < max_count && out; i++) {
+            uint32_t color = palette->swatches[i].color;
+            out[i].r = static_cast<uint8_t>(color >> 16);
+            out[i].g = static_cast<uint8_t>(color >> 8);
+            out[i].b = static_cast<uint8_t>(color);
+            out[i].population = static_cast<float>(palette->swatches[i].population) / palette->total;
+        }
+        return count;
+    }
+
+    void get_artwork_swatch(uint32_t role, uint8_t& r, uint8_t& g, uint8_t& b, bool& valid) override {
+        auto* core = get_first_instance();
+        const nowbar::ArtworkPalette* palette = core ? core->get_artwork_palette() : nullptr;
+        int32_t index = -1;
+        if (palette && palette->valid() && palette->total) {
+            if (role == nowbar_swatch_dominant) index = palette->dominant;
+            else if (role == nowbar_swatch_vibrant) index = palette->vibrant;
+            else if (role == nowbar_swatch_muted) index = palette->muted;
+        }
+        // The palette may come from the disk cache; never trust its indices
+        if (index < 0 || static_cast<uint32_t>(index) >= palette->count ||
+            static_cast<uint32_t>(index) >= nowbar::ArtworkPalette::MAX_SWATCHES) {
+            r = 0; g = 0; b = 0;
+            valid = false;
+            return;
+        }
+        uint32_t color = palette->swatches[index].color;
+        r = static_cast<uint8_t>(color >> 16);
+        g = static_cast<uint8_t>(color >> 8);
+        b = static_cast<uint8_t>(color);
+        valid = true;
+    }
+
     bool is_dark_mode() override {
         auto* core = get_first_instance();
         return core ? core->get_dark_mode() : true;
@@ -304,7 +304,7 @@ static cfg_int cfg_nowbar_waveform_width(
 
 static cfg_int cfg_nowbar_waveform_style(
     GUID{0xABCDEF8C, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x67, 0x8C}},
-    0  // Default: Waveform 1 (0=Waveform 1 / Bottom bars, 1=Waveform 2 / Centered envelope)
+    0  // Default: Waveform 1 (0=Waveform 1 / Bottom bars, 1=Waveform 2 / Centered envelope, 2=Waveform 3 / Peak envelope + RMS)
 );
 
 static cfg_int cfg_nowbar_waveform_unplayed_color(
@@ -651,6 +651,98 @@ static cfg_int cfg_nowbar_3d_buttons(
     1  // Default: Enabled (3D style)
 );
 
+// Advanced preferences (Display > Now Bar): tuning knobs without a dialog control
+static advconfig_branch_factory g_advconfig_nowbar_branch(
+    "Now Bar",
+    GUID{0xABCDEFD0, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x00}},
+    advconfig_branch::guid_branch_display,
+    0
+);
+
+static advconfig_integer_factory cfg_nowbar_waveform_memory_cache_mb(
+    "Waveform memory cache size (MB)",
+    GUID{0xABCDEFD1, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x01}},
+    GUID{0xABCDEFD0, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x00}},
+    0,
+    16,   // Default: 16 MB (roughly 3,000 waveforms at 1600 segments)
+    1, 1024
+);
+
+// How waveform heights relate between tracks. Per track fills the bar with
+// every track; the loudness modes scale quieter tracks down relative to a
+// loud master (WAVEFORM_FULL_SCALE_LUFS), optionally after ReplayGain.
+static advconfig_branch_factory g_advconfig_nowbar_waveform_scaling(
+    "Waveform scaling",
+    GUID{0xABCDEFD2, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x02}},
+    GUID{0xABCDEFD0, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x00}},
+    1
+);
+static advconfig_radio_factory cfg_nowbar_waveform_scaling_track(
+    "Per track (fill the bar)",
+    GUID{0xABCDEFD3, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x03}},
+    GUID{0xABCDEFD2, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x02}},
+    0,
+    true
+);
+static advconfig_radio_factory cfg_nowbar_waveform_scaling_loudness(
+    "By measured loudness (EBU R128)",
+    GUID{0xABCDEFD4, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x04}},
+    GUID{0xABCDEFD2, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x02}},
+    1,
+    false
+);
+static advconfig_radio_factory cfg_nowbar_waveform_scaling_replaygain(
+    "By loudness after ReplayGain",
+    GUID{0xABCDEFD5, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x05}},
+    GUID{0xABCDEFD2, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x02}},
+    2,
+    false
+);
+
+static advconfig_checkbox_factory cfg_nowbar_scrub_preview(
+    "Show a local waveform preview in the seek tooltip",
+    GUID{0xABCDEFD6, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x06}},
+    GUID{0xABCDEFD0, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x00}},
+    2,
+    false  // Default: off (decodes a few seconds of audio per hover)
+);
+
+static advconfig_integer_factory cfg_nowbar_artwork_memory_cache_mb(
+    "Artwork memory cache size (MB)",
+    GUID{0xABCDEFD7, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x07}},
+    GUID{0xABCDEFD0, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x00}},
+    3,
+    32,   // Default: 32 MB (about 30 covers at 512x512)
+    1, 1024
+);
+
+static advconfig_integer_factory cfg_nowbar_artwork_disk_cache_mb(
+    "Artwork disk cache size (MB, 0 = off)",
+    GUID{0xABCDEFD8, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x08}},
+    GUID{0xABCDEFD0, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x00}},
+    4,
+    64,   // Default: 64 MB (a few hundred compressed covers)
+    0, 4096
+);
+
+static advconfig_integer_factory cfg_nowbar_artwork_blur_size(
+    "Blurred background resolution (px)",
+    GUID{0xABCDEFD9, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x09}},
+    GUID{0xABCDEFD0, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x00}},
+    5,
+    64,   // Default: 64x64, stretched to the panel
+    16, 512
+);
+
+static advconfig_integer_factory cfg_nowbar_artwork_blur_radius(
+    "Blurred background radius (px at that resolution)",
+    GUID{0xABCDEFDA, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x0A}},
+    GUID{0xABCDEFD0, 0x1234, 0x5678, {0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x69, 0x00}},
+    6,
+    3,    // Default: 3 (three box passes, roughly a Gaussian of sigma 3.5)
+    1, 64
+);
+
 //=============================================================================
 // Config File for All 12 Custom Buttons
 // Buttons 1-6: Visible on panel, have enabled/icon fields
@@ -1856,10 +1948,40 @@ int get_nowbar_waveform_width() {
 int get_nowbar_waveform_style() {
     int s = cfg_nowbar_waveform_style;
     if (s < 0) s = 0;
-    if (s > 1) s = 1;
+    if (s > 2) s = 2;
     return s;
 }
 
+int get_nowbar_waveform_memory_cache_mb() {
+    return static_cast<int>(cfg_nowbar_waveform_memory_cache_mb.get());
+}
+
+bool get_nowbar_scrub_preview_enabled() {
+    return cfg_nowbar_scrub_preview.get();
+}
+
+int get_nowbar_artwork_memory_cache_mb() {
+    return static_cast<int>(cfg_nowbar_artwork_memory_cache_mb.get());
+}
+
+int get_nowbar_artwork_disk_cache_mb() {
+    return static_cast<int>(cfg_nowbar_artwork_disk_cache_mb.get());
+}
+
+int get_nowbar_artwork_blur_size() {
+    return static_cast<int>(cfg_nowbar_artwork_blur_size.get());
+}
+
+int get_nowbar_artwork_blur_radius() {
+    return static_cast<int>(cfg_nowbar_artwork_blur_radius.get());
+}
+
+int get_nowbar_waveform_scaling() {
+    if (cfg_nowbar_waveform_scaling_replaygain.get()) return 2;
+    if (cfg_nowbar_waveform_scaling_loudness.get()) return 1;
+    return 0;
+}
+
 int get_nowbar_skip_low_rating_threshold() {
     int threshold = cfg_nowbar_skip_low_rating_threshold;
     if (threshold < 1) threshold = 1;
@@ -2957,6 +3079,7 @@ void nowbar_preferences::switch_tab(int tab) {
     ShowWindow(GetDlgItem(m_hwnd, IDC_VIS_WAVEFORM_RADIO), show_general);
     ShowWindow(GetDlgItem(m_hwnd, IDC_VIS_WAVEFORM_STYLE_1), show_general);
     ShowWindow(GetDlgItem(m_hwnd, IDC_VIS_WAVEFORM_STYLE_2), show_general);
+    ShowWindow(GetDlgItem(m_hwnd, IDC_VIS_WAVEFORM_STYLE_3), show_general);
     ShowWindow(GetDlgItem(m_hwnd, IDC_VIS_WAVEFORM_WIDTH_LABEL), show_general);
     ShowWindow(GetDlgItem(m_hwnd, IDC_VIS_WAVEFORM_WIDTH_COMBO), show_general);
 
@@ -3173,6 +3296,7 @@ static void update_vis_section_state(HWND hwnd) {
     BOOL wave_on = enabled && waveform_sel;
     EnableWindow(GetDlgItem(hwnd, IDC_VIS_WAVEFORM_STYLE_1), wave_on);
     EnableWindow(GetDlgItem(hwnd, IDC_VIS_WAVEFORM_STYLE_2), wave_on);
+    EnableWindow(GetDlgItem(hwnd, IDC_VIS_WAVEFORM_STYLE_3), wave_on);
     EnableWindow(GetDlgItem(hwnd, IDC_VIS_WAVEFORM_WIDTH_LABEL), wave_on);
     EnableWindow(GetDlgItem(hwnd, IDC_VIS_WAVEFORM_WIDTH_COMBO), wave_on);
 }
@@ -3617,9 +3741,9 @@ INT_PTR CALLBACK nowbar_preferences::ConfigProc(HWND hwnd, UINT msg, WPARAM wp,
             SendMessage(hWaveWidth, CB_ADDSTRING, 0, (LPARAM)L"Wide");
             SendMessage(hWaveWidth, CB_SETCURSEL, cfg_nowbar_waveform_width, 0);
 
-            // Initialize waveform style radio buttons (1 vs 2)
-            CheckRadioButton(hwnd, IDC_VIS_WAVEFORM_STYLE_1, IDC_VIS_WAVEFORM_STYLE_2,
-                (cfg_nowbar_waveform_style == 1) ? IDC_VIS_WAVEFORM_STYLE_2 : IDC_VIS_WAVEFORM_STYLE_1);
+            // Initialize waveform style radio buttons (1 / 2 / 3)
+            CheckRadioButton(hwnd, IDC_VIS_WAVEFORM_STYLE_1, IDC_VIS_WAVEFORM_STYLE_3,
+                IDC_VIS_WAVEFORM_STYLE_1 + get_nowbar_waveform_style());
 
             update_vis_section_state(hwnd);
         }
@@ -3843,8 +3967,9 @@ INT_PTR CALLBACK nowbar_preferences::ConfigProc(HWND hwnd, UINT msg, WPARAM wp,
 
         case IDC_VIS_WAVEFORM_STYLE_1:
         case IDC_VIS_WAVEFORM_STYLE_2:
+        case IDC_VIS_WAVEFORM_STYLE_3:
             if (HIWORD(wp) == BN_CLICKED) {
-                CheckRadioButton(hwnd, IDC_VIS_WAVEFORM_STYLE_1, IDC_VIS_WAVEFORM_STYLE_2, LOWORD(wp));
+                CheckRadioButton(hwnd, IDC_VIS_WAVEFORM_STYLE_1, IDC_VIS_WAVEFORM_STYLE_3, LOWORD(wp));
                 if (IsDlgButtonChecked(hwnd, IDC_VIS_WAVEFORM_RADIO) != BST_CHECKED) {
                     CheckRadioButton(hwnd, IDC_VIS_SPECTRUM_RADIO, IDC_VIS_WAVEFORM_RADIO, IDC_VIS_WAVEFORM_RADIO);
                 }
@@ -4797,7 +4922,8 @@ void nowbar_preferences::apply_settings() {
             cfg_nowbar_spectrum_opacity = (int)SendMessage(GetDlgItem(m_hwnd, IDC_SPECTRUM_OPACITY_SLIDER), TBM_GETPOS, 0, 0);
             cfg_nowbar_spectrum_gradient_mode = (int)SendMessage(GetDlgItem(m_hwnd, IDC_SPECTRUM_COLOR_MODE_COMBO), CB_GETCURSEL, 0, 0);
             cfg_nowbar_waveform_width = (int)SendMessage(GetDlgItem(m_hwnd, IDC_VIS_WAVEFORM_WIDTH_COMBO), CB_GETCURSEL, 0, 0);
-            cfg_nowbar_waveform_style = (IsDlgButtonChecked(m_hwnd, IDC_VIS_WAVEFORM_STYLE_2) == BST_CHECKED) ? 1 : 0;
+            cfg_nowbar_waveform_style = (IsDlgButtonChecked(m_hwnd, IDC_VIS_WAVEFORM_STYLE_3) == BST_CHECKED) ? 2 :
+                                        (IsDlgButtonChecked(m_hwnd, IDC_VIS_WAVEFORM_STYLE_2) == BST_CHECKED) ? 1 : 0;
             cfg_nowbar_vis_60fps = (IsDlgButtonChecked(m_hwnd, IDC_VIS_60FPS_CHECK) == BST_CHECKED) ? 1 : 0;
             // Color buttons are saved immediately via color picker, no need to save here
         }
@@ -4952,7 +5078,7 @@ void nowbar_preferences::reset_settings() {
             CheckDlgButton(m_hwnd, IDC_VIS_ENABLE_CHECK, BST_UNCHECKED);
             CheckDlgButton(m_hwnd, IDC_VIS_60FPS_CHECK, BST_UNCHECKED);
             CheckRadioButton(m_hwnd, IDC_VIS_SPECTRUM_RADIO, IDC_VIS_WAVEFORM_RADIO, IDC_VIS_SPECTRUM_RADIO);
-            CheckRadioButton(m_hwnd, IDC_VIS_WAVEFORM_STYLE_1, IDC_VIS_WAVEFORM_STYLE_2, IDC_VIS_WAVEFORM_STYLE_1);
+            CheckRadioButton(m_hwnd, IDC_VIS_WAVEFORM_STYLE_1, IDC_VIS_WAVEFORM_STYLE_3, IDC_VIS_WAVEFORM_STYLE_1);
             SendMessage(GetDlgItem(m_hwnd, IDC_VIS_SPECTRUM_WIDTH_COMBO), CB_SETCURSEL, 1, 0);  // Normal
             SendMessage(GetDlgItem(m_hwnd, IDC_VIS_SPECTRUM_STYLE_COMBO), CB_SETCURSEL, 1, 0);  // Curve
             SendMessage(GetDlgItem(m_hwnd, IDC_VIS_SPECTRUM_HEIGHT_COMBO), CB_SETCURSEL, 2, 0);  // High
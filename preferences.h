@@ -52,7 +52,14 @@ bool get_nowbar_vis_60fps();
 COLORREF get_nowbar_waveform_color();
 COLORREF get_nowbar_waveform_unplayed_color();
 int get_nowbar_waveform_width();     // 0=Thin, 1=Normal, 2=Wide
-int get_nowbar_waveform_style();     // 0=Waveform 1 (Bottom bars), 1=Waveform 2 (Centered envelope)
+int get_nowbar_waveform_style();     // 0=Waveform 1 (Bottom bars), 1=Waveform 2 (Centered envelope), 2=Waveform 3 (Peak envelope + RMS)
+int get_nowbar_waveform_memory_cache_mb();  // Process-wide waveform LRU cap (advanced preferences)
+bool get_nowbar_scrub_preview_enabled();  // Local waveform above the seek tooltip (advanced preferences)
+int get_nowbar_artwork_memory_cache_mb();  // Process-wide artwork LRU cap (advanced preferences)
+int get_nowbar_artwork_disk_cache_mb();  // artcache.db size cap, 0 = disabled (advanced preferences)
+int get_nowbar_artwork_blur_size();    // Blurred background working resolution (advanced preferences)
+int get_nowbar_artwork_blur_radius();  // Blur radius at that resolution (advanced preferences)
+int get_nowbar_waveform_scaling();   // 0=Per track, 1=By loudness, 2=By loudness after ReplayGain (advanced preferences)
 int get_nowbar_background_style();  // 0=Solid, 1=Artwork Colors, 2=Blurred Artwork
 bool get_nowbar_smooth_animations_enabled();  // true=Enabled, false=Disabled
 COLORREF get_nowbar_button_accent_color();    // Button accent color for shuffle/repeat
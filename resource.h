@@ -180,6 +180,7 @@
 #define IDC_VIS_SPECTRUM_HEIGHT_COMBO         1422
 #define IDC_VIS_WAVEFORM_STYLE_1              1423
 #define IDC_VIS_WAVEFORM_STYLE_2              1424
+#define IDC_VIS_WAVEFORM_STYLE_3              1425
 
 // Online Artwork checkbox (Appearance tab)
 #define IDC_ONLINE_ARTWORK_CHECK       1416
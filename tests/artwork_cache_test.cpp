@@ -0,0 +1,124 @@
+// ArtworkMemoryCache: entries are shared rather than copied, the byte budget
+// evicts least-recently-used covers first, replacing a key re-counts its
+// size, and the stats add up. Also checks that artwork_content_key() tells
+// apart covers that differ in one byte or only in length.
+#include "test_util.h"
+#include "artwork_cache.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+using EntryPtr = std::shared_ptr<const ArtworkDerivatives>;
+
+EntryPtr make_entry(uint32_t size, uint32_t blur_size = 0) {
+    auto d = std::make_shared<ArtworkDerivatives>();
+    d->width = size;
+    d->height = size;
+    d->pixels.assign(static_cast<size_t>(size) * size * 4, static_cast<uint8_t>(size));
+    d->blur_size = blur_size;
+    d->blur.assign(static_cast<size_t>(blur_size) * blur_size * 4, 0);
+    return d;
+}
+
+std::string key(int k) { return std::string("cover").append(std::to_string(k)); }
+
+void test_shared() {
+    ArtworkMemoryCache cache(1 << 20);
+    auto entry = make_entry(16);
+    cache.insert(key(0), entry);
+    EntryPtr out;
+    CHECK(cache.lookup(key(0), out));
+    CHECK(out == entry);  // Same object, no copy
+    CHECK(!cache.lookup(key(1), out));
+    CHECK(out == entry);  // A miss leaves out alone
+}
+
+void test_eviction() {
+    ArtworkMemoryCache cache(1 << 20);
+    for (int k = 0; k < 8; k++) cache.insert(key(k), make_entry(32));
+    size_t one = cache.get_stats().bytes / 8;
+    CHECK(one > 32 * 32 * 4);  // Pixels plus bookkeeping
+
+    // Room for four: the four most recently used stay, touching k0 first
+    // moves it ahead of k4..k6
+    EntryPtr out;
+    CHECK(cache.lookup(key(0), out));
+    cache.set_capacity(one * 4);
+    ArtworkMemoryCache::Stats stats = cache.get_stats();
+    CHECK_EQ(stats.entries, 4u);
+    CHECK_EQ(stats.evictions, 4u);
+    CHECK_EQ(stats.bytes, one * 4);
+    CHECK_EQ(stats.capacity_bytes, one * 4);
+    for (int k : {0, 5, 6, 7}) CHECK(cache.lookup(key(k), out));
+    for (int k : {1, 2, 3, 4}) CHECK(!cache.lookup(key(k), out));
+
+    // A new entry pushes out the least recently used one (k0)
+    cache.insert(key(8), make_entry(32));
+    CHECK(!cache.lookup(key(0), out));
+    CHECK(cache.lookup(key(8), out));
+    CHECK_EQ(cache.get_stats().evictions, 5u);
+
+    // Larger than the whole budget: refused, nothing evicted
+    cache.insert(key(9), make_entry(512));
+    CHECK(!cache.lookup(key(9), out));
+    CHECK_EQ(cache.get_stats().entries, 4u);
+    CHECK_EQ(cache.get_stats().evictions, 5u);
+}
+
+// Replacing a key keeps one entry and counts the new size, blur included.
+void test_replace() {
+    ArtworkMemoryCache cache(1 << 20);
+    cache.insert(key(0), make_entry(32));
+    size_t small = cache.get_stats().bytes;
+    cache.insert(key(0), make_entry(32, 64));
+    ArtworkMemoryCache::Stats stats = cache.get_stats();
+    CHECK_EQ(stats.entries, 1u);
+    CHECK_EQ(stats.bytes, small + 64 * 64 * 4);
+    EntryPtr out;
+    CHECK(cache.lookup(key(0), out) && out->blur_size == 64);
+
+    cache.clear();
+    stats = cache.get_stats();
+    CHECK_EQ(stats.entries, 0u);
+    CHECK_EQ(stats.bytes, 0u);
+    CHECK(!cache.lookup(key(0), out));
+}
+
+void test_stats() {
+    ArtworkMemoryCache cache(1 << 20);
+    cache.insert(key(0), make_entry(8));
+    EntryPtr out;
+    for (int i = 0; i < 3; i++) cache.lookup(key(0), out);
+    for (int i = 0; i < 2; i++) cache.lookup(key(1), out);
+    ArtworkMemoryCache::Stats stats = cache.get_stats();
+    CHECK_EQ(stats.hits, 3u);
+    CHECK_EQ(stats.misses, 2u);
+    CHECK_EQ(stats.evictions, 0u);
+    CHECK_EQ(stats.entries, 1u);
+    CHECK_EQ(stats.capacity_bytes, size_t(1) << 20);
+}
+
+void test_content_key() {
+    std::vector<uint8_t> bytes(1000, 7);
+    std::string base = artwork_content_key(bytes.data(), bytes.size());
+    CHECK(artwork_content_key(bytes.data(), bytes.size()) == base);
+    CHECK(artwork_content_key(bytes.data(), bytes.size() - 1) != base);
+    bytes[999] = 8;
+    CHECK(artwork_content_key(bytes.data(), bytes.size()) != base);
+    CHECK_EQ(artwork_content_key(nullptr, 0).size(), base.size());
+}
+
+} // anonymous namespace
+
+int main() {
+    test_shared();
+    test_eviction();
+    test_replace();
+    test_stats();
+    test_content_key();
+    return nowbar_test::test_result("artwork_cache_test");
+}
@@ -0,0 +1,256 @@
+// extract_artwork_palette() on reference images: flat covers give a single
+// swatch, distinct colors stay apart instead of averaging, roles land on the
+// expected swatches, colors at the edge of the sRGB gamut come back opaque
+// and close to the input, and transparent pixels are left out. Also covers
+// padded strides, degenerate input and palette_background_colors(). Also
+// prints the extraction time on a 64x64 and a 512x512 noisy cover.
+#include "test_util.h"
+#include "artwork_colors.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+struct Image {
+    int width, height;
+    ptrdiff_t stride;
+    std::vector<uint8_t> pixels;
+
+    Image(int w, int h, int pad = 0) : width(w), height(h), stride((w + pad) * 4), pixels(stride * h, 0xEE) {}
+
+    // Straight-alpha 0xAARRGGBB over [x0, x1) x [y0, y1).
+    void fill(int x0, int y0, int x1, int y1, uint32_t argb) {
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                uint8_t* p = &pixels[y * stride + x * 4];
+                p[0] = argb & 0xFF;
+                p[1] = argb >> 8 & 0xFF;
+                p[2] = argb >> 16 & 0xFF;
+                p[3] = argb >> 24;
+            }
+        }
+    }
+    void fill(uint32_t argb) { fill(0, 0, width, height, argb); }
+
+    bool extract(ArtworkPalette& out) const {
+        return extract_artwork_palette(pixels.data(), width, height, stride, out);
+    }
+};
+
+// Sum of absolute RGB differences.
+int distance(uint32_t x, uint32_t y) {
+    int d = 0;
+    for (int shift = 0; shift < 24; shift += 8) d += std::abs(int(x >> shift & 0xFF) - int(y >> shift & 0xFF));
+    return d;
+}
+
+int channel(uint32_t argb, int shift) { return argb >> shift & 0xFF; }
+
+bool opaque(const ArtworkPalette& palette) {
+    return std::all_of(palette.swatches, palette.swatches + palette.count,
+                       [](const ArtworkSwatch& s) { return s.color >> 24 == 0xFF; });
+}
+
+void test_solid() {
+    Image image(512, 512);
+    image.fill(0xFF3366CC);
+    ArtworkPalette palette;
+    CHECK(image.extract(palette));
+    CHECK(palette.valid());
+    CHECK_EQ(palette.count, 1u);
+    CHECK_EQ(palette.total, 32u * 32u);
+    CHECK_EQ(palette.swatches[0].population, palette.total);
+    CHECK(distance(palette.swatches[0].color, 0xFF3366CC) <= 3);
+    CHECK_EQ(palette.dominant, 0);
+
+    // Fewer pixels than grid cells: one sample per pixel.
+    image = Image(7, 3);
+    image.fill(0xFF3366CC);
+    CHECK(image.extract(palette));
+    CHECK_EQ(palette.total, 21u);
+}
+
+// Red and blue halves are two swatches of equal population, not one purple.
+void test_distinct_colors() {
+    Image image(512, 512);
+    image.fill(0, 0, 256, 512, 0xFFD02020);
+    image.fill(256, 0, 512, 512, 0xFF2030D0);
+    ArtworkPalette palette;
+    CHECK(image.extract(palette));
+    CHECK_EQ(palette.count, 2u);
+    CHECK_EQ(palette.swatches[0].population, 512u);
+    CHECK_EQ(palette.swatches[1].population, 512u);
+    uint32_t a = palette.swatches[0].color, b = palette.swatches[1].color;
+    CHECK(std::min(distance(a, 0xFFD02020) + distance(b, 0xFF2030D0),
+                   distance(a, 0xFF2030D0) + distance(b, 0xFFD02020)) <= 6);
+    CHECK(opaque(palette));
+}
+
+void test_roles() {
+    // Gray cover with an orange accent: gray dominates and is muted, orange
+    // is vibrant.
+    Image image(512, 512);
+    image.fill(0xFF808080);
+    image.fill(0, 0, 100, 100, 0xFFFF8800);
+    ArtworkPalette palette;
+    CHECK(image.extract(palette));
+    CHECK_EQ(palette.dominant, 0);
+    CHECK(distance(palette.swatches[palette.dominant].color, 0xFF808080) <= 3);
+    CHECK(palette.vibrant > 0);
+    CHECK(palette.vibrant >= 0 && distance(palette.swatches[palette.vibrant].color, 0xFFFF8800) <= 6);
+    CHECK_EQ(palette.muted, 0);
+
+    // Black and white are neither vibrant nor muted.
+    image.fill(0, 0, 512, 256, 0xFF000000);
+    image.fill(0, 256, 512, 512, 0xFFFFFFFF);
+    CHECK(image.extract(palette));
+    CHECK_EQ(palette.count, 2u);
+    CHECK_EQ(palette.vibrant, -1);
+    CHECK_EQ(palette.muted, -1);
+
+    // A speck of color below the share threshold is not vibrant.
+    image.fill(0xFF808080);
+    image.fill(0, 0, 16, 16, 0xFF00C000);
+    CHECK(image.extract(palette));
+    CHECK(palette.valid());
+    CHECK_EQ(palette.vibrant, -1);
+    CHECK_EQ(palette.muted, 0);
+}
+
+// Primaries and the extremes sit on the gamut boundary; the Oklab round trip
+// must bring them back opaque and close, not clipped to another hue.
+void test_gamut() {
+    const uint32_t colors[] = {0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFF00, 0xFF00FFFF,
+                               0xFFFF00FF, 0xFFFFFFFF, 0xFF000000, 0xFF010101, 0xFFFEFEFE};
+    for (uint32_t color : colors) {
+        Image image(64, 64);
+        image.fill(color);
+        ArtworkPalette palette;
+        CHECK(image.extract(palette));
+        CHECK_EQ(palette.count, 1u);
+        CHECK(opaque(palette));
+        CHECK(distance(palette.swatches[0].color, color) <= 3);
+
+        // Darkening keeps the hue: the strongest channel stays strongest.
+        // Out-of-gamut darks lose some chroma, so weak channels may rise a
+        // little, but the color as a whole gets darker.
+        uint32_t primary = 0, secondary = 0;
+        palette_background_colors(palette, primary, secondary);
+        CHECK_EQ(primary, palette.swatches[0].color);
+        CHECK_EQ(secondary >> 24, 0xFFu);
+        auto sum = [](uint32_t c) { return channel(c, 16) + channel(c, 8) + channel(c, 0); };
+        if (sum(primary) > 3) CHECK(sum(secondary) < sum(primary));
+        else CHECK(sum(secondary) <= sum(primary));
+        int strongest = 16;
+        for (int shift : {8, 0}) {
+            if (channel(primary, shift) > channel(primary, strongest)) strongest = shift;
+        }
+        for (int shift = 0; shift < 24; shift += 8) CHECK(channel(secondary, shift) <= channel(secondary, strongest));
+    }
+}
+
+void test_transparency() {
+    ArtworkPalette palette;
+
+    // Fully transparent: nothing to sample, whatever the color channels say.
+    Image image(256, 256);
+    image.fill(0x00FFFFFF);
+    CHECK(!image.extract(palette));
+    CHECK(!palette.valid());
+    CHECK_EQ(palette.count, 0u);
+
+    // Clear left half is ignored; only the opaque half is counted.
+    image.fill(0, 0, 128, 256, 0x00FF0000);
+    image.fill(128, 0, 256, 256, 0xFF2030D0);
+    CHECK(image.extract(palette));
+    CHECK_EQ(palette.count, 1u);
+    CHECK_EQ(palette.total, 512u);
+    CHECK(distance(palette.swatches[0].color, 0xFF2030D0) <= 3);
+    CHECK(opaque(palette));
+
+    // Cells need at least half coverage.
+    image.fill(0x7F2030D0);
+    CHECK(!image.extract(palette));
+    image.fill(0x802030D0);
+    CHECK(image.extract(palette));
+    CHECK_EQ(palette.total, 32u * 32u);
+    CHECK(opaque(palette));
+
+    // A few opaque pixels in a transparent image average below the cutoff.
+    image.fill(0x00000000);
+    image.fill(0, 0, 4, 4, 0xFFFF0000);
+    CHECK(!image.extract(palette));
+}
+
+// Padding bytes between rows are never sampled.
+void test_stride() {
+    Image image(100, 60, 7);
+    std::fill(image.pixels.begin(), image.pixels.end(), 0xFF);  // White padding
+    image.fill(0xFF3366CC);
+    ArtworkPalette palette;
+    CHECK(image.extract(palette));
+    CHECK_EQ(palette.count, 1u);
+    CHECK(distance(palette.swatches[0].color, 0xFF3366CC) <= 3);
+}
+
+void test_degenerate() {
+    ArtworkPalette palette;
+    palette.count = 3;
+    uint8_t one[4] = {1, 2, 3, 255};
+    CHECK(extract_artwork_palette(one, 1, 1, 4, palette));
+    CHECK_EQ(palette.count, 1u);
+    CHECK_EQ(palette.total, 1u);
+
+    CHECK(!extract_artwork_palette(nullptr, 1, 1, 4, palette));
+    CHECK(!palette.valid());
+    CHECK(!extract_artwork_palette(one, 0, 1, 4, palette));
+    CHECK(!extract_artwork_palette(one, 1, -1, 4, palette));
+
+    uint32_t primary = 1, secondary = 1;
+    palette_background_colors(ArtworkPalette(), primary, secondary);
+    CHECK_EQ(primary, 0xFF000000u);
+    CHECK_EQ(secondary, 0xFF000000u);
+}
+
+// Random opaque pixels give k-means the most work: every cell differs.
+double extract_ms(int size) {
+    Image image(size, size);
+    std::mt19937 rng(size);
+    for (size_t i = 0; i < image.pixels.size(); i += 4) {
+        uint32_t v = rng();
+        image.pixels[i] = v & 0xFF;
+        image.pixels[i + 1] = v >> 8 & 0xFF;
+        image.pixels[i + 2] = v >> 16 & 0xFF;
+        image.pixels[i + 3] = 0xFF;
+    }
+    ArtworkPalette palette;
+    const int runs = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) CHECK(image.extract(palette));
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / runs;
+}
+
+void benchmark() {
+    std::printf("artwork_colors_test: noisy cover: 64x64 %.3f ms, 512x512 %.3f ms\n", extract_ms(64), extract_ms(512));
+}
+
+} // anonymous namespace
+
+int main() {
+    test_solid();
+    test_distinct_colors();
+    test_roles();
+    test_gamut();
+    test_transparency();
+    test_stride();
+    test_degenerate();
+    benchmark();
+    return nowbar_test::test_result("artwork_colors_test");
+}
@@ -0,0 +1,243 @@
+// ArtworkCacheFile: encode/decode round trips through the public API,
+// truncation at every byte offset, corrupted records, and LRU eviction
+// under the size cap.
+#include "test_util.h"
+#include "artwork_store.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+constexpr uint64_t HEADER_BYTES = 64;
+constexpr uint64_t RECORD_HEADER_BYTES = 64;
+constexpr uint64_t LAST_USED_OFFSET = 24;  // RecordHeader::last_used, not checksummed
+
+// Mixes runs, gradients and noise so every QOI-style op is exercised.
+ArtworkDerivatives make_artwork(int width, int height, int seed, int blur_size) {
+    ArtworkDerivatives d;
+    d.width = width;
+    d.height = height;
+    d.pixels.resize(static_cast<size_t>(width) * height * 4);
+    std::mt19937 rng(seed);
+    for (size_t i = 0; i < d.pixels.size(); i++) {
+        size_t pixel = i / 4;
+        if (pixel % 7 == 0) d.pixels[i] = static_cast<uint8_t>(rng());
+        else if (pixel % 5 == 0) d.pixels[i] = static_cast<uint8_t>(seed);  // Runs and index hits
+        else d.pixels[i] = static_cast<uint8_t>(pixel / 10 + seed);        // Small deltas
+    }
+    d.primary = 0xff112233u + seed;
+    d.secondary = 0x80aabbccu;
+    d.colors_valid = seed & 1;
+    d.palette.count = 2;
+    d.palette.total = 9;
+    d.palette.swatches[0] = {0xff336699u, 5};
+    d.palette.swatches[1] = {0xff00ff00u + static_cast<uint32_t>(seed), 4};
+    d.palette.dominant = 0;
+    d.palette.vibrant = 1;
+    d.blur_size = blur_size;
+    d.blur_radius = blur_size ? 3 : 0;
+    d.blur.resize(static_cast<size_t>(blur_size) * blur_size * 4);
+    for (size_t i = 0; i < d.blur.size(); i++) d.blur[i] = static_cast<uint8_t>(i * 3 + seed);
+    return d;
+}
+
+bool same(const ArtworkDerivatives& a, const ArtworkDerivatives& b) {
+    return a.width == b.width && a.height == b.height && a.pixels == b.pixels && a.primary == b.primary &&
+           a.secondary == b.secondary && a.colors_valid == b.colors_valid && a.blur_size == b.blur_size &&
+           a.blur_radius == b.blur_radius && a.blur == b.blur &&
+           memcmp(&a.palette, &b.palette, sizeof(a.palette)) == 0;
+}
+
+std::string key(int i) {
+    return artwork_content_key(&i, sizeof(i));
+}
+
+std::vector<char> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const char* data, size_t size) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data, static_cast<std::streamsize>(size));
+}
+
+void test_round_trip(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("roundtrip.db");
+    {
+        ArtworkCacheFile cache(4u << 20);
+        CHECK(cache.open(path));
+        for (int i = 0; i < 5; i++) CHECK(cache.store(key(i), make_artwork(100 + i, 80, i, i ? 64 : 0)));
+        ArtworkDerivatives out;
+        for (int i = 0; i < 5; i++) CHECK(cache.lookup(key(i), out) && same(out, make_artwork(100 + i, 80, i, i ? 64 : 0)));
+        CHECK(!cache.lookup(key(99), out));
+        CHECK(!cache.lookup("short key", out));
+        CHECK(cache.file_bytes() < 5u * 100 * 80 * 4);  // Compressed below raw size
+
+        // Overwriting a key supersedes the old record.
+        CHECK(cache.store(key(2), make_artwork(50, 50, 9, 64)));
+        CHECK(cache.lookup(key(2), out) && same(out, make_artwork(50, 50, 9, 64)));
+        CHECK_EQ(cache.entry_count(), 5u);
+
+        // Degenerate sizes: nothing to store, and a single pixel.
+        ArtworkDerivatives empty;
+        CHECK(!cache.store(key(10), empty));
+        CHECK(cache.store(key(11), make_artwork(1, 1, 3, 1)));
+        CHECK(cache.lookup(key(11), out) && same(out, make_artwork(1, 1, 3, 1)));
+    }
+
+    // Everything survives a reopen.
+    ArtworkCacheFile cache(4u << 20);
+    CHECK(cache.open(path));
+    CHECK_EQ(cache.entry_count(), 6u);
+    ArtworkDerivatives out;
+    CHECK(cache.lookup(key(2), out) && same(out, make_artwork(50, 50, 9, 64)));
+    CHECK(cache.lookup(key(4), out) && same(out, make_artwork(104, 80, 4, 64)));
+}
+
+// Cut the file at every byte offset up to its data end: open must succeed
+// and exactly the records lying wholly before the cut must be found, with
+// their exact contents.
+void test_truncation(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("truncated.db");
+    const int count = 6;
+    std::vector<uint64_t> record_end;
+    {
+        ArtworkCacheFile cache(4u << 20);
+        CHECK(cache.open(path));
+        for (int i = 0; i < count; i++) {
+            CHECK(cache.store(key(i), make_artwork(12 + i, 10, i, 8)));
+            record_end.push_back(cache.file_bytes());
+        }
+    }
+    std::vector<char> full = read_file(path);
+    CHECK(full.size() >= record_end.back());
+
+    int failed_offsets = 0;
+    for (uint64_t cut = 0; cut <= record_end.back(); cut++) {
+        write_file(path, full.data(), cut);
+        ArtworkCacheFile cache(4u << 20);
+        if (!CHECK(cache.open(path))) break;
+        int expected = 0;
+        while (cut >= HEADER_BYTES && expected < count && record_end[expected] <= cut) expected++;
+
+        bool ok = cache.entry_count() == static_cast<uint32_t>(expected);
+        ArtworkDerivatives out;
+        for (int i = 0; i < count && ok; i++) {
+            bool found = cache.lookup(key(i), out);
+            ok = found == (i < expected) && (!found || same(out, make_artwork(12 + i, 10, i, 8)));
+        }
+        if (!ok && failed_offsets++ < 5) std::fprintf(stderr, "truncated at %llu\n", (unsigned long long)cut);
+    }
+    CHECK_EQ(failed_offsets, 0);
+
+    // A header whose end offset points past a torn last record.
+    write_file(path, full.data(), full.size());
+    std::vector<char> torn = full;
+    uint64_t data_end = record_end.back() + 200;
+    memcpy(&torn[8], &data_end, sizeof(data_end));
+    write_file(path, torn.data(), torn.size());
+    ArtworkCacheFile cache(4u << 20);
+    CHECK(cache.open(path));
+    CHECK_EQ(cache.entry_count(), static_cast<uint32_t>(count));
+}
+
+// Flip every byte of one record in turn. A lookup may miss, but never
+// returns different data, and records before it are unaffected.
+void test_corruption(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("corrupt.db");
+    std::vector<uint64_t> record_end;
+    {
+        ArtworkCacheFile cache(4u << 20);
+        CHECK(cache.open(path));
+        for (int i = 0; i < 3; i++) {
+            CHECK(cache.store(key(i), make_artwork(16, 12, i, 8)));
+            record_end.push_back(cache.file_bytes());
+        }
+    }
+    std::vector<char> image = read_file(path);
+    const uint64_t begin = record_end[0], end = record_end[1];
+
+    int wrong = 0, missed = 0, lost_neighbour = 0;
+    for (uint64_t offset = begin; offset < end; offset++) {
+        std::vector<char> bad = image;
+        bad[offset] ^= 0x5a;
+        write_file(path, bad.data(), bad.size());
+        ArtworkCacheFile cache(4u << 20);
+        if (!CHECK(cache.open(path))) break;
+        ArtworkDerivatives out;
+        if (!cache.lookup(key(0), out) || !same(out, make_artwork(16, 12, 0, 8))) lost_neighbour++;
+        if (cache.lookup(key(1), out)) {
+            if (!same(out, make_artwork(16, 12, 1, 8))) wrong++;
+        } else {
+            missed++;
+            uint64_t field = offset - begin;
+            bool unchecked = field >= LAST_USED_OFFSET && field < LAST_USED_OFFSET + 8;
+            if (unchecked) wrong++;  // The use stamp alone must not invalidate a record
+        }
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(lost_neighbour, 0);
+    CHECK(missed >= static_cast<int>(end - begin - 8 - RECORD_HEADER_BYTES));  // Every payload byte counts
+
+    // A garbage file header starts over.
+    image[0] = 'X';
+    write_file(path, image.data(), image.size());
+    ArtworkCacheFile cache(4u << 20);
+    CHECK(cache.open(path));
+    CHECK_EQ(cache.entry_count(), 0u);
+}
+
+// Under a 300 KB cap the file never grows past it, the most recently used
+// records survive compaction and the least recently used are evicted.
+void test_eviction(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("evict.db");
+    const uint64_t cap = 300u << 10;
+    ArtworkCacheFile cache(cap);
+    CHECK(cache.open(path));
+    ArtworkDerivatives out;
+    int over_cap = 0;
+    for (int i = 0; i < 40; i++) {
+        CHECK(cache.store(key(i), make_artwork(120, 120, i, 32)));
+        if (i > 0) CHECK(cache.lookup(key(0), out));  // Keep 0 hot
+        if (cache.file_bytes() > cap || std::filesystem::file_size(path) > cap) over_cap++;
+    }
+    CHECK_EQ(over_cap, 0);
+    CHECK(cache.entry_count() < 40u);
+    CHECK(cache.lookup(key(0), out) && same(out, make_artwork(120, 120, 0, 32)));
+    CHECK(cache.lookup(key(39), out) && same(out, make_artwork(120, 120, 39, 32)));
+    CHECK(!cache.lookup(key(1), out));
+    CHECK(!std::filesystem::exists(path + ".tmp"));
+
+    // Survivors are intact after reopening the compacted file.
+    uint32_t survivors = cache.entry_count();
+    cache.close();
+    ArtworkCacheFile reopened(cap);
+    CHECK(reopened.open(path));
+    CHECK_EQ(reopened.entry_count(), survivors);
+    CHECK(reopened.lookup(key(39), out) && same(out, make_artwork(120, 120, 39, 32)));
+
+    // A record larger than the cap is refused; a zero cap stores nothing.
+    reopened.set_capacity(4096);
+    CHECK(!reopened.store(key(100), make_artwork(120, 120, 100, 32)));
+    reopened.set_capacity(0);
+    CHECK(!reopened.store(key(101), make_artwork(10, 10, 1, 0)));
+}
+
+} // anonymous namespace
+
+int main() {
+    nowbar_test::TempDir dir("artwork_store");
+    test_round_trip(dir);
+    test_truncation(dir);
+    test_corruption(dir);
+    test_eviction(dir);
+    return nowbar_test::test_result("artwork_store_test");
+}
@@ -0,0 +1,150 @@
+// DebouncedWorker: only the latest request runs, running work is flagged
+// by newer requests, cancel and destroy never wait, requests never overlap,
+// and wait_all() bounds the wait for work stuck in I/O (clean under TSan).
+#include "test_util.h"
+#include "debounced_worker.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace nowbar;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Poll until cond holds or two seconds pass.
+template <typename Cond>
+bool eventually(Cond cond) {
+    for (int i = 0; i < 2000; i++) {
+        if (cond()) return true;
+        std::this_thread::sleep_for(1ms);
+    }
+    return cond();
+}
+
+void test_latest_wins() {
+    DebouncedWorker worker(30ms);
+    std::atomic<int> last{-1}, runs{0};
+    for (int i = 0; i < 50; i++) {
+        worker.post([&, i](const std::atomic<bool>&) {
+            runs++;
+            last = i;
+        });
+        std::this_thread::sleep_for(1ms);
+    }
+    CHECK(eventually([&]() { return worker.run_count() == 1; }));
+    std::this_thread::sleep_for(50ms);
+    CHECK_EQ(runs.load(), 1);
+    CHECK_EQ(last.load(), 49);
+
+    // Posts spaced past the quiet period all run.
+    DebouncedWorker spaced(5ms);
+    std::atomic<int> spaced_runs{0};
+    for (int i = 0; i < 5; i++) {
+        spaced.post([&](const std::atomic<bool>&) { spaced_runs++; });
+        CHECK(eventually([&]() { return spaced_runs == i + 1; }));
+    }
+}
+
+void test_supersede_running() {
+    DebouncedWorker worker(1ms);
+    std::atomic<int> hooks{0}, stopped_early{0}, second{0};
+    std::atomic<bool> started{false};
+    worker.post(
+        [&](const std::atomic<bool>& cancelled) {
+            started = true;
+            for (int i = 0; i < 2000 && !cancelled; i++) std::this_thread::sleep_for(1ms);
+            if (cancelled) stopped_early++;
+        },
+        [&]() { hooks++; });
+    CHECK(eventually([&]() { return started.load(); }));
+    worker.post([&](const std::atomic<bool>&) { second += 1; });
+    worker.post([&](const std::atomic<bool>&) { second += 10; });
+    CHECK(eventually([&]() { return second != 0; }));
+    CHECK_EQ(hooks.load(), 1);
+    CHECK_EQ(stopped_early.load(), 1);
+    CHECK_EQ(second.load(), 10);
+}
+
+void test_cancel_and_destroy() {
+    DebouncedWorker worker(20ms);
+    std::atomic<int> runs{0};
+    worker.post([&](const std::atomic<bool>&) { runs++; });
+    worker.cancel();
+    std::this_thread::sleep_for(50ms);
+    CHECK_EQ(runs.load(), 0);
+    worker.post([&](const std::atomic<bool>&) { runs++; });
+    CHECK(eventually([&]() { return runs == 1; }));
+
+    // Destroying a worker flags its running request and returns at once.
+    std::atomic<int> hooks{0};
+    auto finished = std::make_shared<std::atomic<bool>>(false);
+    {
+        DebouncedWorker doomed(1ms);
+        doomed.post(
+            [finished](const std::atomic<bool>& cancelled) {
+                while (!cancelled) std::this_thread::sleep_for(1ms);
+                *finished = true;
+            },
+            [&]() { hooks++; });
+        CHECK(eventually([]() { return DebouncedWorker::running_count() == 1; }));
+    }
+    CHECK_EQ(hooks.load(), 1);
+    CHECK(eventually([&]() { return finished->load(); }));
+}
+
+void test_sequential() {
+    DebouncedWorker worker(0ms);
+    std::atomic<int> inside{0}, overlap{0};
+    for (int i = 0; i < 200; i++) {
+        worker.post([&](const std::atomic<bool>&) {
+            if (inside++) overlap++;
+            std::this_thread::sleep_for(100us);
+            inside--;
+        });
+        if (i % 3 == 0) std::this_thread::sleep_for(200us);
+    }
+    CHECK(DebouncedWorker::wait_all(2000ms));
+    CHECK_EQ(overlap.load(), 0);
+    CHECK(worker.run_count() > 0);
+}
+
+// The shutdown pattern: cancel, fire the I/O abort, then a bounded wait.
+// Work that ignores both makes wait_all() give up instead of hanging.
+void test_wait_all() {
+    CHECK(DebouncedWorker::wait_all(0ms));  // Nothing running
+
+    std::atomic<bool> io_aborted{false};
+    std::atomic<bool> release{false};
+    DebouncedWorker reader(1ms);
+    DebouncedWorker stubborn(1ms);
+    reader.post([&](const std::atomic<bool>&) {
+        while (!io_aborted) std::this_thread::sleep_for(1ms);  // Blocking read
+    });
+    stubborn.post([&](const std::atomic<bool>&) {
+        while (!release) std::this_thread::sleep_for(1ms);
+    });
+    CHECK(eventually([]() { return DebouncedWorker::running_count() == 2; }));
+
+    reader.cancel();
+    stubborn.cancel();
+    CHECK(!DebouncedWorker::wait_all(20ms));  // Flags alone do not unblock I/O
+    io_aborted = true;
+    CHECK(eventually([]() { return DebouncedWorker::running_count() == 1; }));
+    CHECK(!DebouncedWorker::wait_all(20ms));
+    release = true;
+    CHECK(DebouncedWorker::wait_all(2000ms));
+    CHECK_EQ(DebouncedWorker::running_count(), 0);
+}
+
+} // anonymous namespace
+
+int main() {
+    test_latest_wins();
+    test_supersede_running();
+    test_cancel_and_destroy();
+    test_sequential();
+    test_wait_all();
+    return nowbar_test::test_result("debounced_worker_test");
+}
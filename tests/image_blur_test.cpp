@@ -0,0 +1,144 @@
+// blur_bgra() golden test: every output byte matches an integer reference
+// box blur (rows then columns each pass, border pixel repeated, averages
+// rounded half up) across sizes, radii wider than the image, pass counts
+// and padded strides. Built twice, with the SSE2 path and with
+// NOWBAR_NO_SIMD for the scalar one. Also prints the time for a cover-sized
+// blur at a small and a large radius, which should be about the same.
+#include "test_util.h"
+#include "image_blur.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+#ifdef NOWBAR_NO_SIMD
+const char* const TEST_NAME = "image_blur_scalar_test";
+#else
+const char* const TEST_NAME = "image_blur_test";
+#endif
+
+// One pass along count values spaced step apart, in place.
+void reference_line(uint8_t* line, ptrdiff_t step, int count, int radius) {
+    std::vector<int> src(count);
+    for (int i = 0; i < count; i++) src[i] = line[i * step];
+    const int window = 2 * radius + 1;
+    for (int i = 0; i < count; i++) {
+        int sum = 0;
+        for (int k = i - radius; k <= i + radius; k++) sum += src[std::clamp(k, 0, count - 1)];
+        line[i * step] = static_cast<uint8_t>((2 * sum + window) / (2 * window));
+    }
+}
+
+void reference_blur(uint8_t* pixels, int width, int height, ptrdiff_t stride, int radius, int passes) {
+    for (int pass = 0; pass < passes; pass++) {
+        for (int y = 0; y < height; y++) {
+            for (int c = 0; c < 4; c++) reference_line(pixels + y * stride + c, 4, width, radius);
+        }
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 4; c++) reference_line(pixels + x * 4 + c, stride, height, radius);
+        }
+    }
+}
+
+std::vector<uint8_t> noise(size_t bytes, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> pixels(bytes);
+    for (auto& v : pixels) v = static_cast<uint8_t>(rng());
+    return pixels;
+}
+
+void test_golden() {
+    const int cases[][4] = {
+        // width, height, radius, passes
+        {1, 1, 1, 1},  {1, 9, 2, 3},  {9, 1, 2, 3},   {16, 16, 1, 1}, {33, 17, 3, 3},
+        {64, 48, 8, 3}, {5, 7, 20, 2}, {40, 3, 100, 1}, {128, 96, 31, 2}, {17, 29, 4, 5},
+    };
+    unsigned seed = 1;
+    for (const auto& c : cases) {
+        int width = c[0], height = c[1], radius = c[2], passes = c[3];
+        for (int pad : {0, 3}) {
+            ptrdiff_t stride = static_cast<ptrdiff_t>(width + pad) * 4;
+            std::vector<uint8_t> pixels = noise(stride * height, seed++);
+            std::vector<uint8_t> expected = pixels;
+            reference_blur(expected.data(), width, height, stride, radius, passes);
+            CHECK(blur_bgra(pixels.data(), width, height, stride, radius, passes));
+            // Padding is never written, so whole buffers compare equal.
+            CHECK(pixels == expected);
+        }
+    }
+
+    // Saturated input: the largest sums must still round correctly.
+    std::vector<uint8_t> white(32 * 32 * 4, 0xFF);
+    CHECK(blur_bgra(white.data(), 32, 32, 32 * 4, 50, 3));
+    CHECK(std::all_of(white.begin(), white.end(), [](uint8_t v) { return v == 0xFF; }));
+
+    // Default is three passes.
+    std::vector<uint8_t> pixels = noise(24 * 20 * 4, 99);
+    std::vector<uint8_t> expected = pixels;
+    reference_blur(expected.data(), 24, 20, 24 * 4, 3, 3);
+    CHECK(blur_bgra(pixels.data(), 24, 20, 24 * 4, 3));
+    CHECK(pixels == expected);
+}
+
+// Channels are independent: a hard alpha edge does not bleed into color.
+void test_channels() {
+    const int width = 20, height = 4;
+    std::vector<uint8_t> pixels(width * height * 4);
+    for (int i = 0; i < width * height; i++) {
+        uint8_t* p = &pixels[i * 4];
+        p[0] = 10;
+        p[1] = 200;
+        p[2] = 77;
+        p[3] = (i % width) < width / 2 ? 0 : 255;
+    }
+    CHECK(blur_bgra(pixels.data(), width, height, width * 4, 3));
+    bool colors_kept = true, alpha_blended = false;
+    for (int i = 0; i < width * height; i++) {
+        const uint8_t* p = &pixels[i * 4];
+        colors_kept &= p[0] == 10 && p[1] == 200 && p[2] == 77;
+        alpha_blended |= p[3] != 0 && p[3] != 255;
+    }
+    CHECK(colors_kept);
+    CHECK(alpha_blended);
+}
+
+void test_invalid() {
+    std::vector<uint8_t> pixels = noise(8 * 8 * 4, 7);
+    const std::vector<uint8_t> original = pixels;
+    CHECK(!blur_bgra(nullptr, 8, 8, 32, 2));
+    CHECK(!blur_bgra(pixels.data(), 0, 8, 32, 2));
+    CHECK(!blur_bgra(pixels.data(), 8, -1, 32, 2));
+    CHECK(!blur_bgra(pixels.data(), 8, 8, 32, 0));
+    CHECK(!blur_bgra(pixels.data(), 8, 8, 32, 2, 0));
+    CHECK(pixels == original);
+}
+
+double blur_ms(int size, int radius) {
+    std::vector<uint8_t> pixels = noise(static_cast<size_t>(size) * size * 4, 5);
+    const int runs = 5;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) blur_bgra(pixels.data(), size, size, size * 4, radius);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / runs;
+}
+
+void benchmark() {
+    const int size = 512;
+    std::printf("%s: %dx%d, 3 passes: radius 4 %.2f ms, radius 60 %.2f ms\n", TEST_NAME, size, size,
+                blur_ms(size, 4), blur_ms(size, 60));
+}
+
+} // anonymous namespace
+
+int main() {
+    test_golden();
+    test_channels();
+    test_invalid();
+    benchmark();
+    return nowbar_test::test_result(TEST_NAME);
+}
@@ -0,0 +1,249 @@
+// resample_bgra() parity: enlarging matches a floating-point reference
+// bilinear filter, flat images stay flat at any size, padded strides are
+// honoured on both sides, and a checkerboard shrinks to even gray.
+//
+// stretch_bilinear_bgra() against a floating-point reference: odd widths
+// (the SSE2 row blend takes two pixels at a time, so these end in the
+// scalar tail), windows reaching past the image (clamped to the edge) and
+// fractional offsets. Built twice, with the SSE2 path and with
+// NOWBAR_NO_SIMD for the scalar one. Also prints the time to stretch the
+// 64 px background blur across a 4K-wide panel.
+#include "test_util.h"
+#include "image_resample.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+#ifdef NOWBAR_NO_SIMD
+const char* const TEST_NAME = "image_resample_scalar_test";
+#else
+const char* const TEST_NAME = "image_resample_test";
+#endif
+
+// Bilinear sample at the center of output pixel (x, y), edges clamped.
+double reference_bilinear(const std::vector<uint8_t>& src, int sw, int sh, int dw, int dh, int x, int y, int c) {
+    double fx = std::clamp((x + 0.5) * sw / dw - 0.5, 0.0, sw - 1.0);
+    double fy = std::clamp((y + 0.5) * sh / dh - 0.5, 0.0, sh - 1.0);
+    int x0 = static_cast<int>(fx), y0 = static_cast<int>(fy);
+    int x1 = std::min(x0 + 1, sw - 1), y1 = std::min(y0 + 1, sh - 1);
+    double ax = fx - x0, ay = fy - y0;
+    auto at = [&](int px, int py) { return static_cast<double>(src[(py * sw + px) * 4 + c]); };
+    return (at(x0, y0) * (1 - ax) + at(x1, y0) * ax) * (1 - ay) + (at(x0, y1) * (1 - ax) + at(x1, y1) * ax) * ay;
+}
+
+std::vector<uint8_t> noise(int width, int height, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    for (auto& v : pixels) v = static_cast<uint8_t>(rng());
+    return pixels;
+}
+
+void test_reference_bilinear() {
+    const int sizes[][4] = {{13, 9, 50, 41}, {2, 2, 7, 5}, {31, 17, 32, 18}, {5, 40, 64, 41}};
+    for (const auto& size : sizes) {
+        int sw = size[0], sh = size[1], dw = size[2], dh = size[3];
+        std::vector<uint8_t> src = noise(sw, sh, 1);
+        std::vector<uint8_t> dst(static_cast<size_t>(dw) * dh * 4);
+        CHECK(resample_bgra(src.data(), sw, sh, sw * 4, dst.data(), dw, dh, dw * 4));
+        double worst = 0;
+        for (int y = 0; y < dh; y++) {
+            for (int x = 0; x < dw; x++) {
+                for (int c = 0; c < 4; c++) {
+                    double expected = reference_bilinear(src, sw, sh, dw, dh, x, y, c);
+                    worst = std::max(worst, std::fabs(dst[(y * dw + x) * 4 + c] - expected));
+                }
+            }
+        }
+        CHECK(worst <= 1.0);
+    }
+
+    // Same size is an exact copy.
+    std::vector<uint8_t> src = noise(37, 29, 2);
+    std::vector<uint8_t> dst(src.size());
+    CHECK(resample_bgra(src.data(), 37, 29, 37 * 4, dst.data(), 37, 29, 37 * 4));
+    CHECK(dst == src);
+}
+
+// Weights sum to exactly one, so flat input stays flat when enlarging and
+// when shrinking by any factor.
+void test_flat() {
+    int failures = 0;
+    for (int sw : {1, 3, 17, 512, 1000}) {
+        for (int dw : {1, 2, 7, 64, 512, 700}) {
+            int sh = sw / 2 + 1, dh = dw / 3 + 1;
+            std::vector<uint8_t> src(static_cast<size_t>(sw) * sh * 4);
+            for (size_t i = 0; i < src.size(); i++) src[i] = static_cast<uint8_t>(i % 4 * 60 + 13);
+            std::vector<uint8_t> dst(static_cast<size_t>(dw) * dh * 4, 0);
+            CHECK(resample_bgra(src.data(), sw, sh, sw * 4, dst.data(), dw, dh, dw * 4));
+            for (size_t i = 0; i < dst.size(); i++) {
+                if (dst[i] != static_cast<uint8_t>(i % 4 * 60 + 13)) {
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+    CHECK_EQ(failures, 0);
+}
+
+// Rows with padding: the padding of dst is never written and the padding
+// of src (filled with a different value) is never read.
+void test_padded_stride() {
+    const int sw = 10, sh = 10, src_stride = 64;
+    const int dw = 3, dh = 4, dst_stride = 32;
+    std::vector<uint8_t> src(src_stride * sh, 250);
+    for (int y = 0; y < sh; y++) std::fill_n(&src[y * src_stride], sw * 4, 7);
+    std::vector<uint8_t> dst(dst_stride * dh, 99);
+    CHECK(resample_bgra(src.data(), sw, sh, src_stride, dst.data(), dw, dh, dst_stride));
+    int bad = 0;
+    for (int y = 0; y < dh; y++) {
+        for (int i = 0; i < dw * 4; i++) bad += dst[y * dst_stride + i] != 7;
+        for (int i = dw * 4; i < dst_stride; i++) bad += dst[y * dst_stride + i] != 99;
+    }
+    CHECK_EQ(bad, 0);
+
+    // Enlarging a padded image matches the packed result.
+    std::vector<uint8_t> packed = noise(9, 7, 3);
+    std::vector<uint8_t> padded(48 * 7, 0xEE);
+    for (int y = 0; y < 7; y++) std::copy_n(&packed[y * 36], 36, &padded[y * 48]);
+    std::vector<uint8_t> a(20 * 15 * 4), b(20 * 15 * 4);
+    CHECK(resample_bgra(packed.data(), 9, 7, 36, a.data(), 20, 15, 80));
+    CHECK(resample_bgra(padded.data(), 9, 7, 48, b.data(), 20, 15, 80));
+    CHECK(a == b);
+
+    CHECK(!resample_bgra(nullptr, 1, 1, 4, nullptr, 1, 1, 4));
+    CHECK(!resample_bgra(src.data(), 0, 1, 4, dst.data(), 1, 1, 4));
+    CHECK(!resample_bgra(src.data(), 1, 1, 4, dst.data(), 1, -1, 4));
+}
+
+// A one-pixel checkerboard shrunk 8x averages to mid gray. GDI+ bilinear
+// (2x2 taps) would alias it to black, white or stripes.
+void test_checkerboard() {
+    const int sw = 64, sh = 64;
+    std::vector<uint8_t> src(sw * sh * 4);
+    for (int y = 0; y < sh; y++) {
+        for (int x = 0; x < sw; x++) {
+            for (int c = 0; c < 4; c++) src[(y * sw + x) * 4 + c] = ((x + y) & 1) ? 255 : 0;
+        }
+    }
+    for (int dw : {8, 5, 31}) {
+        std::vector<uint8_t> dst(dw * dw * 4);
+        CHECK(resample_bgra(src.data(), sw, sh, sw * 4, dst.data(), dw, dw, dw * 4));
+        auto [lo, hi] = std::minmax_element(dst.begin(), dst.end());
+        CHECK(*lo >= 110 && *hi <= 145);
+    }
+}
+
+// Bilinear sample at source position (sx, sy), clamped to the image, for
+// stretch_bilinear_bgra().
+double reference_stretch(const std::vector<uint8_t>& src, int sw, int sh, double sx, double sy, int c) {
+    double fx = std::clamp(sx, 0.0, sw - 1.0);
+    double fy = std::clamp(sy, 0.0, sh - 1.0);
+    int x0 = static_cast<int>(fx), y0 = static_cast<int>(fy);
+    int x1 = std::min(x0 + 1, sw - 1), y1 = std::min(y0 + 1, sh - 1);
+    double ax = fx - x0, ay = fy - y0;
+    auto at = [&](int px, int py) { return static_cast<double>(src[(py * sw + px) * 4 + c]); };
+    return (at(x0, y0) * (1 - ax) + at(x1, y0) * ax) * (1 - ay) + (at(x0, y1) * (1 - ax) + at(x1, y1) * ax) * ay;
+}
+
+// Largest difference from the reference over all of dst.
+double stretch_error(const std::vector<uint8_t>& src, int sw, int sh, double cx, double cy, double cw, double ch,
+                     int dw, int dh, int pad = 0) {
+    const ptrdiff_t stride = static_cast<ptrdiff_t>(dw + pad) * 4;
+    std::vector<uint8_t> dst(stride * dh, 0xEE);
+    if (!CHECK(stretch_bilinear_bgra(src.data(), sw, sh, sw * 4, cx, cy, cw, ch, dst.data(), dw, dh, stride))) {
+        return 255.0;
+    }
+    double worst = 0;
+    for (int y = 0; y < dh; y++) {
+        for (int x = 0; x < dw; x++) {
+            for (int c = 0; c < 4; c++) {
+                double expected = reference_stretch(src, sw, sh, cx + x * cw / dw, cy + y * ch / dh, c);
+                worst = std::max(worst, std::fabs(dst[y * stride + x * 4 + c] - expected));
+            }
+        }
+        for (ptrdiff_t i = dw * 4; i < stride; i++) {
+            if (dst[y * stride + i] != 0xEE) worst = 255.0;  // Padding written
+        }
+    }
+    return worst;
+}
+
+// Rounded 7-bit weights are off by at most 1/256 on each axis, which is
+// one level per axis on full-range noise, plus half a level of rounding.
+constexpr double STRETCH_TOLERANCE = 2.5;
+
+void test_stretch_reference() {
+    const int sizes[][4] = {
+        // Source and destination size; odd widths leave a scalar tail
+        {64, 64, 3840, 92}, {7, 5, 33, 19}, {1, 1, 9, 3}, {3, 9, 1, 1}, {9, 3, 17, 64}, {2, 2, 5, 5},
+    };
+    unsigned seed = 10;
+    for (const auto& size : sizes) {
+        int sw = size[0], sh = size[1], dw = size[2], dh = size[3];
+        std::vector<uint8_t> src = noise(sw, sh, seed++);
+        // Whole image, a fractional window inside it, and one sticking out on
+        // every side so positions clamp to the edge pixels
+        CHECK(stretch_error(src, sw, sh, 0, 0, sw, sh, dw, dh) <= STRETCH_TOLERANCE);
+        CHECK(stretch_error(src, sw, sh, 0.3, 0.7, sw * 0.55, sh * 0.45, dw, dh, 3) <= STRETCH_TOLERANCE);
+        CHECK(stretch_error(src, sw, sh, -2.5, -1.25, sw + 5.0, sh + 3.5, dw, dh) <= STRETCH_TOLERANCE);
+    }
+
+    // Far outside the image only the edge pixels are sampled
+    std::vector<uint8_t> src = noise(5, 4, 20);
+    CHECK(stretch_error(src, 5, 4, 10.0, 10.0, 3.0, 2.0, 7, 3) == 0.0);
+    CHECK(stretch_error(src, 5, 4, -50.0, -50.0, 3.0, 2.0, 7, 3) == 0.0);
+
+    // Integer positions copy source pixels exactly
+    std::vector<uint8_t> dst(5 * 4 * 4);
+    CHECK(stretch_bilinear_bgra(src.data(), 5, 4, 5 * 4, 0, 0, 5, 4, dst.data(), 5, 4, 5 * 4));
+    CHECK(dst == src);
+
+    // Flat input stays flat, including the saturated extremes
+    for (uint8_t v : {uint8_t(0), uint8_t(1), uint8_t(128), uint8_t(254), uint8_t(255)}) {
+        std::vector<uint8_t> flat(11 * 7 * 4, v);
+        std::vector<uint8_t> out(23 * 13 * 4);
+        CHECK(stretch_bilinear_bgra(flat.data(), 11, 7, 11 * 4, 0.4, 0.1, 9.3, 6.2, out.data(), 23, 13, 23 * 4));
+        CHECK(std::all_of(out.begin(), out.end(), [v](uint8_t p) { return p == v; }));
+    }
+
+    CHECK(!stretch_bilinear_bgra(nullptr, 1, 1, 4, 0, 0, 1, 1, dst.data(), 1, 1, 4));
+    CHECK(!stretch_bilinear_bgra(src.data(), 5, 4, 20, 0, 0, 0.0, 1, dst.data(), 1, 1, 4));
+    CHECK(!stretch_bilinear_bgra(src.data(), 5, 4, 20, 0, 0, 1, -1.0, dst.data(), 1, 1, 4));
+    CHECK(!stretch_bilinear_bgra(src.data(), 5, 4, 20, 0, 0, 1, 1, dst.data(), 0, 1, 4));
+}
+
+// The blurred background: a 64x64 blur stretched across a 4K-wide, 92 px
+// tall panel, best of twenty.
+void benchmark() {
+    const int sw = 64, sh = 64, dw = 3840, dh = 92;
+    std::vector<uint8_t> src = noise(sw, sh, 30);
+    std::vector<uint8_t> dst(static_cast<size_t>(dw) * dh * 4);
+    double best = 1e9;
+    for (int run = 0; run < 20; run++) {
+        auto start = std::chrono::steady_clock::now();
+        stretch_bilinear_bgra(src.data(), sw, sh, sw * 4, 0, 16.0, sw, sh / 2.0, dst.data(), dw, dh, dw * 4);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    std::printf("%s: stretch %dx%d to %dx%d: %.3f ms\n", TEST_NAME, sw, sh, dw, dh, best);
+}
+
+} // anonymous namespace
+
+int main() {
+    test_reference_bilinear();
+    test_flat();
+    test_padded_stride();
+    test_checkerboard();
+    test_stretch_reference();
+    benchmark();
+    return nowbar_test::test_result(TEST_NAME);
+}
@@ -0,0 +1,286 @@
+// KeyedJobPool: deduplication with late replay, priority order, cancelling
+// queued and running jobs, replacement of workers stuck in a cancelled job
+// and the cap on such replacements, shutdown, and a subscribe/unsubscribe stress run (clean under TSan).
+#include "test_util.h"
+#include "job_pool.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nowbar;
+using namespace std::chrono_literals;
+
+namespace {
+
+using Pool = KeyedJobPool<int>;
+
+// Poll until cond holds or two seconds pass.
+template <typename Cond>
+bool eventually(Cond cond) {
+    for (int i = 0; i < 2000; i++) {
+        if (cond()) return true;
+        std::this_thread::sleep_for(1ms);
+    }
+    return cond();
+}
+
+void test_dedup_and_replay() {
+    Pool pool(2);
+    std::atomic<int> runs{0}, a{0}, b{0};
+    std::atomic<bool> go{false};
+    auto body = [&](Pool::Job& job) {
+        runs++;
+        job.notify(1);
+        while (!go) std::this_thread::sleep_for(1ms);
+        job.notify(2);
+    };
+    auto first = pool.subscribe("k", JobPriority::NowPlaying, body, [&](const int& v) { a = v; });
+    CHECK(eventually([&]() { return a == 1; }));
+    auto second = pool.subscribe("k", JobPriority::NowPlaying, body, [&](const int& v) { b = v; });
+    CHECK_EQ(b.load(), 1);  // Latest update replayed on joining
+    go = true;
+    CHECK(eventually([&]() { return pool.pending_count() == 0; }));
+    CHECK_EQ(runs.load(), 1);
+    CHECK_EQ(a.load(), 2);
+    CHECK_EQ(b.load(), 2);
+    CHECK(pool.shutdown(1000ms));
+}
+
+void test_priority_order() {
+    Pool pool(1);
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::atomic<bool> go{false};
+    auto make = [&](std::string name) {
+        return [&, name](Pool::Job&) {
+            if (name == "block") {
+                while (!go) std::this_thread::sleep_for(1ms);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(name);
+        };
+    };
+    auto none = [](const int&) {};
+    auto s0 = pool.subscribe("block", JobPriority::NowPlaying, make("block"), none);
+    CHECK(eventually([&]() { return pool.pending_count() == 1; }));
+    std::this_thread::sleep_for(10ms);  // Let the worker take it
+    auto s1 = pool.subscribe("batch", JobPriority::Batch, make("batch"), none);
+    auto s2 = pool.subscribe("pre", JobPriority::Prefetch, make("pre"), none);
+    auto s3 = pool.subscribe("now", JobPriority::NowPlaying, make("now"), none);
+    auto s4 = pool.subscribe("batch2", JobPriority::Batch, make("batch2"), none);
+    auto s5 = pool.subscribe("batch2", JobPriority::NowPlaying, make("ignored"), none);  // Raises batch2
+    go = true;
+    CHECK(eventually([&]() { return pool.pending_count() == 0; }));
+    std::string joined;
+    for (const auto& name : order) joined += name + ",";
+    CHECK_EQ(joined, std::string("block,now,batch2,pre,batch,"));
+    CHECK(pool.shutdown(1000ms));
+}
+
+// A queued job is dropped, a running one flagged; each hook runs once and
+// no listener is called after unsubscribe() returns.
+void test_cancel() {
+    Pool pool(1);
+    std::atomic<int> hooks{0}, queued_runs{0}, after{0};
+    std::atomic<bool> left{false};
+    auto running = pool.subscribe(
+        "r", JobPriority::NowPlaying,
+        [&](Pool::Job& job) {
+            while (!job.cancelled()) job.notify(5);
+            for (int i = 0; i < 100; i++) job.notify(6);
+        },
+        [&](const int&) {
+            if (left) after++;
+        },
+        [&]() { hooks++; });
+    auto queued = pool.subscribe("q", JobPriority::NowPlaying, [&](Pool::Job&) { queued_runs++; },
+                                 [](const int&) {}, [&]() { hooks++; });
+    std::this_thread::sleep_for(10ms);
+    queued.reset();
+    CHECK_EQ(hooks.load(), 1);
+    running->unsubscribe();
+    left = true;
+    running.reset();
+    CHECK(eventually([&]() { return pool.pending_count() == 0; }));
+    CHECK_EQ(hooks.load(), 2);
+    CHECK_EQ(queued_runs.load(), 0);
+    CHECK_EQ(after.load(), 0);
+
+    // The same key afterwards is a new job.
+    std::atomic<int> reruns{0};
+    auto again = pool.subscribe("r", JobPriority::NowPlaying, [&](Pool::Job&) { reruns++; }, [](const int&) {});
+    CHECK(eventually([&]() { return reruns == 1; }));
+    again.reset();
+    CHECK_EQ(hooks.load(), 2);
+
+    // One of two subscribers leaving does not cancel.
+    std::atomic<int> got{0};
+    std::atomic<bool> go{false};
+    auto body = [&](Pool::Job& job) {
+        while (!go && !job.cancelled()) std::this_thread::sleep_for(1ms);
+        if (!job.cancelled()) job.notify(9);
+    };
+    auto x = pool.subscribe("shared", JobPriority::Batch, body, [](const int&) {}, [&]() { hooks++; });
+    auto y = pool.subscribe("shared", JobPriority::Batch, body, [&](const int& v) { got = v; });
+    x.reset();
+    go = true;
+    CHECK(eventually([&]() { return got == 9; }));
+    CHECK_EQ(hooks.load(), 2);
+    CHECK(pool.shutdown(1000ms));
+}
+
+// A cancelled job stuck in "blocking I/O" (ignoring its flag) must not hold
+// the only worker: queued and later jobs still run, and once the stuck job
+// returns the pool is back to one job at a time.
+void test_stuck_worker_replaced() {
+    Pool pool(1);
+    std::atomic<bool> release{false};
+    std::atomic<bool> stuck_done{false};
+    auto stuck = pool.subscribe("stuck", JobPriority::NowPlaying,
+                                [&](Pool::Job&) {
+                                    while (!release) std::this_thread::sleep_for(1ms);
+                                    stuck_done = true;
+                                },
+                                [](const int&) {});
+    std::this_thread::sleep_for(10ms);
+
+    std::atomic<int> runs{0};
+    auto waiting = pool.subscribe("waiting", JobPriority::NowPlaying, [&](Pool::Job&) { runs++; },
+                                  [](const int&) {});
+    std::this_thread::sleep_for(20ms);
+    CHECK_EQ(runs.load(), 0);  // Only worker busy
+
+    stuck.reset();  // Cancelled while running: a replacement takes the queue
+    CHECK(eventually([&]() { return runs == 1; }));
+    auto later = pool.subscribe("later", JobPriority::NowPlaying, [&](Pool::Job&) { runs++; }, [](const int&) {});
+    CHECK(eventually([&]() { return runs == 2; }));
+    CHECK(!stuck_done);
+
+    release = true;
+    CHECK(eventually([&]() { return stuck_done.load(); }));
+
+    // Back to the limit: never more than one body at a time.
+    std::atomic<int> concurrent{0}, peak{0}, finished{0};
+    std::vector<Pool::SubscriptionPtr> subs;
+    for (int i = 0; i < 20; i++) {
+        subs.push_back(pool.subscribe(std::string("c").append(std::to_string(i)), JobPriority::Batch,
+                                      [&](Pool::Job&) {
+                                          int now = ++concurrent;
+                                          int seen = peak.load();
+                                          while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+                                          }
+                                          std::this_thread::sleep_for(1ms);
+                                          concurrent--;
+                                          finished++;
+                                      },
+                                      [](const int&) {}));
+    }
+    CHECK(eventually([&]() { return finished == 20; }));
+    CHECK_EQ(peak.load(), 1);
+    CHECK(pool.shutdown(1000ms));
+}
+
+// Every job hangs and is cancelled: replacements stop at the hard cap
+// instead of adding a thread per cancelled job, and once the hung jobs
+// return the queue drains on the normal workers.
+void test_stuck_workers_capped() {
+    const unsigned limit = 2;
+    const unsigned cap = limit + Pool::MAX_EXTRA_WORKERS;
+    Pool pool(limit);
+    std::atomic<bool> release{false};
+    std::atomic<int> started{0}, finished{0};
+    auto hang = [&](Pool::Job&) {
+        started++;
+        while (!release) std::this_thread::sleep_for(1ms);
+        finished++;
+    };
+    const int count = 20;
+    for (int i = 0; i < count; i++) {
+        auto sub = pool.subscribe(std::string("h").append(std::to_string(i)), JobPriority::NowPlaying, hang,
+                                  [](const int&) {});
+        std::this_thread::sleep_for(2ms);
+        sub.reset();  // Cancelled, running or not
+        CHECK(pool.worker_count() <= cap);
+    }
+
+    // Queued work while every worker is stuck waits instead of growing the pool.
+    std::atomic<int> runs{0};
+    std::vector<Pool::SubscriptionPtr> subs;
+    for (int i = 0; i < 10; i++) {
+        subs.push_back(pool.subscribe(std::string("w").append(std::to_string(i)), JobPriority::NowPlaying,
+                                      [&](Pool::Job&) { runs++; }, [](const int&) {}));
+    }
+    CHECK(eventually([&]() { return started.load() == static_cast<int>(cap); }));
+    std::this_thread::sleep_for(20ms);
+    CHECK_EQ(pool.worker_count(), cap);
+    CHECK_EQ(runs.load(), 0);
+
+    release = true;
+    CHECK(eventually([&]() { return runs == 10; }));
+    CHECK(eventually([&]() { return pool.worker_count() <= limit; }));
+    CHECK_EQ(finished.load(), started.load());
+    CHECK(pool.shutdown(1000ms));
+}
+
+void test_shutdown() {
+    Pool pool(1);
+    std::atomic<int> hooks{0};
+    std::atomic<bool> release{false};
+    auto sub = pool.subscribe(
+        "k", JobPriority::Batch, [&](Pool::Job& job) { while (!job.cancelled()) std::this_thread::sleep_for(1ms); },
+        [](const int&) {}, [&]() { hooks++; });
+    std::this_thread::sleep_for(5ms);
+    CHECK(pool.shutdown(1000ms));
+    CHECK_EQ(hooks.load(), 1);
+    CHECK(!pool.subscribe("z", JobPriority::Batch, [](Pool::Job&) {}, [](const int&) {}));
+    sub.reset();
+    CHECK_EQ(hooks.load(), 1);
+
+    // A worker that ignores cancellation makes the bounded wait give up.
+    Pool stubborn(1);
+    auto stuck = stubborn.subscribe("s", JobPriority::Batch,
+                                    [&](Pool::Job&) {
+                                        while (!release) std::this_thread::sleep_for(1ms);
+                                    },
+                                    [](const int&) {});
+    std::this_thread::sleep_for(5ms);
+    CHECK(!stubborn.shutdown(20ms));
+    release = true;
+    CHECK(stubborn.shutdown(1000ms));
+}
+
+void test_stress() {
+    Pool pool(3);
+    std::atomic<int> runs{0};
+    for (int round = 0; round < 200; round++) {
+        std::vector<Pool::SubscriptionPtr> subs;
+        for (int i = 0; i < 20; i++) {
+            subs.push_back(pool.subscribe(std::to_string(i % 5), JobPriority(i % 3),
+                                          [&](Pool::Job& job) {
+                                              runs++;
+                                              job.notify(1);
+                                          },
+                                          [](const int&) {}));
+        }
+        if (round % 2) subs.clear();
+        else std::this_thread::sleep_for(1ms);
+    }
+    CHECK(pool.shutdown(1000ms));
+    CHECK(runs.load() > 0);
+}
+
+} // anonymous namespace
+
+int main() {
+    test_dedup_and_replay();
+    test_priority_order();
+    test_cancel();
+    test_stuck_worker_replaced();
+    test_stuck_workers_capped();
+    test_shutdown();
+    test_stress();
+    return nowbar_test::test_result("job_pool_test");
+}
@@ -0,0 +1,169 @@
+// StreamWaveform ring: slot filling by stream time, overlapping and gapped
+// chunks, jumps past the ring, wrap-around over many cycles, and frame
+// conservation at rates that do not divide the slot length.
+#include "test_util.h"
+#include "stream_waveform.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+constexpr uint32_t RATE = 1000;  // 100 frames per 100 ms slot
+
+bool near(double a, double b) {
+    return std::fabs(a - b) < 1e-6;
+}
+
+int filled_slots(const std::vector<WaveformSegmentStats>& history) {
+    int count = 0;
+    for (const auto& slot : history) count += slot.count > 0;
+    return count;
+}
+
+void test_fill_and_overlap() {
+    StreamWaveform wave(10, 0.1);  // One second of history
+    std::vector<WaveformSegmentStats> history;
+    wave.history(history);
+    CHECK_EQ(history.size(), 10u);
+    CHECK_EQ(filled_slots(history), 0);
+    CHECK(wave.fed_until() < 0.0);
+
+    // 0.55 s whose amplitude steps up every slot, fed in odd-sized chunks.
+    std::vector<float> frames;
+    for (int f = 0; f < 550; f++) {
+        float v = (f / 100) * 0.1f + 0.05f;
+        frames.push_back(v);
+        frames.push_back(-v);
+    }
+    for (size_t f = 0; f < 550; f += 37) {
+        size_t n = std::min<size_t>(37, 550 - f);
+        wave.add(frames.data() + f * 2, n, 2, RATE, f / static_cast<double>(RATE));
+    }
+    CHECK(near(wave.fed_until(), 0.55));
+
+    // Slots 0..4 completed and sit at the newest end, oldest first.
+    wave.history(history);
+    for (int i = 0; i < 5; i++) {
+        CHECK_EQ(history[5 + i].count, 100u);
+        CHECK(near(history[5 + i].max, i * 0.1f + 0.05f));
+    }
+    CHECK_EQ(history[4].count, 0u);
+
+    // Re-feeding 0.5..0.6 only consumes the part after 0.55.
+    uint64_t version = wave.version();
+    std::vector<float> loud(200, 0.9f);
+    wave.add(loud.data(), 100, 2, RATE, 0.5);
+    CHECK(near(wave.fed_until(), 0.6));
+    CHECK_EQ(wave.version(), version);  // Slot 5 not complete yet
+    wave.add(loud.data(), 1, 2, RATE, 0.6);
+    CHECK(wave.version() > version);
+    wave.history(history);
+    CHECK_EQ(history[9].count, 100u);
+    CHECK(near(history[9].max, 0.9f));
+
+    // A chunk entirely inside consumed time is ignored.
+    wave.add(loud.data(), 50, 2, RATE, 0.1);
+    wave.history(history);
+    CHECK_EQ(history[9].count, 100u);
+    CHECK(near(wave.fed_until(), 0.601));
+}
+
+void test_gaps_and_jumps() {
+    StreamWaveform wave(10, 0.1);
+    std::vector<WaveformSegmentStats> history;
+    std::vector<float> loud(400, 0.9f);
+    wave.add(loud.data(), 100, 2, RATE, 0.0);
+    wave.add(loud.data(), 100, 2, RATE, 0.1);
+
+    // A gap from 0.2 to 0.55 reads as empty slots.
+    wave.add(loud.data(), 50, 2, RATE, 0.55);
+    wave.add(loud.data(), 1, 2, RATE, 0.6);
+    wave.history(history);
+    CHECK_EQ(history[9].count, 50u);  // Slot 5, second half only
+    CHECK_EQ(history[8].count, 0u);
+    CHECK_EQ(history[7].count, 0u);
+    CHECK_EQ(history[6].count, 0u);
+    CHECK_EQ(history[5].count, 100u);
+    CHECK_EQ(history[4].count, 100u);
+
+    // Jumping forward past the whole ring clears it.
+    wave.add(loud.data(), 100, 2, RATE, 5.0);
+    wave.add(loud.data(), 1, 2, RATE, 5.1);
+    wave.history(history);
+    CHECK_EQ(filled_slots(history), 1);
+    CHECK_EQ(history[9].count, 100u);
+
+    // Jumping back before the ring (a seek) restarts.
+    wave.add(loud.data(), 100, 2, RATE, 0.0);
+    CHECK(near(wave.fed_until(), 0.1));
+    wave.add(loud.data(), 1, 2, RATE, 0.1);
+    wave.history(history);
+    CHECK_EQ(filled_slots(history), 1);
+
+    wave.reset();
+    wave.history(history);
+    CHECK_EQ(filled_slots(history), 0);
+    CHECK(wave.fed_until() < 0.0);
+}
+
+// Ten minutes through a one-minute ring: every slot index wraps many times
+// and history() still returns the last minute in order.
+void test_wrap_around() {
+    StreamWaveform wave(600, 0.1);
+    std::vector<float> slot(200);
+    for (int s = 0; s < 6000; s++) {
+        float v = (s % 100) / 100.0f;
+        std::fill(slot.begin(), slot.end(), v);
+        wave.add(slot.data(), 100, 2, RATE, s * 0.1);
+    }
+    wave.add(slot.data(), 1, 2, RATE, 600.0);
+    std::vector<WaveformSegmentStats> history;
+    wave.history(history);
+    int wrong = 0;
+    for (int i = 0; i < 600; i++) {
+        int s = 5400 + i;
+        if (history[i].count != 100 || !near(history[i].max, (s % 100) / 100.0f)) wrong++;
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+// 44.1 kHz slots are 4410 frames; chunks of varying size straddle slot
+// boundaries and every frame lands in exactly one slot.
+void test_frame_conservation() {
+    StreamWaveform wave(600, 0.1);
+    std::vector<float> frames(44100 * 2, 0.25f);
+    double t = 0.0;
+    uint64_t total = 0;
+    for (int i = 0; i < 300; i++) {
+        size_t n = 735 + (i % 7) * 13;
+        wave.add(frames.data(), n, 2, 44100, t);
+        t += n / 44100.0;
+        total += n;
+    }
+    wave.add(frames.data(), 1, 2, 44100, wave.fed_until());
+
+    std::vector<WaveformSegmentStats> history;
+    wave.history(history);
+    uint64_t in_history = 0;
+    int odd_slots = 0;
+    for (const auto& slot : history) {
+        in_history += slot.count;
+        if (slot.count && (slot.count < 4409 || slot.count > 4411)) odd_slots++;
+    }
+    CHECK(in_history <= total + 1);
+    CHECK(total + 1 - in_history < 4411);  // Only the pending slot is missing
+    CHECK_EQ(odd_slots, 0);
+}
+
+} // anonymous namespace
+
+int main() {
+    test_fill_and_overlap();
+    test_gaps_and_jumps();
+    test_wrap_around();
+    test_frame_conservation();
+    return nowbar_test::test_result("stream_waveform_test");
+}
@@ -0,0 +1,186 @@
+// TaskSlot stress: rapid superseding starts from several threads, with
+// bodies that ignore cancellation for a while, as a decoder blocked in I/O
+// would; coalescing onto the slot's single worker. Meant to run under TSan
+// and ASan as well (see NOWBAR_SANITIZE).
+#include "test_util.h"
+#include "task_slot.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace nowbar;
+using namespace std::chrono;
+
+namespace {
+
+// Only the last of many superseded tasks publishes; every superseded task
+// has its cancel hook run exactly once, and start() never waits.
+void test_supersede() {
+    const int count = 300;
+    std::atomic<int> published{0};
+    std::atomic<int> hooks{0};
+    std::vector<std::atomic<int>> hook_runs(count);
+    std::mutex shown_mutex;
+    int shown = -1;
+    double slowest_start_ms = 0;
+    {
+        TaskSlot slot;
+        for (int i = 0; i < count; i++) {
+            auto abort = std::make_shared<std::atomic<bool>>(false);
+            auto t0 = steady_clock::now();
+            slot.start(
+                [i, abort, &published, &shown_mutex, &shown](const TaskSlot::TaskPtr& task) {
+                    for (int c = 0; c < 50 && !abort->load(); c++) std::this_thread::sleep_for(milliseconds(1));
+                    if (task->publish([&]() {
+                            std::lock_guard<std::mutex> lock(shown_mutex);
+                            shown = i;
+                        })) {
+                        published++;
+                    }
+                },
+                [i, abort, &hooks, &hook_runs]() {
+                    abort->store(true);
+                    hook_runs[i]++;
+                    hooks++;
+                });
+            double ms = duration<double, std::milli>(steady_clock::now() - t0).count();
+            if (ms > slowest_start_ms) slowest_start_ms = ms;
+            std::this_thread::sleep_for(microseconds(100));
+        }
+        CHECK(TaskSlot::wait_all(milliseconds(5000)));
+        CHECK_EQ(hooks.load(), count - 1);
+    }
+    CHECK_EQ(published.load(), 1);
+    CHECK_EQ(shown, count - 1);
+    for (int i = 0; i < count; i++) CHECK_EQ(hook_runs[i].load(), 1);  // The slot's close cancels the last
+    CHECK(slowest_start_ms < 50.0);  // Never waits for the 50 ms body
+}
+
+// Several threads start and cancel on one slot concurrently; at most one
+// publish may win per generation and nothing publishes after close().
+void test_concurrent_starts() {
+    std::atomic<int> published{0};
+    std::atomic<int> after_close{0};
+    std::atomic<bool> closed{false};
+    {
+        TaskSlot slot;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&slot, &published, &after_close, &closed, t]() {
+                for (int i = 0; i < 200; i++) {
+                    if ((i + t) % 7 == 0) {
+                        slot.cancel();
+                        continue;
+                    }
+                    slot.start([&published, &after_close, &closed](const TaskSlot::TaskPtr& task) {
+                        std::this_thread::sleep_for(microseconds(50));
+                        if (task->publish([&]() {
+                                if (closed.load()) after_close++;
+                            })) {
+                            published++;
+                        }
+                    });
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        slot.close();
+        closed = true;
+        CHECK(slot.start([](const TaskSlot::TaskPtr&) {}) == nullptr);
+    }
+    CHECK(TaskSlot::wait_all(milliseconds(5000)));
+    CHECK_EQ(after_close.load(), 0);
+    CHECK(published.load() <= 4 * 200);
+}
+
+// Poll until cond holds or five seconds pass.
+template <typename Cond>
+bool eventually(Cond cond) {
+    for (int i = 0; i < 5000; i++) {
+        if (cond()) return true;
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return cond();
+}
+
+// Starts that arrive while the worker is busy coalesce: only the newest
+// one runs afterwards and bodies never overlap, since a slot has one worker.
+void test_coalesce() {
+    std::atomic<bool> release{false};
+    std::atomic<int> concurrent{0}, overlap{0}, runs{0}, last{-1};
+    {
+        TaskSlot slot;
+        auto body = [&](int i) {
+            return [&, i](const TaskSlot::TaskPtr&) {
+                if (++concurrent > 1) overlap++;
+                last = i;
+                while (i == 0 && !release.load()) std::this_thread::sleep_for(milliseconds(1));
+                concurrent--;
+                runs++;
+            };
+        };
+        slot.start(body(0));
+        CHECK(eventually([&]() { return last == 0; }));
+        for (int i = 1; i <= 50; i++) slot.start(body(i));
+        CHECK_EQ(TaskSlot::running_count(), 2);  // One running, one queued
+        release = true;
+        CHECK(eventually([&]() { return runs == 2; }));
+        std::this_thread::sleep_for(milliseconds(20));
+    }
+    CHECK(TaskSlot::wait_all(milliseconds(5000)));
+    CHECK_EQ(runs.load(), 2);
+    CHECK_EQ(last.load(), 50);
+    CHECK_EQ(overlap.load(), 0);
+
+    // Cancelled before the worker took it: the body never runs
+    std::atomic<int> cancelled_runs{0};
+    std::atomic<bool> hold{true}, holding{false};
+    {
+        TaskSlot slot;
+        slot.start([&](const TaskSlot::TaskPtr&) {
+            holding = true;
+            while (hold.load()) std::this_thread::sleep_for(milliseconds(1));
+        });
+        CHECK(eventually([&]() { return holding.load(); }));
+        slot.start([&](const TaskSlot::TaskPtr&) { cancelled_runs++; });
+        slot.cancel();
+        hold = false;
+    }
+    CHECK(TaskSlot::wait_all(milliseconds(5000)));
+    CHECK_EQ(cancelled_runs.load(), 0);
+}
+
+// A task that outlives its slot neither crashes on publish nor publishes.
+void test_outlives_slot() {
+    std::atomic<bool> release{false};
+    std::atomic<int> result{-1};
+    std::atomic<bool> started{false};
+    {
+        TaskSlot slot;
+        slot.start([&release, &result, &started](const TaskSlot::TaskPtr& task) {
+            started = true;
+            while (!release.load()) std::this_thread::sleep_for(milliseconds(1));
+            result = task->publish([]() {}) ? 1 : 0;
+        });
+        CHECK(eventually([&]() { return started.load(); }));  // Closing first would drop it unrun
+    }
+    CHECK_EQ(TaskSlot::running_count(), 1);
+    CHECK(!TaskSlot::wait_all(milliseconds(20)));  // Bounded wait gives up
+    release = true;
+    CHECK(TaskSlot::wait_all(milliseconds(5000)));
+    CHECK_EQ(result.load(), 0);
+    CHECK_EQ(TaskSlot::running_count(), 0);
+}
+
+} // anonymous namespace
+
+int main() {
+    test_supersede();
+    test_concurrent_starts();
+    test_coalesce();
+    test_outlives_slot();
+    return nowbar_test::test_result("task_slot_test");
+}
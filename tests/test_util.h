@@ -0,0 +1,59 @@
+#pragma once
+// Minimal assertion helpers for the Linux unit tests of the SDK-free core
+// modules. Each test is its own executable; a failed CHECK prints the
+// location and the test exits non-zero from test_result().
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+namespace nowbar_test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline bool check(bool ok, const char* expr, const char* file, int line) {
+    if (!ok) {
+        std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+        failures()++;
+    }
+    return ok;
+}
+
+inline int test_result(const char* name) {
+    if (failures()) {
+        std::fprintf(stderr, "%s: %d check(s) failed\n", name, failures());
+        return 1;
+    }
+    std::printf("%s: ok\n", name);
+    return 0;
+}
+
+// Scratch directory removed again when the test ends.
+class TempDir {
+public:
+    explicit TempDir(const char* name) {
+        m_path = std::filesystem::temp_directory_path() /
+                 (std::string("nowbar_") + name + "_" + std::to_string(::getpid()));
+        std::filesystem::remove_all(m_path);
+        std::filesystem::create_directories(m_path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(m_path, ec);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    std::string file(const char* name) const { return (m_path / name).string(); }
+
+private:
+    std::filesystem::path m_path;
+};
+
+} // namespace nowbar_test
+
+#define CHECK(expr) ::nowbar_test::check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) ::nowbar_test::check((a) == (b), #a " == " #b, __FILE__, __LINE__)
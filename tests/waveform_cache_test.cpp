@@ -0,0 +1,297 @@
+// WaveformCacheFile and MappedFile: hash table probing, growth, the
+// temp-file swap used by rebuilds, levels of mixed resolution and the size
+// cap.
+#include "test_util.h"
+#include "waveform_fixtures.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace nowbar;
+using namespace nowbar_test;
+
+namespace {
+
+void test_mapped_file(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("mapped.bin");
+    MappedFile file;
+    CHECK(file.open(path, 100));
+    CHECK_EQ(file.size(), 100u);
+    for (int i = 0; i < 100; i++) CHECK_EQ(file.data()[i], 0);
+    memcpy(file.data(), "nowbar", 6);
+
+    // Growing keeps the contents and zero-fills the tail.
+    CHECK(file.resize(4096));
+    CHECK_EQ(file.size(), 4096u);
+    CHECK(memcmp(file.data(), "nowbar", 6) == 0);
+    CHECK_EQ(file.data()[4095], 0);
+    CHECK(file.flush());
+    file.close();
+    CHECK(!file.is_open());
+
+    // An existing file keeps its length if min_size is smaller.
+    CHECK(file.open(path, 10));
+    CHECK_EQ(file.size(), 4096u);
+    CHECK(memcmp(file.data(), "nowbar", 6) == 0);
+    file.close();
+
+    std::string other = dir.file("other.bin");
+    { std::ofstream(other, std::ios::binary) << "replacement"; }
+    CHECK(file_exists(other));
+    CHECK(replace_file(other, path));
+    CHECK(!file_exists(other));
+    CHECK_EQ(std::filesystem::file_size(path), 11u);
+    CHECK(remove_file(path));
+    CHECK(!file_exists(path));
+}
+
+void test_probe(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("probe.db");
+    WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+    CHECK(cache.open(path));
+    CHECK_EQ(cache.entry_count(), 0u);
+
+    // 600 keys in 1024 slots give plenty of collisions and wrapped chains.
+    const int count = 600;
+    for (int k = 0; k < count; k++) CHECK(cache.store(make_id(k), 0, make_level(k)));
+    CHECK_EQ(cache.entry_count(), static_cast<uint32_t>(count));
+    CHECK_EQ(hits(cache, count), count);
+
+    // Unknown keys walk their chain to an empty slot and miss.
+    WaveformLevel level;
+    WaveformSourceId unknown = make_id(count);
+    CHECK(!cache.lookup(unknown, level));
+    CHECK(!cache.lookup_fingerprint(12345, 1, level));
+
+    // Overwriting a key reuses its slot.
+    CHECK(cache.store(make_id(3), 0, make_level(900)));
+    CHECK_EQ(cache.entry_count(), static_cast<uint32_t>(count));
+    CHECK(cache.lookup(make_id(3), level) && same_level(level, make_level(900)));
+
+    // Levels finer than the table allows, or empty ones, are refused.
+    CHECK(!cache.store(make_id(1), 0, WaveformLevel(PeakEncoding::U8, SEGMENTS + 1)));
+    CHECK(!cache.store(make_id(1), 0, WaveformLevel()));
+
+    // Everything survives a clean close and reopen in place. The overwritten
+    // payload stays in the data area until the next rebuild.
+    cache.close();
+    std::vector<char> image = read_file(path);
+    CacheLayout layout(image);
+    CHECK_EQ(layout.slot_count, 1024u);
+    CHECK_EQ(layout.data_end, (count + 1) * PAYLOAD_BYTES);
+    CHECK(image.size() >= layout.data_start() + layout.data_end);
+    WaveformCacheFile reopened(SEGMENTS, PeakEncoding::U8);
+    CHECK(reopened.open(path));
+    CHECK_EQ(reopened.entry_count(), static_cast<uint32_t>(count));
+    CHECK_EQ(hits(reopened, count) + 1, count);  // Key 3 now holds level 900
+}
+
+void test_grow(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("grow.db");
+    WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+    CHECK(cache.open(path));
+
+    // The table doubles once it passes 75% load; every entry is carried over.
+    const int count = 2000;
+    for (int k = 0; k < count; k++) CHECK(cache.store(make_id(k), 0, make_level(k)));
+    CHECK_EQ(cache.entry_count(), static_cast<uint32_t>(count));
+    CHECK_EQ(hits(cache, count), count);
+    uint64_t slots = CacheLayout(read_file(path)).slot_count;
+    CHECK(slots >= 4096);
+    CHECK((slots & (slots - 1)) == 0);
+    CHECK(static_cast<uint64_t>(count) * 4 <= slots * 3);
+    CHECK(!file_exists(path + ".tmp"));
+
+    // Compaction keeps live entries and shrinks nothing it still needs.
+    CHECK(cache.compact());
+    CHECK_EQ(cache.entry_count(), static_cast<uint32_t>(count));
+    CHECK_EQ(hits(cache, count), count);
+}
+
+void test_replace_through_tmp(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("swap.db");
+    std::string tmp = path + ".tmp";
+
+    // A leftover temp file from an interrupted rebuild is simply overwritten.
+    { std::ofstream(tmp, std::ios::binary) << "leftover from a crash"; }
+    WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+    CHECK(cache.open(path));
+    for (int k = 0; k < 100; k++) CHECK(cache.store(make_id(k), 0, make_level(k)));
+    CHECK(cache.compact());
+    CHECK(!file_exists(tmp));
+    CHECK_EQ(hits(cache, 100), 100);
+    cache.close();
+
+    // A different encoding is converted through the temp file on open and
+    // the original path ends up holding the converted table.
+    {
+        WaveformCacheFile wide(SEGMENTS, PeakEncoding::U16);
+        CHECK(wide.open(path));
+        CHECK(!file_exists(tmp));
+        CHECK_EQ(wide.entry_count(), 100u);
+        WaveformLevel level;
+        CHECK(wide.lookup(make_id(42), level));
+        CHECK(level.encoding() == PeakEncoding::U16);
+        CHECK(same_level(level.converted(PeakEncoding::U8), make_level(42)));
+    }
+    std::vector<char> image = read_file(path);
+    CHECK_EQ(CacheLayout(image).data_end, 100 * PAYLOAD_BYTES * 2);
+
+    // A temp table left half written by a crash does not disturb the live one.
+    { std::ofstream(tmp, std::ios::binary) << "half written"; }
+    WaveformCacheFile reopened(SEGMENTS, PeakEncoding::U16);
+    CHECK(reopened.open(path));
+    CHECK_EQ(reopened.entry_count(), 100u);
+}
+
+// Encodings other than U8 and U16 (0 was the old float format) are not
+// read; such a table starts over.
+void test_unknown_encoding(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("encoding.db");
+    {
+        WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+        CHECK(cache.open(path));
+        for (int k = 0; k < 10; k++) CHECK(cache.store(make_id(k), 0, make_level(k)));
+    }
+    for (uint8_t encoding : {0, 3}) {
+        std::vector<char> image = read_file(path);
+        image[28] = static_cast<char>(encoding);  // FileHeader::encoding
+        write_file(path, image.data(), image.size());
+        WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+        CHECK(cache.open(path));
+        CHECK_EQ(cache.entry_count(), 0u);
+    }
+}
+
+// A record holds whatever level it was given, from one segment up to the
+// table's segment count, and a finer store replaces a coarser one.
+void test_mixed_resolution(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("mixed.db");
+    WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+    CHECK(cache.open(path));
+    auto level_of = [](int k, uint32_t segments) {
+        WaveformLevel level(PeakEncoding::U8, segments);
+        for (uint32_t i = 0; i < segments; i++) level.peak_max.set(i, ((k + i) % 256) / 255.0f);
+        level.loudness = -7.5f;
+        return level;
+    };
+    for (uint32_t segments : {1u, 3u, 8u, SEGMENTS}) {
+        CHECK(cache.store(make_id(static_cast<int>(segments)), 0, level_of(1, segments)));
+    }
+    CHECK(cache.store(make_id(8), 0, level_of(2, SEGMENTS)));  // Refined
+
+    cache.close();
+    WaveformCacheFile reopened(SEGMENTS, PeakEncoding::U8);
+    CHECK(reopened.open(path));
+    for (uint32_t segments : {1u, 3u, SEGMENTS}) {
+        WaveformLevel level;
+        CHECK(reopened.lookup(make_id(static_cast<int>(segments)), level));
+        CHECK(same_level(level, level_of(1, segments)));
+        CHECK_EQ(level.loudness, -7.5f);
+    }
+    WaveformLevel refined;
+    CHECK(reopened.lookup(make_id(8), refined) && same_level(refined, level_of(2, SEGMENTS)));
+
+    // Compaction drops the replaced payload. Payloads are padded to 8 bytes.
+    CHECK(reopened.compact());
+    reopened.close();
+    CHECK_EQ(CacheLayout(read_file(path)).data_end, 8u + 16u + 2 * PAYLOAD_BYTES);
+}
+
+// Aliases take a small slot of their own rather than a second copy of the
+// record, so a fingerprinted entry costs little more than a plain one.
+void test_alias_size(const nowbar_test::TempDir& dir) {
+    std::string plain_path = dir.file("plain.db");
+    std::string aliased_path = dir.file("aliased.db");
+    const int count = 3000;
+    {
+        WaveformCacheFile plain(SEGMENTS, PeakEncoding::U8);
+        WaveformCacheFile aliased(SEGMENTS, PeakEncoding::U8);
+        CHECK(plain.open(plain_path));
+        CHECK(aliased.open(aliased_path));
+        for (int k = 0; k < count; k++) {
+            CHECK(plain.store(make_id(k), 0, make_level(k)));
+            CHECK(aliased.store(make_id(k), 0x9000 + k, make_level(k)));
+        }
+        CHECK_EQ(aliased.entry_count(), static_cast<uint32_t>(count));
+        CHECK(plain.compact());
+        CHECK(aliased.compact());
+        WaveformLevel level;
+        CHECK(aliased.lookup_fingerprint(0x9000 + 17, make_id(17).file_size, level));
+        CHECK(same_level(level, make_level(17)));
+    }
+    CacheLayout layout(read_file(aliased_path));
+    CHECK_EQ(layout.data_end, count * PAYLOAD_BYTES);
+    CHECK(static_cast<uint64_t>(count) * 4 <= layout.alias_count * 3);
+    uint64_t plain_bytes = std::filesystem::file_size(plain_path);
+    uint64_t aliased_bytes = std::filesystem::file_size(aliased_path);
+    CHECK(aliased_bytes - plain_bytes <= layout.alias_count * ALIAS_BYTES);
+}
+
+// The file stays under its size cap; going over rebuilds it with the most
+// recently used records filling three quarters of the cap.
+void test_capacity(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("capped.db");
+    const uint64_t index_bytes = HEADER_BYTES + 1024 * (SLOT_BYTES + ALIAS_BYTES);
+    const uint64_t capacity = index_bytes + 200 * PAYLOAD_BYTES;
+    WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8, capacity);
+    CHECK(cache.open(path));
+    const int count = 500;
+    for (int k = 0; k < count; k++) {
+        CHECK(cache.store(make_id(k), 0, make_level(k)));
+        if (cache.file_bytes() > capacity) {
+            CHECK(false);
+            break;
+        }
+    }
+    // The newest record is always kept.
+    WaveformLevel level;
+    CHECK(cache.lookup(make_id(count - 1), level) && same_level(level, make_level(count - 1)));
+    uint32_t kept = cache.entry_count();
+    CHECK(kept > 0 && kept <= 200);
+    CHECK_EQ(static_cast<uint32_t>(hits(cache, count)), kept);
+
+    // A record larger than the whole cap is refused.
+    WaveformCacheFile tiny(SEGMENTS, PeakEncoding::U8, index_bytes);
+    CHECK(tiny.open(dir.file("tiny.db")));
+    CHECK(!tiny.store(make_id(1), 0, make_level(1)));
+}
+
+void test_memory_cache() {
+    WaveformMemoryCache cache(0);
+    WaveformLevel level = make_level(1);
+    cache.insert("a", level);
+    CHECK_EQ(cache.get_stats().entries, 0u);  // Nothing fits a zero budget
+
+    cache.set_capacity(1 << 20);
+    for (int k = 0; k < 10; k++) cache.insert(std::string("k").append(std::to_string(k)), make_level(k));
+    WaveformLevel out;
+    CHECK(cache.lookup("k0", out) && same_level(out, make_level(0)));
+    size_t one = cache.get_stats().bytes / 10;
+
+    // Shrinking to three entries keeps the most recently used ones.
+    cache.set_capacity(one * 3);
+    CHECK_EQ(cache.get_stats().entries, 3u);
+    CHECK(cache.lookup("k0", out));
+    CHECK(cache.lookup("k9", out));
+    CHECK(!cache.lookup("k1", out));
+}
+
+} // anonymous namespace
+
+int main() {
+    nowbar_test::TempDir dir("waveform_cache");
+    test_mapped_file(dir);
+    test_probe(dir);
+    test_grow(dir);
+    test_replace_through_tmp(dir);
+    test_unknown_encoding(dir);
+    test_mixed_resolution(dir);
+    test_alias_size(dir);
+    test_capacity(dir);
+    test_memory_cache();
+    return nowbar_test::test_result("waveform_cache_test");
+}
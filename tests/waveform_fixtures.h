@@ -0,0 +1,86 @@
+#pragma once
+// Waveform cache test data shared by the wavecache tests: small U8 levels
+// with distinct contents per key.
+#include "waveform_cache.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace nowbar_test {
+
+using namespace nowbar;
+
+inline constexpr uint32_t SEGMENTS = 16;
+inline constexpr uint64_t HEADER_BYTES = 64;
+inline constexpr uint64_t SLOT_BYTES = 64;
+inline constexpr uint64_t ALIAS_BYTES = 32;
+inline constexpr uint64_t PAYLOAD_BYTES = WaveformLevel::PLANES * SEGMENTS;  // U8, already 8-byte aligned
+
+inline WaveformLevel make_level(int k) {
+    WaveformLevel level(PeakEncoding::U8, SEGMENTS);
+    for (uint32_t i = 0; i < SEGMENTS; i++) {
+        level.rms.set(i, ((k * 7 + i) % 256) / 255.0f);
+        level.peak_max.set(i, ((k * 3 + i) % 256) / 255.0f);
+        level.peak_min.set(i, ((k * 5 + i) % 256) / 255.0f);
+    }
+    level.rms_scale = 0.25f + k * 0.001f;
+    return level;
+}
+
+inline WaveformSourceId make_id(int k) {
+    WaveformSourceId id;
+    id.path = "C:\\Music\\track" + std::to_string(k) + ".flac";
+    id.file_size = 1000 + k;
+    id.file_time = 5000 + k;
+    return id;
+}
+
+inline bool same_level(const WaveformLevel& a, const WaveformLevel& b) {
+    return a.size() == b.size() && a.rms_scale == b.rms_scale &&
+           memcmp(a.packed().bytes(), b.packed().bytes(), a.byte_size()) == 0;
+}
+
+// Entries 0..count-1 that are found and hold what was stored.
+inline int hits(WaveformCacheFile& cache, int count) {
+    int found = 0;
+    for (int k = 0; k < count; k++) {
+        WaveformLevel level;
+        if (cache.lookup(make_id(k), level) && same_level(level, make_level(k))) found++;
+    }
+    return found;
+}
+
+// Where the parts of a wavecache.db image lie, read from its header.
+struct CacheLayout {
+    uint32_t slot_count = 0;
+    uint32_t alias_count = 0;
+    uint64_t data_end = 0;
+
+    explicit CacheLayout(const std::vector<char>& image) {
+        memcpy(&slot_count, &image[16], sizeof(slot_count));
+        memcpy(&alias_count, &image[36], sizeof(alias_count));
+        memcpy(&data_end, &image[48], sizeof(data_end));
+    }
+    uint64_t slot_offset(uint32_t s) const { return HEADER_BYTES + s * SLOT_BYTES; }
+    uint64_t data_start() const { return HEADER_BYTES + slot_count * SLOT_BYTES + alias_count * ALIAS_BYTES; }
+    // Where the payload of the record in slot s starts.
+    uint64_t payload_offset(const std::vector<char>& image, uint32_t s) const {
+        uint32_t units;
+        memcpy(&units, &image[slot_offset(s) + 40], sizeof(units));
+        return data_start() + units * 8ull;
+    }
+};
+
+inline std::vector<char> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+inline void write_file(const std::string& path, const char* data, size_t size) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data, static_cast<std::streamsize>(size));
+}
+
+} // namespace nowbar_test
@@ -0,0 +1,131 @@
+// Waveform cache keying: stats changes, unknown stats, moved paths and
+// fingerprint mismatches, both in the key rules and through the cache.
+#include "test_util.h"
+#include "waveform_fixtures.h"
+#include <string>
+
+using namespace nowbar;
+using namespace nowbar_test;
+
+namespace {
+
+void test_key_rules() {
+    CHECK(waveform_stats_match(5, 6, 5, 6));
+    CHECK(!waveform_stats_match(5, 6, 5, 7));
+    CHECK(!waveform_stats_match(5, 6, 4, 6));
+    CHECK(waveform_stats_match(0, 0, 5, 6));  // Stored without stats
+    CHECK(waveform_stats_match(5, 6, 0, 0));  // File reports none
+    CHECK(!waveform_stats_match(5, 0, 5, 6));  // A partially known side still compares
+
+    WaveformSourceId id = make_id(1);
+    CHECK_EQ(waveform_location_key(id), id.path);  // Subsong 0 keeps the bare path
+    WaveformSourceId track2 = id;
+    track2.subsong = 2;
+    CHECK(waveform_location_key(track2) != waveform_location_key(id));
+
+    WaveformSourceId edited = id;
+    edited.file_time++;
+    CHECK_EQ(waveform_location_key(edited), waveform_location_key(id));
+    CHECK(waveform_memory_key(edited) != waveform_memory_key(id));
+
+    const char head[] = "head bytes";
+    const char tail[] = "tail bytes";
+    uint64_t fp = waveform_content_fingerprint(1000, 0, head, sizeof(head), tail, sizeof(tail));
+    CHECK(fp != 0);
+    CHECK_EQ(fp, waveform_content_fingerprint(1000, 0, head, sizeof(head), tail, sizeof(tail)));
+    CHECK(fp != waveform_content_fingerprint(1001, 0, head, sizeof(head), tail, sizeof(tail)));
+    CHECK(fp != waveform_content_fingerprint(1000, 1, head, sizeof(head), tail, sizeof(tail)));
+    CHECK(fp != waveform_content_fingerprint(1000, 0, tail, sizeof(tail), head, sizeof(head)));
+    CHECK(waveform_content_fingerprint(0, 0, nullptr, 0, nullptr, 0) != 0);
+}
+
+void test_cache_keying(const TempDir& dir) {
+    WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+    CHECK(cache.open(dir.file("keys.db")));
+
+    WaveformSourceId id = make_id(1);
+    const char head[] = "head";
+    const char tail[] = "tail";
+    uint64_t fp = waveform_content_fingerprint(id.file_size, 0, head, 4, tail, 4);
+    CHECK(cache.store(id, fp, make_level(1)));
+    CHECK_EQ(cache.entry_count(), 1u);  // Aliases are not counted
+
+    WaveformLevel level;
+    CHECK(cache.lookup(id, level) && same_level(level, make_level(1)));
+
+    // Stats changes: an edited file misses.
+    WaveformSourceId edited = id;
+    edited.file_time++;
+    CHECK(!cache.lookup(edited, level));
+    WaveformSourceId resized = id;
+    resized.file_size++;
+    CHECK(!cache.lookup(resized, level));
+
+    // Unknown stats on lookup still hit.
+    WaveformSourceId unknown = id;
+    unknown.file_size = 0;
+    unknown.file_time = 0;
+    CHECK(cache.lookup(unknown, level) && same_level(level, make_level(1)));
+
+    // A moved file misses by path but is found by content.
+    WaveformSourceId moved = id;
+    moved.path = "D:\\Archive\\track1.flac";
+    CHECK(!cache.lookup(moved, level));
+    CHECK(cache.lookup_fingerprint(fp, id.file_size, level) && same_level(level, make_level(1)));
+
+    // Fingerprint mismatches: wrong size, wrong fingerprint, or none at all.
+    CHECK(!cache.lookup_fingerprint(fp, id.file_size + 1, level));
+    CHECK(!cache.lookup_fingerprint(fp + 1, id.file_size, level));
+    CHECK(!cache.lookup_fingerprint(0, id.file_size, level));
+
+    // Re-storing after an edit replaces the record; the old alias no longer
+    // resolves because its target now holds other content.
+    CHECK(cache.store(edited, fp + 1, make_level(2)));
+    CHECK(!cache.lookup_fingerprint(fp, id.file_size, level));
+    CHECK(cache.lookup(edited, level) && same_level(level, make_level(2)));
+    CHECK(cache.lookup_fingerprint(fp + 1, edited.file_size, level) && same_level(level, make_level(2)));
+    CHECK(!cache.lookup(id, level));
+
+    // Each subsong of one image is its own entry.
+    WaveformSourceId track2 = id;
+    track2.subsong = 2;
+    CHECK(!cache.lookup(track2, level));
+    CHECK(cache.store(track2, 0, make_level(3)));
+    CHECK(cache.lookup(track2, level) && same_level(level, make_level(3)));
+    CHECK(cache.lookup(edited, level) && same_level(level, make_level(2)));
+}
+
+// A record stored while the file's stats were unknown adopts them on the
+// first lookup that knows them, after which other stats miss.
+void test_adopt_stats(const TempDir& dir) {
+    std::string path = dir.file("adopt.db");
+    WaveformSourceId id = make_id(7);
+    WaveformSourceId no_stats = id;
+    no_stats.file_size = 0;
+    no_stats.file_time = 0;
+    {
+        WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+        CHECK(cache.open(path));
+        CHECK(cache.store(no_stats, 0, make_level(7)));
+        WaveformLevel level;
+        CHECK(cache.lookup(id, level));
+        WaveformSourceId other = id;
+        other.file_time++;
+        CHECK(!cache.lookup(other, level));
+    }
+    // The adopted stats are checksummed, so the record survives a reopen.
+    WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+    CHECK(cache.open(path));
+    WaveformLevel level;
+    CHECK(cache.lookup(id, level) && same_level(level, make_level(7)));
+}
+
+} // anonymous namespace
+
+int main() {
+    TempDir dir("waveform_key");
+    test_key_rules();
+    test_cache_keying(dir);
+    test_adopt_stats(dir);
+    return test_result("waveform_key_test");
+}
@@ -0,0 +1,100 @@
+// WaveformPeaks encode/decode round trip: every value in 0..1 comes back
+// within a pixel on a 100 px bar in both encodings (well within, at half a
+// quantization step), through packing for wavecache.db and through
+// conversion between encodings. Out-of-range input is clamped.
+#include "test_util.h"
+#include "waveform_peaks.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+constexpr float BAR_HEIGHT = 100.0f;  // Pixels
+constexpr int STEPS = 100000;         // Values tried across 0..1
+
+float max_error_px(PeakEncoding enc) {
+    std::vector<float> values(STEPS + 1);
+    for (int i = 0; i <= STEPS; i++) values[i] = static_cast<float>(i) / STEPS;
+    WaveformPeaks peaks = WaveformPeaks::from_floats(values.data(), values.size(), enc);
+    float worst = 0.0f;
+    for (size_t i = 0; i < values.size(); i++) worst = std::max(worst, std::fabs(peaks[i] - values[i]) * BAR_HEIGHT);
+    return worst;
+}
+
+void test_round_trip() {
+    float u8 = max_error_px(PeakEncoding::U8);
+    float u16 = max_error_px(PeakEncoding::U16);
+    std::printf("waveform_peaks_test: worst error on a %.0f px bar: U8 %.4f px, U16 %.6f px\n", BAR_HEIGHT, u8, u16);
+    CHECK(u8 <= 1.0f);
+    CHECK(u16 <= 1.0f);
+    // Rounding to nearest: half a step at most
+    CHECK(u8 <= BAR_HEIGHT * (0.5f / 255.0f) + 1e-4f);
+    CHECK(u16 <= BAR_HEIGHT * (0.5f / 65535.0f) + 1e-4f);
+
+    // The ends are exact, so silence stays flat and full scale fills the bar
+    for (PeakEncoding enc : {PeakEncoding::U8, PeakEncoding::U16}) {
+        WaveformPeaks peaks(enc, 2);
+        peaks.set(0, 0.0f);
+        peaks.set(1, 1.0f);
+        CHECK_EQ(peaks[0], 0.0f);
+        CHECK_EQ(peaks[1], 1.0f);
+    }
+}
+
+void test_clamped() {
+    for (PeakEncoding enc : {PeakEncoding::U8, PeakEncoding::U16}) {
+        WaveformPeaks peaks(enc, 3);
+        peaks.set(0, -0.5f);
+        peaks.set(1, 1.5f);
+        peaks.set(2, 1e9f);
+        CHECK_EQ(peaks[0], 0.0f);
+        CHECK_EQ(peaks[1], 1.0f);
+        CHECK_EQ(peaks[2], 1.0f);
+    }
+}
+
+// Packing for disk and converting between encodings stay within a pixel
+// of the original value.
+void test_packed_and_converted() {
+    const size_t count = 1001;
+    WaveformLevel level(PeakEncoding::U16, count);
+    for (size_t i = 0; i < count; i++) {
+        float v = static_cast<float>(i) / (count - 1);
+        level.rms.set(i, v);
+        level.peak_max.set(i, 1.0f - v);
+        level.peak_min.set(i, std::fmod(v * 7.0f, 1.0f));
+    }
+    level.rms_scale = 0.4f;
+
+    for (PeakEncoding enc : {PeakEncoding::U8, PeakEncoding::U16}) {
+        WaveformLevel converted = level.converted(enc);
+        WaveformLevel stored = WaveformLevel::unpacked(converted.packed().bytes(), count, enc, converted.rms_scale);
+        CHECK(stored.encoding() == enc);
+        CHECK_EQ(stored.rms_scale, 0.4f);
+        float worst = 0.0f;
+        for (size_t i = 0; i < count; i++) {
+            worst = std::max({worst, std::fabs(stored.rms[i] - level.rms[i]),
+                              std::fabs(stored.peak_max[i] - level.peak_max[i]),
+                              std::fabs(stored.peak_min[i] - level.peak_min[i])});
+        }
+        CHECK(worst * BAR_HEIGHT <= 1.0f);
+    }
+
+    // U8 -> U16 -> U8 gives back the same bytes
+    WaveformLevel narrow = level.converted(PeakEncoding::U8);
+    WaveformLevel back = narrow.converted(PeakEncoding::U16).converted(PeakEncoding::U8);
+    CHECK(std::equal(narrow.rms.bytes(), narrow.rms.bytes() + narrow.rms.byte_size(), back.rms.bytes()));
+}
+
+} // anonymous namespace
+
+int main() {
+    test_round_trip();
+    test_clamped();
+    test_packed_and_converted();
+    return nowbar_test::test_result("waveform_peaks_test");
+}
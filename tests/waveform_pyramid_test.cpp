@@ -0,0 +1,99 @@
+// waveform_bar(): reducing the segments under a display bar keeps the
+// largest peaks and the mean-square RMS, every segment lands under some bar,
+// and bars narrower than a segment repeat it.
+#include "test_util.h"
+#include "waveform_pyramid.h"
+#include <cmath>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+WaveformLevel make_level(size_t count, PeakEncoding enc = PeakEncoding::U16) {
+    WaveformLevel level(enc, count);
+    for (size_t i = 0; i < count; i++) {
+        level.rms.set(i, 0.2f + 0.1f * (i % 3));
+        level.peak_max.set(i, 0.3f);
+        level.peak_min.set(i, 0.25f);
+    }
+    return level;
+}
+
+bool close(float a, float b) { return std::fabs(a - b) <= 1e-4f; }
+
+// A one-segment transient survives any number of bars, where sampling
+// between neighbours would miss it whenever no bar lands on it.
+void test_transient_kept() {
+    const size_t count = 1600;
+    WaveformLevel level = make_level(count);
+    level.peak_max.set(1234, 1.0f);
+    level.peak_min.set(777, 0.9f);
+    for (size_t bars : {7, 100, 333, 400, 799, 1600}) {
+        float hi = 0.0f, lo = 0.0f;
+        for (size_t b = 0; b < bars; b++) {
+            WaveformBar bar = waveform_bar(level, b, bars);
+            hi = std::max(hi, bar.peak_max);
+            lo = std::max(lo, bar.peak_min);
+        }
+        CHECK_EQ(hi, level.peak_max[1234]);
+        CHECK_EQ(lo, level.peak_min[777]);
+        // The bar over the transient holds it
+        CHECK_EQ(waveform_bar(level, 1234 * bars / count, bars).peak_max, level.peak_max[1234]);
+    }
+}
+
+// RMS combines on the linear scale: the curve is undone, squares averaged
+// and the curve applied again.
+void test_rms_mean_square() {
+    WaveformLevel level(PeakEncoding::U16, 4);
+    const float values[] = {0.1f, 0.9f, 0.5f, 0.5f};
+    for (size_t i = 0; i < 4; i++) level.rms.set(i, values[i]);
+    auto linear = [](float v) { return std::pow(v, 1.0f / WAVEFORM_PEAK_CURVE); };
+    float a = linear(level.rms[0]), b = linear(level.rms[1]);
+    float expected = std::pow(std::sqrt((a * a + b * b) / 2.0f), WAVEFORM_PEAK_CURVE);
+    CHECK(close(waveform_bar(level, 0, 2).rms, expected));
+    CHECK(close(waveform_bar(level, 1, 2).rms, level.rms[2]));  // Equal values stay put
+
+    // One bar over everything
+    float sum = 0.0f;
+    for (size_t i = 0; i < 4; i++) sum += linear(level.rms[i]) * linear(level.rms[i]);
+    CHECK(close(waveform_bar(level, 0, 1).rms, std::pow(std::sqrt(sum / 4.0f), WAVEFORM_PEAK_CURVE)));
+}
+
+// Bars cover every segment, and bars narrower than a segment take the one
+// under them.
+void test_coverage() {
+    const size_t count = 400;
+    WaveformLevel level = make_level(count);
+    for (size_t bars : {1, 3, 399, 401, 1000}) {
+        for (size_t s = 0; s < count; s++) {
+            WaveformLevel marked = level;
+            marked.peak_max.set(s, 1.0f);
+            size_t holding = 0;
+            for (size_t b = 0; b < bars; b++) {
+                if (waveform_bar(marked, b, bars).peak_max == 1.0f) holding++;
+            }
+            if (!CHECK(holding >= 1)) break;
+        }
+    }
+    for (size_t b = 0; b < 2 * count; b++) {
+        WaveformBar bar = waveform_bar(level, b, 2 * count);
+        CHECK(close(bar.rms, level.rms[b / 2]));
+        CHECK_EQ(bar.peak_max, level.peak_max[b / 2]);
+    }
+
+    // Nothing to reduce
+    WaveformBar none = waveform_bar(WaveformLevel(), 0, 10);
+    CHECK_EQ(none.rms, 0.0f);
+    CHECK_EQ(waveform_bar(level, 10, 10).peak_max, 0.0f);
+}
+
+} // anonymous namespace
+
+int main() {
+    test_transient_kept();
+    test_rms_mean_square();
+    test_coverage();
+    return nowbar_test::test_result("waveform_pyramid_test");
+}
@@ -0,0 +1,144 @@
+// waveform_reduce(): the stereo fast path agrees with the general one, the
+// peak envelope and per-channel statistics are exact, and chunked input
+// gives the same result as one call. Also prints what the kernel costs per
+// minute of 44.1 kHz stereo next to the RMS-only loop it replaced.
+#include "test_util.h"
+#include "waveform_reduce.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+std::vector<float> noise(size_t samples, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> out(samples);
+    for (auto& v : out) v = dist(rng);
+    return out;
+}
+
+bool close(double a, double b) { return std::fabs(a - b) <= 1e-4 * std::max(1.0, std::fabs(b)); }
+
+// The stereo loop is only taken without per-channel output; asking for it
+// runs the general loop over the same frames.
+void test_stereo_paths_agree() {
+    std::vector<float> frames = noise(2 * 5000, 1);
+    WaveformSegmentStats fast, general, channels[2];
+    waveform_reduce(frames.data(), 5000, 2, fast);
+    waveform_reduce(frames.data(), 5000, 2, general, channels);
+    CHECK_EQ(fast.min, general.min);
+    CHECK_EQ(fast.max, general.max);
+    CHECK_EQ(fast.count, general.count);
+    CHECK(close(fast.sum_sq, general.sum_sq));
+    CHECK_EQ(fast.min, std::min(channels[0].min, channels[1].min));
+    CHECK_EQ(fast.max, std::max(channels[0].max, channels[1].max));
+}
+
+void test_envelope_and_rms() {
+    // Three channels: a clipped positive spike on one, a negative one on another
+    std::vector<double> frames(3 * 100, 0.25);
+    frames[3 * 40 + 1] = 1.0;
+    frames[3 * 70 + 2] = -0.75;
+    WaveformSegmentStats mix, channels[3];
+    waveform_reduce(frames.data(), 100, 3, mix, channels);
+    CHECK_EQ(mix.max, 1.0f);
+    CHECK_EQ(mix.min, -0.75f);
+    CHECK_EQ(channels[0].max, 0.25f);
+    CHECK_EQ(channels[1].max, 1.0f);
+    CHECK_EQ(channels[2].min, -0.75f);
+    CHECK_EQ(mix.count, 100u);
+    CHECK_EQ(channels[0].count, 100u);
+    CHECK(close(channels[0].rms(), 0.25));
+
+    // Mix RMS is over the channel-averaged magnitude
+    double sum = 0.0;
+    for (size_t f = 0; f < 100; f++) {
+        double m = (std::fabs(frames[3 * f]) + std::fabs(frames[3 * f + 1]) + std::fabs(frames[3 * f + 2])) / 3.0;
+        sum += m * m;
+    }
+    CHECK(close(mix.rms(), std::sqrt(sum / 100.0)));
+
+    // Silence leaves the envelope at zero, empty input changes nothing
+    WaveformSegmentStats silent;
+    std::vector<float> zeros(64, 0.0f);
+    waveform_reduce(zeros.data(), 32, 2, silent);
+    CHECK_EQ(silent.min, 0.0f);
+    CHECK_EQ(silent.max, 0.0f);
+    CHECK_EQ(silent.rms(), 0.0f);
+    waveform_reduce(zeros.data(), 0, 2, silent);
+    waveform_reduce(zeros.data(), 8, 0, silent);
+    CHECK_EQ(silent.count, 32u);
+}
+
+void test_chunked() {
+    std::vector<float> frames = noise(2 * 10000, 2);
+    WaveformSegmentStats whole, chunked;
+    waveform_reduce(frames.data(), 10000, 2, whole);
+    for (size_t f = 0; f < 10000; f += 777) {
+        waveform_reduce(frames.data() + f * 2, std::min<size_t>(777, 10000 - f), 2, chunked);
+    }
+    CHECK_EQ(whole.min, chunked.min);
+    CHECK_EQ(whole.max, chunked.max);
+    CHECK_EQ(whole.count, chunked.count);
+    CHECK(close(whole.sum_sq, chunked.sum_sq));
+}
+
+// The loop the decoder ran before the peak envelope: RMS of the
+// channel-averaged magnitude only.
+float rms_only(const float* frames, size_t frame_count) {
+    float sum_sq = 0.0f;
+    for (size_t f = 0; f < frame_count; f++) {
+        float m = (std::fabs(frames[f * 2]) + std::fabs(frames[f * 2 + 1])) * 0.5f;
+        sum_sq += m * m;
+    }
+    return sum_sq;
+}
+
+// One minute of 44.1 kHz stereo in decoder-sized chunks, best of five.
+void benchmark() {
+    const size_t rate = 44100, chunk = 4096, frame_count = rate * 60;
+    std::vector<float> frames = noise(2 * frame_count, 3);
+    auto best_ms = [&](auto&& pass) {
+        double best = 1e9;
+        for (int run = 0; run < 5; run++) {
+            auto start = std::chrono::steady_clock::now();
+            pass();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    };
+    volatile float sink = 0.0f;
+    double baseline = best_ms([&]() {
+        float sum = 0.0f;
+        for (size_t f = 0; f < frame_count; f += chunk) {
+            sum += rms_only(frames.data() + f * 2, std::min(chunk, frame_count - f));
+        }
+        sink = sum;
+    });
+    double reduce = best_ms([&]() {
+        WaveformSegmentStats stats;
+        for (size_t f = 0; f < frame_count; f += chunk) {
+            waveform_reduce(frames.data() + f * 2, std::min(chunk, frame_count - f), 2, stats);
+        }
+        sink = stats.max;
+    });
+    (void)sink;
+    std::printf("waveform_reduce_test: 1 min 44.1 kHz stereo: RMS only %.2f ms, RMS + envelope %.2f ms (+%.2f ms)\n",
+                baseline, reduce, reduce - baseline);
+}
+
+} // anonymous namespace
+
+int main() {
+    test_stereo_paths_agree();
+    test_envelope_and_rms();
+    test_chunked();
+    benchmark();
+    return nowbar_test::test_result("waveform_reduce_test");
+}
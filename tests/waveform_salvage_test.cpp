@@ -0,0 +1,102 @@
+// Salvage of crashed wavecache.db files: truncation at every byte offset
+// and torn records. Each truncated image is rebuilt through the .tmp file,
+// so this test is I/O bound; CMake points TMPDIR at /dev/shm when it exists.
+#include "test_util.h"
+#include "waveform_fixtures.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace nowbar;
+using namespace nowbar_test;
+
+namespace {
+
+// Cut a crashed (dirty) table at every byte offset up to the end of its
+// data: open must succeed and salvage exactly the records whose slot and
+// payload both lie entirely before the cut.
+void test_truncation(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("truncated.db");
+    const int count = 40;
+    {
+        WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+        CHECK(cache.open(path));
+        for (int k = 0; k < count; k++) CHECK(cache.store(make_id(k), 0, make_level(k)));
+        // Keep the dirty flag set, as a crash would.
+        std::filesystem::copy_file(path, path + ".crashed");
+    }
+    std::vector<char> full = read_file(path + ".crashed");
+    CacheLayout layout(full);
+    CHECK_EQ(layout.data_end, count * PAYLOAD_BYTES);
+    // Past the data only unused room is cut; a few such cuts suffice.
+    size_t last_cut = std::min<size_t>(full.size(), layout.data_start() + layout.data_end + 16);
+
+    int failed_offsets = 0;
+    for (size_t cut = 0; cut <= last_cut; cut++) {
+        write_file(path, full.data(), cut);
+        WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+        if (!CHECK(cache.open(path))) break;
+
+        int expected = 0;
+        for (uint32_t s = 0; s < layout.slot_count && layout.slot_offset(s + 1) <= cut; s++) {
+            uint64_t key_hash;
+            memcpy(&key_hash, &full[layout.slot_offset(s)], sizeof(key_hash));
+            if (key_hash && layout.payload_offset(full, s) + PAYLOAD_BYTES <= cut) expected++;
+        }
+        if (cache.entry_count() != static_cast<uint32_t>(expected) || hits(cache, count) != expected) {
+            if (failed_offsets++ < 5) std::fprintf(stderr, "truncated at %zu: expected %d records\n", cut, expected);
+        }
+    }
+    CHECK_EQ(failed_offsets, 0);
+}
+
+// Torn records in a crashed table are dropped; the rest are salvaged.
+void test_torn_records(const nowbar_test::TempDir& dir) {
+    std::string path = dir.file("torn.db");
+    const int count = 40;
+    {
+        WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+        CHECK(cache.open(path));
+        for (int k = 0; k < count; k++) CHECK(cache.store(make_id(k), 0, make_level(k)));
+        std::filesystem::copy_file(path, path + ".crashed");
+    }
+    std::vector<char> image = read_file(path + ".crashed");
+
+    // Flip one payload byte of each of the first three used slots.
+    CacheLayout layout(image);
+    int torn = 0;
+    for (uint32_t s = 0; s < layout.slot_count && torn < 3; s++) {
+        uint64_t key_hash;
+        memcpy(&key_hash, &image[layout.slot_offset(s)], sizeof(key_hash));
+        if (!key_hash) continue;
+        image[layout.payload_offset(image, s) + torn] ^= 0x5a;
+        torn++;
+    }
+    write_file(path, image.data(), image.size());
+
+    WaveformCacheFile cache(SEGMENTS, PeakEncoding::U8);
+    CHECK(cache.open(path));
+    CHECK_EQ(cache.entry_count(), static_cast<uint32_t>(count - torn));
+    CHECK_EQ(hits(cache, count), count - torn);
+    CHECK(!file_exists(path + ".tmp"));
+
+    // A clean table with a garbage header starts over empty.
+    image[0] = 'X';
+    write_file(path, image.data(), image.size());
+    WaveformCacheFile garbage(SEGMENTS, PeakEncoding::U8);
+    CHECK(garbage.open(path));
+    CHECK_EQ(garbage.entry_count(), 0u);
+}
+
+} // anonymous namespace
+
+int main() {
+    nowbar_test::TempDir dir("waveform_salvage");
+    test_truncation(dir);
+    test_torn_records(dir);
+    return nowbar_test::test_result("waveform_salvage_test");
+}
@@ -0,0 +1,152 @@
+// WaveformSnapshotCell: lock-free readers racing writers, shared pyramids
+// published without copies, and retirement of replaced snapshots. Meant to
+// run under TSan and ASan as well (see NOWBAR_SANITIZE).
+#include "test_util.h"
+#include "waveform_snapshot.h"
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace nowbar;
+
+namespace {
+
+// A single-level pyramid whose every value is tag / 255 and whose loudness
+// is the tag, so a reader can tell a torn or freed snapshot apart.
+std::shared_ptr<const WaveformPyramid> make_pyramid(int tag) {
+    WaveformLevel level(PeakEncoding::U8, 400);
+    float v = (tag % 256) / 255.0f;
+    for (size_t i = 0; i < level.size(); i++) {
+        level.rms.set(i, v);
+        level.peak_max.set(i, v);
+        level.peak_min.set(i, v);
+    }
+    level.loudness = static_cast<float>(tag);
+    return std::make_shared<const WaveformPyramid>(WaveformPyramid::from_finest(std::move(level)));
+}
+
+bool consistent(const WaveformPyramid& pyramid) {
+    const WaveformLevel& level = pyramid.finest();
+    if (level.empty() || std::lround(level.rms[0] * 255.0f) != static_cast<int>(pyramid.loudness()) % 256) return false;
+    float v = level.rms[0];
+    for (size_t i = 0; i < level.size(); i++) {
+        if (level.rms[i] != v || level.peak_max[i] != v || level.peak_min[i] != v) return false;
+    }
+    return true;
+}
+
+void test_publish_shares() {
+    auto pyramid = make_pyramid(7);
+    WaveformSnapshotCell a;
+    WaveformSnapshotCell b;
+    CHECK(!WaveformSnapshotCell::Reader(a));
+    CHECK(!a.complete());
+
+    a.publish(pyramid, false);
+    b.publish(pyramid, true);
+    {
+        WaveformSnapshotCell::Reader ra(a);
+        WaveformSnapshotCell::Reader rb(b);
+        CHECK(ra && rb);
+        CHECK(ra->pyramid == pyramid);  // Same object, not a copy
+        CHECK(rb->pyramid == pyramid);
+        CHECK_EQ(pyramid.use_count(), 3);
+        CHECK(!ra->complete);
+        CHECK(rb->complete);
+    }
+    CHECK(b.complete());
+
+    // Versions increase per cell; a null pyramid publishes an empty one.
+    uint64_t before = WaveformSnapshotCell::Reader(a)->version;
+    a.publish(nullptr, false);
+    {
+        WaveformSnapshotCell::Reader reader(a);
+        CHECK(reader->version > before);
+        CHECK(reader->pyramid && reader->pyramid->empty());
+    }
+    a.publish(WaveformPyramid(), true);  // By value, wrapped once
+    CHECK(a.complete());
+    a.clear();
+    CHECK(!WaveformSnapshotCell::Reader(a));
+
+    // The replaced snapshots were retired with no reader open, releasing
+    // their pyramids; only b still holds it.
+    CHECK_EQ(pyramid.use_count(), 2);
+}
+
+// A snapshot held by an open Reader is not freed by later publishes; it is
+// retired and freed by the first publish after the Reader closes.
+void test_retire_waits_for_readers() {
+    WaveformSnapshotCell cell;
+    auto first = make_pyramid(1);
+    std::weak_ptr<const WaveformPyramid> watch = first;
+    cell.publish(std::move(first), false);
+    {
+        WaveformSnapshotCell::Reader reader(cell);
+        for (int i = 2; i < 10; i++) cell.publish(make_pyramid(i), false);
+        CHECK(!watch.expired());
+        CHECK(consistent(*reader->pyramid));
+        CHECK_EQ(reader->pyramid->loudness(), 1.0f);
+    }
+    CHECK(!watch.expired());
+    cell.publish(make_pyramid(10), true);
+    CHECK(watch.expired());
+}
+
+// Two writers publish one shared pyramid into two cells while readers
+// check every snapshot they see.
+void test_concurrent_readers() {
+    std::atomic<bool> done{false};
+    std::atomic<long> reads{0};
+    std::atomic<long> torn{0};
+    std::weak_ptr<const WaveformPyramid> last;
+    {
+        WaveformSnapshotCell cells[2];
+        std::vector<std::thread> writers;
+        for (int w = 0; w < 2; w++) {
+            writers.emplace_back([&cells, w]() {
+                for (int i = 0; i < 3000; i++) {
+                    if (i % 331 == 0) {
+                        cells[w].clear();
+                        continue;
+                    }
+                    auto pyramid = make_pyramid(i * 2 + w);
+                    cells[0].publish(pyramid, false);
+                    cells[1].publish(pyramid, false);
+                }
+            });
+        }
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; r++) {
+            readers.emplace_back([&cells, &done, &reads, &torn, r]() {
+                while (!done.load()) {
+                    WaveformSnapshotCell::Reader reader(cells[r % 2]);
+                    if (!reader) continue;
+                    if (!consistent(*reader->pyramid)) torn++;
+                    reads++;
+                }
+            });
+        }
+        for (auto& thread : writers) thread.join();
+        done = true;
+        for (auto& thread : readers) thread.join();
+
+        WaveformSnapshotCell::Reader reader(cells[0]);
+        CHECK(reader);
+        last = reader->pyramid;
+    }
+    CHECK(reads.load() > 0);
+    CHECK_EQ(torn.load(), 0);
+    CHECK(last.expired());  // Destroying the cells freed everything
+}
+
+} // anonymous namespace
+
+int main() {
+    test_publish_shares();
+    test_retire_waits_for_readers();
+    test_concurrent_readers();
+    return nowbar_test::test_result("waveform_snapshot_test");
+}
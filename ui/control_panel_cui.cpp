@@ -288,6 +288,18 @@ LRESULT ControlPanelCUI::on_message(HWND wnd, UINT msg, WPARAM wp, LPARAM lp) {
         }
         return 0;
         
+    case ControlPanelCore::WM_NOWBAR_WAVEFORM:
+        if (m_core) m_core->on_waveform_update();
+        return 0;
+
+    case ControlPanelCore::WM_NOWBAR_SCRUB:
+        if (m_core) m_core->on_scrub_preview_ready();
+        return 0;
+
+    case ControlPanelCore::WM_NOWBAR_ARTWORK:
+        if (m_core) m_core->on_artwork_ready();
+        return 0;
+
     case ControlPanelCore::WM_NOWBAR_ANIMATE: {
         // Thread-pool timer fired — release the one-shot handle, invalidate,
         // and force an immediate paint so it isn't delayed by low-priority
@@ -306,6 +318,8 @@ LRESULT ControlPanelCUI::on_message(HWND wnd, UINT msg, WPARAM wp, LPARAM lp) {
             if (m_core) m_core->poll_custom_button_states();
         } else if (timer_id == ControlPanelCore::SHOW_PREFS_TIMER_ID) {
             if (m_core) m_core->do_show_preferences();
+        } else if (timer_id == ControlPanelCore::BLUR_SETTLE_TIMER_ID) {
+            if (m_core) m_core->on_blur_settle_timer();
         }
         return 0;
     }